@@ -0,0 +1,25 @@
+#version 330 core
+
+// input data : the coin mesh, and one position and spin phase per coin
+layout (location = 0) in vec3 vertexPosition;
+layout (location = 1) in vec3 vertexColor;
+layout (location = 3) in vec4 coinInstance;
+
+uniform mat4 VP;
+uniform float time;
+
+// output data : used by fragment shader
+out vec3 fragColor;
+
+void main ()
+{
+    // spin about the vertical axis
+    float angle = time * 3.0 + coinInstance.w;
+    float c = cos(angle), s = sin(angle);
+    vec3 p = vec3(c * vertexPosition.x + s * vertexPosition.z,
+                  vertexPosition.y,
+                  -s * vertexPosition.x + c * vertexPosition.z);
+
+    fragColor = vertexColor;
+    gl_Position = VP * vec4(p + coinInstance.xyz, 1);
+}
@@ -0,0 +1,16 @@
+#version 330 core
+
+// Interpolated values from the vertex shaders
+in vec2 fragTexCoord;
+in vec4 fragColor;
+
+// output data
+out vec4 color;
+
+// Glyph atlas, coverage in the red channel
+uniform sampler2D texSampler;
+
+void main()
+{
+    color = vec4(fragColor.rgb, fragColor.a * texture( texSampler, fragTexCoord ).r);
+}
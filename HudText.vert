@@ -0,0 +1,22 @@
+#version 330 core
+
+// input data : glyph quads in pixels from the top left corner
+layout (location = 0) in vec2 vertexPosition;
+layout (location = 1) in vec2 vertexTexCoord;
+layout (location = 2) in vec4 vertexColor;
+
+uniform vec2 screenSize;
+
+// output data : used by fragment shader
+out vec2 fragTexCoord;
+out vec4 fragColor;
+
+void main ()
+{
+    fragTexCoord = vertexTexCoord;
+    fragColor = vertexColor;
+
+    // pixels to clip space, y grows downwards on screen
+    vec2 ndc = vertexPosition / screenSize * 2.0 - 1.0;
+    gl_Position = vec4(ndc.x, -ndc.y, 0, 1);
+}
@@ -0,0 +1,273 @@
+// Memory-mapped asset pack
+#include "assetpack.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <iostream>
+
+using namespace std;
+
+AssetPack::AssetPack()
+: Base(0), Size(0), Toc(0), Count(0)
+{
+}
+
+AssetPack::~AssetPack()
+{
+	close();
+}
+
+bool AssetPack::open(const char* filename)
+{
+	close();
+
+	int fd = ::open(filename, O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(ASSETPACK_HEADER))
+	{
+		::close(fd);
+		return false;
+	}
+
+	void* base = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd); // the mapping keeps the file referenced
+	if (base == MAP_FAILED)
+		return false;
+
+	const ASSETPACK_HEADER* header = (const ASSETPACK_HEADER*)base;
+	if (header->magic != ASSETPACK_MAGIC || header->version != ASSETPACK_VERSION ||
+		header->packsize != (uint64_t)st.st_size ||
+		header->tocoffset + (uint64_t)header->count * sizeof(ASSETPACK_ENTRY) > (uint64_t)st.st_size)
+	{
+		cout << "Error: `" << filename << "' is not a valid asset pack" << endl;
+		munmap(base, st.st_size);
+		return false;
+	}
+
+	// Start reading the whole pack in now, one large sequential read is
+	// much cheaper than faulting in every asset on first use
+	madvise(base, st.st_size, MADV_WILLNEED);
+
+	Base = (unsigned char*)base;
+	Size = st.st_size;
+	Toc = (const ASSETPACK_ENTRY*)(Base + header->tocoffset);
+	Count = header->count;
+	return true;
+}
+
+void AssetPack::close()
+{
+	if (Base)
+		munmap(Base, Size);
+	Base = 0;
+	Size = 0;
+	Toc = 0;
+	Count = 0;
+}
+
+bool AssetPack::find(const char* name, ASSET* asset) const
+{
+	// table of contents is sorted by name
+	int low = 0, high = (int)Count - 1;
+	while (low <= high)
+	{
+		int mid = (low + high) / 2;
+		int cmp = strncmp(name, Toc[mid].name, ASSETPACK_NAME_LENGTH);
+		if (cmp == 0)
+		{
+			if (Toc[mid].offset + Toc[mid].size > Size)
+				return false;
+			asset->data = Base + Toc[mid].offset;
+			asset->size = Toc[mid].size;
+			return true;
+		}
+		if (cmp < 0)
+			high = mid - 1;
+		else
+			low = mid + 1;
+	}
+	return false;
+}
+
+static bool compareEntries(const ASSETPACK_ENTRY& a, const ASSETPACK_ENTRY& b)
+{
+	return strncmp(a.name, b.name, ASSETPACK_NAME_LENGTH) < 0;
+}
+
+static uint64_t alignOffset(uint64_t offset)
+{
+	return (offset + ASSETPACK_ALIGN - 1) & ~(uint64_t)(ASSETPACK_ALIGN - 1);
+}
+
+// deletes what was written of a failed pack, leaving devices and pipes alone
+static void removePartialPack(const char* filename)
+{
+	struct stat st;
+	if (stat(filename, &st) == 0 && S_ISREG(st.st_mode))
+		remove(filename);
+}
+
+bool writeAssetPack(const char* filename, const vector<string>& files)
+{
+	vector<ASSETPACK_ENTRY> toc(files.size());
+	vector<string> paths(files.size());
+
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		string base = files[i].substr(files[i].find_last_of('/') + 1);
+		if (base.size() >= ASSETPACK_NAME_LENGTH)
+		{
+			cout << "Error: asset name `" << base << "' is too long" << endl;
+			return false;
+		}
+
+		struct stat st;
+		if (stat(files[i].c_str(), &st) < 0)
+		{
+			cout << "Error: could not open `" << files[i] << "'" << endl;
+			return false;
+		}
+
+		memset(&toc[i], 0, sizeof(ASSETPACK_ENTRY));
+		strcpy(toc[i].name, base.c_str());
+		toc[i].size = st.st_size;
+	}
+
+	// keep paths in the same order as the sorted table of contents
+	vector<size_t> order(files.size());
+	for (size_t i = 0; i < order.size(); i++)
+		order[i] = i;
+	sort(order.begin(), order.end(), [&](size_t a, size_t b) { return compareEntries(toc[a], toc[b]); });
+	vector<ASSETPACK_ENTRY> sorted(toc.size());
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		sorted[i] = toc[order[i]];
+		paths[i] = files[order[i]];
+		if (i > 0 && strcmp(sorted[i].name, sorted[i-1].name) == 0)
+		{
+			cout << "Error: asset `" << sorted[i].name << "' was given twice" << endl;
+			return false;
+		}
+	}
+
+	ASSETPACK_HEADER header;
+	memset(&header, 0, sizeof(header));
+	header.magic = ASSETPACK_MAGIC;
+	header.version = ASSETPACK_VERSION;
+	header.count = sorted.size();
+	header.tocoffset = sizeof(ASSETPACK_HEADER);
+
+	uint64_t offset = alignOffset(header.tocoffset + sorted.size() * sizeof(ASSETPACK_ENTRY));
+	for (size_t i = 0; i < sorted.size(); i++)
+	{
+		sorted[i].offset = offset;
+		offset = alignOffset(offset + sorted[i].size);
+	}
+	header.packsize = offset;
+
+	FILE* out = fopen(filename, "wb");
+	if (!out)
+	{
+		cout << "Error: could not create `" << filename << "'" << endl;
+		return false;
+	}
+
+	bool ok = fwrite(&header, sizeof(header), 1, out) == 1;
+	if (ok && !sorted.empty())
+		ok = fwrite(&sorted[0], sizeof(ASSETPACK_ENTRY), sorted.size(), out) == sorted.size();
+
+	vector<char> data;
+	for (size_t i = 0; ok && i < sorted.size(); i++)
+	{
+		FILE* in = fopen(paths[i].c_str(), "rb");
+		data.resize(sorted[i].size);
+		if (!in || (sorted[i].size && fread(&data[0], 1, data.size(), in) != data.size()))
+		{
+			cout << "Error: could not read `" << paths[i] << "'" << endl;
+			if (in)
+				fclose(in);
+			fclose(out);
+			removePartialPack(filename);
+			return false;
+		}
+		fclose(in);
+
+		ok = fseek(out, sorted[i].offset, SEEK_SET) == 0 &&
+			(data.empty() || fwrite(&data[0], 1, data.size(), out) == data.size());
+	}
+
+	// pad the last blob so the file size matches the header
+	if (ok)
+		ok = fseek(out, header.packsize - 1, SEEK_SET) == 0 && fputc(0, out) != EOF;
+
+	// buffered data is only written out here, so a full disk may show up now
+	if (fclose(out) != 0)
+		ok = false;
+	if (!ok)
+	{
+		cout << "Error: could not write `" << filename << "'" << endl;
+		removePartialPack(filename);
+		return false;
+	}
+	return true;
+}
+
+// irrKlang file reader reading from the mapped pack
+class AssetPackFileReader : public irrklang::IFileReader
+{
+public:
+
+	AssetPackFileReader(const ASSET& asset, const char* filename)
+	: Asset(asset), Pos(0), FileName(filename)
+	{
+	}
+
+	virtual irrklang::ik_s32 read(void* buffer, irrklang::ik_u32 sizeToRead)
+	{
+		size_t left = Asset.size - Pos;
+		if (sizeToRead > left)
+			sizeToRead = left;
+		memcpy(buffer, Asset.data + Pos, sizeToRead);
+		Pos += sizeToRead;
+		return sizeToRead;
+	}
+
+	virtual bool seek(irrklang::ik_s32 finalPos, bool relativeMovement)
+	{
+		long pos = relativeMovement ? (long)Pos + finalPos : finalPos;
+		if (pos < 0 || pos > (long)Asset.size)
+			return false;
+		Pos = pos;
+		return true;
+	}
+
+	virtual irrklang::ik_s32 getSize() { return Asset.size; }
+	virtual irrklang::ik_s32 getPos() { return Pos; }
+	virtual const irrklang::ik_c8* getFileName() { return FileName.c_str(); }
+
+private:
+
+	ASSET Asset;
+	size_t Pos;
+	string FileName;
+};
+
+AssetPackFileFactory::AssetPackFileFactory(const AssetPack* pack)
+: Pack(pack)
+{
+}
+
+irrklang::IFileReader* AssetPackFileFactory::createFileReader(const irrklang::ik_c8* filename)
+{
+	ASSET asset;
+	if (!Pack->find(filename, &asset))
+		return 0;
+	return new AssetPackFileReader(asset, filename);
+}
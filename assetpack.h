@@ -0,0 +1,86 @@
+// Memory-mapped asset pack
+//
+// All game assets (sounds, textures, shader sources) are stored in a single
+// pack file which is mapped once at startup. The pack starts with a header,
+// followed by a table of contents sorted by name, followed by the file blobs.
+// Every blob starts on an ASSETPACK_ALIGN boundary so each asset covers whole
+// pages of the mapping.
+//
+// Packs are built with the mkpack tool: ./mkpack assets.pak file1 file2 ...
+
+#ifndef ASSETPACK_H
+#define ASSETPACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <irrKlang.h>
+
+#define ASSETPACK_MAGIC 0x4b415047 // "GPAK" in little endian
+#define ASSETPACK_VERSION 1
+#define ASSETPACK_ALIGN 4096
+#define ASSETPACK_NAME_LENGTH 48
+
+struct ASSETPACK_HEADER {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t count;      // number of table of contents entries
+	uint32_t reserved;
+	uint64_t tocoffset;  // offset of the first ASSETPACK_ENTRY
+	uint64_t packsize;   // total size of the pack in bytes
+};
+
+struct ASSETPACK_ENTRY {
+	char name[ASSETPACK_NAME_LENGTH]; // zero terminated file name
+	uint64_t offset;                  // offset of the blob, ASSETPACK_ALIGN aligned
+	uint64_t size;                    // size of the blob in bytes
+};
+
+struct ASSET {
+	const unsigned char* data;
+	size_t size;
+};
+
+class AssetPack
+{
+public:
+
+	AssetPack();
+	~AssetPack();
+
+	//! Maps the pack file. Returns false if the file is missing or not a valid pack.
+	bool open(const char* filename);
+	void close();
+	bool isOpen() const { return Base != 0; }
+
+	//! Looks up an asset by file name. Returns false if the pack does not contain it.
+	bool find(const char* name, ASSET* asset) const;
+
+private:
+
+	unsigned char* Base;
+	size_t Size;
+	const ASSETPACK_ENTRY* Toc;
+	uint32_t Count;
+};
+
+//! Writes a pack containing the given files, stored under their base names.
+bool writeAssetPack(const char* filename, const std::vector<std::string>& files);
+
+//! Lets irrKlang read sounds straight from the mapped pack.
+/** Files which are not in the pack are left to irrKlang's default file access. */
+class AssetPackFileFactory : public irrklang::IFileFactory
+{
+public:
+
+	AssetPackFileFactory(const AssetPack* pack);
+
+	virtual irrklang::IFileReader* createFileReader(const irrklang::ik_c8* filename);
+
+private:
+
+	const AssetPack* Pack;
+};
+
+#endif
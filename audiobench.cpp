@@ -0,0 +1,443 @@
+// Headless audio benchmark
+//
+// Creates the sound engine and plays a scripted sequence of 2D and 3D sounds
+// and sound bank effects. By default the engine runs on ESOD_ALSA with ALSA's
+// "null" PCM, which mixes like a real device but throws the audio away, so it
+// works on machines without a sound card. irrKlang's own ESOD_NULL driver
+// (-driver null) isn't used by default because it doesn't play or mix
+// anything, every play call returns 0, so it can only show that the engine
+// starts.
+//
+// By default the engine is single threaded and mixes inside
+// ISoundEngine::update(), which is timed. A mixed output receiver counts the
+// audio the engine produced. Reports the mixing CPU time per second of audio
+// and the number of playing voices, and can compare the result against the JSON
+// of an earlier run to catch regressions.
+//
+// Usage: ./audiobench [-seconds n] [-script file] [-driver alsa|null] [-threaded]
+//                     [-json out.json] [-baseline old.json] [-tolerance percent]
+//
+// Script lines are "<time> 2d <file> [loop]", "<time> 3d <file> <x> <y> <z> [loop]"
+// or "<time> bank <jump|death|coin>", times in seconds. Lines starting with #
+// are ignored. Without a script a built in scene with music, effects and
+// moving 3D sounds is played. Run it from the game directory, the files are
+// looked up relative to it and the mp3 plugin is loaded from there like in the
+// game. A run in which no sound could be played or nothing was mixed fails.
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <cmath>
+#include <ctime>
+#include <stdlib.h>
+#include <string.h>
+#include <irrKlang.h>
+#include "soundbank.h"
+using namespace std;
+
+struct EVENT {
+	double time;
+	string action; // "2d", "3d" or "bank"
+	string file;   // sound file or bank effect name
+	irrklang::vec3df pos;
+	bool loop;
+};
+
+struct SECOND {
+	double mixms;      // time spent in update()
+	double audio;      // seconds of audio mixed
+	int voices;        // playing at the end of the second
+	int peakvoices;
+};
+
+// counts what the engine mixed, called from its mixing thread
+class MixCounter : public irrklang::ISoundMixedOutputReceiver
+{
+public:
+
+	MixCounter() : Frames(0), Rate(0), Peak(0) {}
+
+	virtual void OnAudioDataReady(const void* data, int byteCount, int playbackrate)
+	{
+		const short* samples = (const short*)data;
+		const int count = byteCount / 2;
+		int peak = Peak.load(memory_order_relaxed);
+
+		for (int i = 0; i < count; i++)
+			peak = max(peak, abs((int)samples[i]));
+
+		Peak.store(peak, memory_order_relaxed);
+		Rate.store(playbackrate, memory_order_relaxed);
+		Frames.fetch_add(byteCount / 4, memory_order_relaxed); // always 16 bit stereo
+	}
+
+	atomic<long long> Frames;
+	atomic<int> Rate;
+	atomic<int> Peak;
+};
+
+static const char* const defaultScript[] = {
+	"0 2d irrklang/media/ophelia.mp3 loop",
+	"0 3d irrklang/media/bell.wav 5 0 0 loop",
+	"1 3d irrklang/media/getout.ogg -5 0 5 loop",
+};
+
+static bool parseEvent(const string& line, EVENT& event)
+{
+	istringstream in(line);
+	event.pos = irrklang::vec3df(0, 0, 0);
+	event.loop = false;
+
+	if (!(in >> event.time >> event.action >> event.file))
+		return false;
+
+	if (event.action == "3d" && !(in >> event.pos.X >> event.pos.Y >> event.pos.Z))
+		return false;
+
+	string flag;
+	if (in >> flag)
+	{
+		if (flag != "loop")
+			return false;
+		event.loop = true;
+	}
+
+	return event.action == "2d" || event.action == "3d" || event.action == "bank";
+}
+
+static void buildDefaultScript(double seconds, vector<EVENT>& events)
+{
+	for (size_t i = 0; i < sizeof(defaultScript) / sizeof(defaultScript[0]); i++)
+	{
+		EVENT event;
+		parseEvent(defaultScript[i], event);
+		events.push_back(event);
+	}
+
+	// gameplay effects: jumps, coins in bursts and an explosion now and then
+	for (double t = 0.5; t < seconds; t += 0.4)
+	{
+		EVENT event;
+		event.time = t;
+		event.action = "bank";
+		event.file = "jump";
+		event.loop = false;
+		events.push_back(event);
+
+		event.time = t + 0.1;
+		event.file = "coin";
+		events.push_back(event);
+	}
+	for (double t = 2; t < seconds; t += 3)
+	{
+		EVENT event;
+		event.time = t;
+		event.action = "3d";
+		event.file = "irrklang/media/explosion.wav";
+		event.pos = irrklang::vec3df(10 * cos(t), 0, 10 * sin(t));
+		event.loop = false;
+		events.push_back(event);
+	}
+}
+
+static bool loadScript(const char* filename, vector<EVENT>& events)
+{
+	ifstream in(filename);
+	if (!in)
+		return false;
+
+	string line;
+	int number = 0;
+	while (getline(in, line))
+	{
+		number++;
+		if (line.empty() || line[0] == '#')
+			continue;
+
+		EVENT event;
+		if (!parseEvent(line, event))
+		{
+			cout << "Error: " << filename << ":" << number << ": can't parse `" << line << "'" << endl;
+			return false;
+		}
+		events.push_back(event);
+	}
+	return true;
+}
+
+static SOUND_ID bankSound(const string& name)
+{
+	if (name == "death")
+		return SOUND_DEATH;
+	if (name == "coin")
+		return SOUND_COIN;
+	return SOUND_JUMP;
+}
+
+static bool writeJson(const char* filename, const vector<SECOND>& seconds, double mixmsPerSecond,
+	double avgvoices, int peakvoices)
+{
+	ofstream out(filename);
+	if (!out)
+		return false;
+
+	out << "{\n  \"benchmark\": \"audiobench\",\n"
+		<< "  \"mix_ms_per_audio_second\": " << mixmsPerSecond << ",\n"
+		<< "  \"average_voices\": " << avgvoices << ",\n"
+		<< "  \"peak_voices\": " << peakvoices << ",\n"
+		<< "  \"seconds\": [\n";
+	for (size_t i = 0; i < seconds.size(); i++)
+	{
+		out << "    {\"mix_ms\": " << seconds[i].mixms << ", \"audio_seconds\": " << seconds[i].audio
+			<< ", \"voices\": " << seconds[i].voices << ", \"peak_voices\": " << seconds[i].peakvoices
+			<< "}" << (i + 1 < seconds.size() ? "," : "") << "\n";
+	}
+	out << "  ]\n}\n";
+	return true;
+}
+
+static bool readBaseline(const char* filename, double* mixmsPerSecond)
+{
+	ifstream in(filename);
+	if (!in)
+		return false;
+
+	stringstream json;
+	json << in.rdbuf();
+	const string key = "\"mix_ms_per_audio_second\":";
+	size_t pos = json.str().find(key);
+	if (pos == string::npos)
+		return false;
+
+	*mixmsPerSecond = atof(json.str().c_str() + pos + key.size());
+	return true;
+}
+
+int main (int argc, char** argv)
+{
+	double duration = 10;
+	const char* scriptFile = 0;
+	const char* jsonFile = 0;
+	const char* baselineFile = 0;
+	double tolerance = 10;
+	bool threaded = false;
+	bool alsa = true;
+
+	for (int i = 1; i < argc; i++)
+	{
+		const bool hasValue = i + 1 < argc;
+		if (!strcmp(argv[i], "-seconds") && hasValue)
+			duration = atof(argv[++i]);
+		else if (!strcmp(argv[i], "-script") && hasValue)
+			scriptFile = argv[++i];
+		else if (!strcmp(argv[i], "-driver") && hasValue)
+			alsa = strcmp(argv[++i], "null") != 0;
+		else if (!strcmp(argv[i], "-threaded"))
+			threaded = true;
+		else if (!strcmp(argv[i], "-json") && hasValue)
+			jsonFile = argv[++i];
+		else if (!strcmp(argv[i], "-baseline") && hasValue)
+			baselineFile = argv[++i];
+		else if (!strcmp(argv[i], "-tolerance") && hasValue)
+			tolerance = atof(argv[++i]);
+		else
+		{
+			cout << "Usage: " << argv[0] << " [-seconds n] [-script file] [-driver alsa|null] [-threaded]"
+				" [-json out.json] [-baseline old.json] [-tolerance percent]" << endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	vector<EVENT> events;
+	if (scriptFile)
+	{
+		if (!loadScript(scriptFile, events))
+			return EXIT_FAILURE;
+	}
+	else
+		buildDefaultScript(duration, events);
+
+	stable_sort(events.begin(), events.end(),
+		[](const EVENT& a, const EVENT& b) { return a.time < b.time; });
+
+	// without ESEO_MULTI_THREADED all mixing happens in update() on this thread
+	int options = irrklang::ESEO_LOAD_PLUGINS | irrklang::ESEO_USE_3D_BUFFERS;
+	if (threaded)
+		options |= irrklang::ESEO_MULTI_THREADED;
+
+	irrklang::ISoundEngine* engine = alsa ?
+		irrklang::createIrrKlangDevice(irrklang::ESOD_ALSA, options, "null") :
+		irrklang::createIrrKlangDevice(irrklang::ESOD_NULL, options);
+	if (!engine)
+	{
+		cout << "Error: could not create the sound engine" << endl;
+		return EXIT_FAILURE;
+	}
+
+	MixCounter counter;
+	const bool counting = engine->setMixedDataOutputReceiver(&counter);
+	if (!counting)
+		cout << "Note: the driver doesn't report mixed output, audio time is wall clock time" << endl;
+
+	SoundBank sounds;
+	sounds.load(engine);
+
+	vector<irrklang::ISound*> voices;
+	vector<SECOND> seconds;
+	SECOND current = { 0, 0, 0, 0 };
+	size_t next = 0;
+	bool played = false;
+
+	const chrono::duration<double> tick(1.0 / 60);
+	const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	chrono::steady_clock::time_point wake = start;
+	const clock_t cpuStart = clock();
+	long long framesBefore = 0;
+	double audioBefore = 0;
+
+	for (;;)
+	{
+		const double t = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		if (t >= duration)
+			break;
+
+		for (; next < events.size() && events[next].time <= t; next++)
+		{
+			const EVENT& event = events[next];
+			irrklang::ISound* sound = 0;
+
+			if (event.action == "bank")
+				sounds.play(bankSound(event.file));
+			else if (event.action == "2d")
+				sound = engine->play2D(event.file.c_str(), event.loop, false, true);
+			else
+				sound = engine->play3D(event.file.c_str(), event.pos, event.loop, false, true);
+
+			if (sound)
+			{
+				voices.push_back(sound);
+				played = true;
+			}
+			else if (event.action != "bank")
+				cout << "Error: could not play `" << event.file << "'" << endl;
+		}
+
+		// move the listener in a circle so the 3D sounds keep changing
+		engine->setListenerPosition(irrklang::vec3df(3 * cos(t), 0, 3 * sin(t)), irrklang::vec3df(0, 0, 1));
+
+		const chrono::steady_clock::time_point before = chrono::steady_clock::now();
+		engine->update();
+		current.mixms += chrono::duration<double, milli>(chrono::steady_clock::now() - before).count();
+
+		for (size_t i = 0; i < voices.size(); )
+		{
+			if (voices[i]->isFinished())
+			{
+				voices[i]->drop();
+				voices[i] = voices.back();
+				voices.pop_back();
+			}
+			else
+				i++;
+		}
+		current.voices = (int)voices.size() + sounds.getVoiceCount();
+		played = played || current.voices > 0;
+		current.peakvoices = max(current.peakvoices, current.voices);
+
+		if ((int)t >= (int)seconds.size() + 1)
+		{
+			const long long frames = counter.Frames.load();
+			const int rate = counter.Rate.load();
+			current.audio = counting && rate ? (double)(frames - framesBefore) / rate : t - audioBefore;
+			framesBefore = frames;
+			audioBefore = t;
+			seconds.push_back(current);
+			current.mixms = 0;
+			current.peakvoices = current.voices;
+		}
+
+		wake += chrono::duration_cast<chrono::steady_clock::duration>(tick);
+		this_thread::sleep_until(wake);
+	}
+
+	const double cpu = (double)(clock() - cpuStart) / CLOCKS_PER_SEC;
+	const double wall = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	for (size_t i = 0; i < voices.size(); i++)
+		voices[i]->drop();
+	sounds.release();
+	engine->setMixedDataOutputReceiver(0);
+	engine->drop();
+
+	double mixms = 0;
+	double audio = 0;
+	double voiceSum = 0;
+	int peakvoices = 0;
+	for (size_t i = 0; i < seconds.size(); i++)
+	{
+		const SECOND& s = seconds[i];
+		cout << "second " << i + 1 << ": " << s.mixms << " ms mixing for " << s.audio << " s of audio, "
+			<< s.voices << " voices (peak " << s.peakvoices << ")" << endl;
+		mixms += s.mixms;
+		audio += s.audio;
+		voiceSum += s.voices;
+		peakvoices = max(peakvoices, s.peakvoices);
+	}
+
+	// with a mixing thread update() does no mixing, use the process CPU time
+	if (threaded)
+		mixms = cpu * 1000;
+
+	// a run which mixed nothing measured nothing, don't let it pass
+	if (!played)
+	{
+		cout << "Error: the driver didn't play any sound" << endl;
+		return EXIT_FAILURE;
+	}
+	if (counting && counter.Frames.load() == 0)
+	{
+		cout << "Error: nothing was mixed, check that libasound is installed" << endl;
+		return EXIT_FAILURE;
+	}
+
+	const double mixmsPerSecond = audio > 0 ? mixms / audio : 0;
+	const double avgvoices = seconds.empty() ? 0 : voiceSum / seconds.size();
+
+	cout << mixmsPerSecond << " ms mixing per second of audio, " << avgvoices << " voices on average, peak "
+		<< peakvoices << ", process CPU " << 100 * cpu / wall << "%";
+	if (counting)
+		cout << ", output peak " << counter.Peak.load();
+	cout << endl;
+
+	if (jsonFile && !writeJson(jsonFile, seconds, mixmsPerSecond, avgvoices, peakvoices))
+	{
+		cout << "Error: could not write `" << jsonFile << "'" << endl;
+		return EXIT_FAILURE;
+	}
+
+	if (baselineFile)
+	{
+		double baseline;
+		if (!readBaseline(baselineFile, &baseline))
+		{
+			cout << "Error: could not read baseline `" << baselineFile << "'" << endl;
+			return EXIT_FAILURE;
+		}
+
+		const double change = baseline > 0 ? 100 * (mixmsPerSecond - baseline) / baseline : 0;
+		cout << "compared to " << baselineFile << ": " << showpos << change << noshowpos << "%";
+		if (change > tolerance)
+		{
+			cout << "  REGRESSION" << endl;
+			return 1;
+		}
+		cout << endl;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,177 @@
+// Game to audio command queue
+#include "audioqueue.h"
+#include <chrono>
+
+using namespace std;
+
+AudioQueue::AudioQueue()
+: Head(0), Tail(0), Dropped(0), Running(false), Parked(false), Engine(0)
+{
+	for (unsigned i = 0; i < AUDIOQUEUE_SIZE; i++)
+		Slots[i].sequence.store(i, memory_order_relaxed);
+}
+
+AudioQueue::~AudioQueue()
+{
+	stop();
+}
+
+void AudioQueue::start(irrklang::ISoundEngine* engine)
+{
+	stop();
+	Engine = engine;
+	Bank.load(engine);
+
+	Running = true;
+	Thread = thread(&AudioQueue::run, this);
+}
+
+void AudioQueue::stop()
+{
+	if (Thread.joinable())
+	{
+		Running = false;
+		Wake.notify_one();
+		Thread.join();
+	}
+	Bank.release();
+	Engine = 0;
+}
+
+int AudioQueue::getDroppedCount() const
+{
+	return Dropped.load(memory_order_relaxed);
+}
+
+void AudioQueue::play(SOUND_ID id)
+{
+	AUDIOCOMMAND command;
+	command.type = AUDIO_PLAY;
+	command.id = id;
+	push(command);
+}
+
+void AudioQueue::play3D(SOUND_ID id, const irrklang::vec3df& pos)
+{
+	AUDIOCOMMAND command;
+	command.type = AUDIO_PLAY3D;
+	command.id = id;
+	command.pos = pos;
+	push(command);
+}
+
+void AudioQueue::setListener(const irrklang::vec3df& eye, const irrklang::vec3df& target)
+{
+	AUDIOCOMMAND command;
+	command.type = AUDIO_LISTENER;
+	command.pos = eye;
+	command.target = target;
+	push(command);
+}
+
+void AudioQueue::playMusic(const char* filename, bool looped)
+{
+	AUDIOCOMMAND command;
+	command.type = AUDIO_MUSIC;
+	command.filename = filename;
+	command.looped = looped;
+	push(command);
+}
+
+void AudioQueue::stopAll()
+{
+	AUDIOCOMMAND command;
+	command.type = AUDIO_STOP_ALL;
+	push(command);
+}
+
+// Bounded multi producer ring: each slot's sequence says whether it is free
+// for the producer claiming position pos (sequence == pos) or holds a command
+// for the consumer reading position pos (sequence == pos + 1).
+void AudioQueue::push(const AUDIOCOMMAND& command)
+{
+	unsigned pos = Head.load(memory_order_relaxed);
+	SLOT* slot;
+	for (;;)
+	{
+		slot = &Slots[pos & (AUDIOQUEUE_SIZE - 1)];
+		int diff = (int)(slot->sequence.load(memory_order_acquire) - pos);
+		if (diff == 0)
+		{
+			if (Head.compare_exchange_weak(pos, pos + 1, memory_order_relaxed))
+				break;
+		}
+		else if (diff < 0)
+		{
+			// full, the audio thread is behind
+			Dropped.fetch_add(1, memory_order_relaxed);
+			return;
+		}
+		else
+			pos = Head.load(memory_order_relaxed);
+	}
+
+	slot->command = command;
+
+	// sequentially consistent, so either the audio thread sees the command
+	// before it parks or we see it parked
+	slot->sequence.store(pos + 1);
+	if (Parked.load())
+		Wake.notify_one();
+}
+
+bool AudioQueue::pop(AUDIOCOMMAND& command)
+{
+	SLOT& slot = Slots[Tail & (AUDIOQUEUE_SIZE - 1)];
+	if (slot.sequence.load(memory_order_acquire) != Tail + 1)
+		return false;
+
+	command = slot.command;
+	slot.sequence.store(Tail + AUDIOQUEUE_SIZE, memory_order_release);
+	Tail++;
+	return true;
+}
+
+bool AudioQueue::isEmpty() const
+{
+	return Slots[Tail & (AUDIOQUEUE_SIZE - 1)].sequence.load() != Tail + 1;
+}
+
+void AudioQueue::execute(const AUDIOCOMMAND& command)
+{
+	switch (command.type)
+	{
+		case AUDIO_PLAY:
+			Bank.play(command.id);
+			break;
+		case AUDIO_PLAY3D:
+			Bank.play3D(command.id, command.pos);
+			break;
+		case AUDIO_LISTENER:
+			Bank.setListener(command.pos, command.target);
+			Bank.update();
+			break;
+		case AUDIO_MUSIC:
+			Bank.playMusic(command.filename, command.looped);
+			break;
+		case AUDIO_STOP_ALL:
+			Engine->stopAllSounds();
+			break;
+	}
+}
+
+void AudioQueue::run()
+{
+	AUDIOCOMMAND command;
+	while (Running)
+	{
+		while (pop(command))
+			execute(command);
+
+		unique_lock<mutex> lock(ParkMutex);
+		Parked.store(true);
+		if (isEmpty() && Running)
+			Wake.wait_for(lock, chrono::milliseconds(AUDIOQUEUE_PARK_MS));
+		Parked.store(false, memory_order_relaxed);
+	}
+}
@@ -0,0 +1,94 @@
+// Game to audio command queue
+//
+// Game code never calls irrKlang directly. Every audio call is turned into a
+// fixed size AUDIOCOMMAND and pushed into a bounded lock-free ring which any
+// number of threads may push into. A dedicated audio thread owns the
+// SoundBank, drains the ring and talks to the ISoundEngine, so the game thread
+// never waits on irrKlang's locks or the mixer. When the ring is empty the
+// audio thread parks on a condition variable, and push() only notifies it
+// while it is parked, so pushing never takes a lock and only makes a system
+// call for the first command after a pause. A notification which comes just
+// before the thread starts waiting is lost, so the wait times out after
+// AUDIOQUEUE_PARK_MS. The window for that is a few instructions wide, the
+// timeout only bounds how late such a command runs. When the ring is full the
+// command is dropped instead of blocking.
+
+#ifndef AUDIOQUEUE_H
+#define AUDIOQUEUE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <irrKlang.h>
+#include "soundbank.h"
+
+#define AUDIOQUEUE_SIZE 256 // must be a power of two
+#define AUDIOQUEUE_PARK_MS 50
+
+enum AUDIOCOMMAND_TYPE {
+	AUDIO_PLAY,
+	AUDIO_PLAY3D,
+	AUDIO_LISTENER,
+	AUDIO_MUSIC,
+	AUDIO_STOP_ALL
+};
+
+struct AUDIOCOMMAND {
+	AUDIOCOMMAND_TYPE type;
+	SOUND_ID id;
+	irrklang::vec3df pos;    // AUDIO_PLAY3D position, AUDIO_LISTENER eye
+	irrklang::vec3df target; // AUDIO_LISTENER target
+	const char* filename;    // AUDIO_MUSIC, must outlive the command
+	bool looped;
+};
+
+class AudioQueue
+{
+public:
+
+	AudioQueue();
+	~AudioQueue();
+
+	//! Loads the sound bank and starts the audio thread
+	void start(irrklang::ISoundEngine* engine);
+	void stop();
+
+	void play(SOUND_ID id);
+	void play3D(SOUND_ID id, const irrklang::vec3df& pos);
+	void setListener(const irrklang::vec3df& eye, const irrklang::vec3df& target);
+	void playMusic(const char* filename, bool looped);
+	void stopAll();
+
+	//! Number of commands dropped because the ring was full
+	int getDroppedCount() const;
+
+private:
+
+	struct alignas(64) SLOT {
+		std::atomic<unsigned> sequence;
+		AUDIOCOMMAND command;
+	};
+
+	void push(const AUDIOCOMMAND& command);
+	bool pop(AUDIOCOMMAND& command);
+	bool isEmpty() const;
+	void execute(const AUDIOCOMMAND& command);
+	void run();
+
+	SLOT Slots[AUDIOQUEUE_SIZE];
+	alignas(64) std::atomic<unsigned> Head; // next slot to claim, shared by producers
+	alignas(64) unsigned Tail;              // next slot to read, audio thread only
+	std::atomic<int> Dropped;
+
+	std::atomic<bool> Running;
+	std::thread Thread;
+	std::atomic<bool> Parked; // the audio thread is about to wait or waiting on Wake
+	std::mutex ParkMutex;
+	std::condition_variable Wake;
+
+	irrklang::ISoundEngine* Engine;
+	SoundBank Bank;
+};
+
+#endif
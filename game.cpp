@@ -5,19 +5,26 @@
 #include <fstream>
 #include <vector>
 #include <stdlib.h>
+#include <string.h>
 #define GLM_FORCE_RADIANS
 #include <glm/glm.hpp>
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <irrKlang.h>
 #include <glad/glad.h>
-#include <FTGL/ftgl.h>
 #include <GLFW/glfw3.h>
 #include <SOIL/SOIL.h>
+#include "assetpack.h"
+#include "audioqueue.h"
+#include "input.h"
+#include "profiler.h"
+#include "gputimer.h"
+#include "hudtext.h"
 #define PI 3.141592653589
 using namespace std;
 
 irrklang::ISoundEngine *SoundEngine = irrklang::createIrrKlangDevice();
+AudioQueue Audio; // all sound goes through the audio thread
 GLfloat fov = 70;
 
 //Structures
@@ -44,8 +51,9 @@ typedef struct CUBE CUBE;
 
 struct COIN {
 	GLfloat posx ,posy,posz;
-	bool is_collected;
-	VAO *vao;
+	GLfloat phase; // starting angle of the spin
+	int cube;      // pillar the coin sits on, coins ride the moving pillars
+	int id;        // stable handle used by the coin grid
 };
 typedef struct COIN COIN;
 
@@ -70,13 +78,52 @@ struct GLMatrices {
 	GLuint TexMatrixID; // For use with texture shader
 } Matrices;
 
-struct FTGLFont {
-	FTFont* font;
-	GLuint fontMatrixID;
-	GLuint fontColorID;
-} GL3Font;
+GLuint programID, hudProgramID, textureProgramID;
+
+// All assets are looked up in the pack first, loose files are the fallback
+AssetPack Assets;
 
-GLuint programID, fontProgramID, textureProgramID;
+// Score, timer and frame time text
+HudText Hud;
+
+/* Read a shader source from the asset pack or from the file */
+std::string readShaderSource(const char * file_path)
+{
+	std::string ShaderCode;
+	ASSET asset;
+	if(Assets.find(file_path, &asset))
+	{
+		ShaderCode.assign((const char *)asset.data, asset.size);
+		return ShaderCode;
+	}
+
+	std::ifstream ShaderStream(file_path, std::ios::in);
+	if(ShaderStream.is_open())
+	{
+		std::string Line = "";
+		while(getline(ShaderStream, Line))
+			ShaderCode += "\n" + Line;
+		ShaderStream.close();
+	}
+	return ShaderCode;
+}
+
+#define HUD_FONT "SourceCodePro-Regular.ttf" // SIL Open Font License, see SourceCodePro-OFL.txt
+#define HUD_FONT_SIZE 20
+
+/* Build the HUD's glyph atlas from the asset pack or from the file */
+bool loadhudfont(const char * file_path)
+{
+	ASSET asset;
+	if(Assets.find(file_path, &asset))
+		return Hud.load(asset.data, asset.size, HUD_FONT_SIZE, hudProgramID);
+
+	std::ifstream FontStream(file_path, std::ios::in | std::ios::binary);
+	if(!FontStream.is_open())
+		return false;
+	std::vector<unsigned char> font((std::istreambuf_iterator<char>(FontStream)), std::istreambuf_iterator<char>());
+	return !font.empty() && Hud.load(&font[0], font.size(), HUD_FONT_SIZE, hudProgramID);
+}
 
 /* Function to load Shaders - Use it as it is */
 GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path) {
@@ -85,26 +132,9 @@ GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path
 	GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
 	GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
 
-	// Read the Vertex Shader code from the file
-	std::string VertexShaderCode;
-	std::ifstream VertexShaderStream(vertex_file_path, std::ios::in);
-	if(VertexShaderStream.is_open())
-	{
-		std::string Line = "";
-		while(getline(VertexShaderStream, Line))
-			VertexShaderCode += "\n" + Line;
-		VertexShaderStream.close();
-	}
-
-	// Read the Fragment Shader code from the file
-	std::string FragmentShaderCode;
-	std::ifstream FragmentShaderStream(fragment_file_path, std::ios::in);
-	if(FragmentShaderStream.is_open()){
-		std::string Line = "";
-		while(getline(FragmentShaderStream, Line))
-			FragmentShaderCode += "\n" + Line;
-		FragmentShaderStream.close();
-	}
+	// Read the Vertex and Fragment Shader code
+	std::string VertexShaderCode = readShaderSource(vertex_file_path);
+	std::string FragmentShaderCode = readShaderSource(fragment_file_path);
 
 	GLint Result = GL_FALSE;
 	int InfoLogLength;
@@ -160,8 +190,24 @@ static void error_callback(int error, const char* description)
 	cout << "Error: " << description << endl;
 }
 
+// Chrome trace written on exit when started with -profile <file>
+const char* profilefile = 0;
+GpuTimer GpuPasses;
+
+void saveprofile()
+{
+	if (!profilefile)
+		return;
+	Profiler::printStats();
+	if (Profiler::writeTrace(profilefile))
+		cout << "Profile written to " << profilefile << endl;
+}
+
 void quit(GLFWwindow *window)
 {
+	saveprofile();
+	GpuPasses.release();
+	Hud.release();
 	glfwDestroyWindow(window);
 	glfwTerminate();
 	exit(EXIT_SUCCESS);
@@ -350,9 +396,14 @@ GLuint createTexture (const char* filename)
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
-	// Load image and create OpenGL texture
+	// Load image (decoded straight from the asset pack if it has it) and create OpenGL texture
 	int twidth, theight;
-	unsigned char* image = SOIL_load_image(filename, &twidth, &theight, 0, SOIL_LOAD_RGB);
+	unsigned char* image;
+	ASSET asset;
+	if (Assets.find(filename, &asset))
+		image = SOIL_load_image_from_memory(asset.data, asset.size, &twidth, &theight, 0, SOIL_LOAD_RGB);
+	else
+		image = SOIL_load_image(filename, &twidth, &theight, 0, SOIL_LOAD_RGB);
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, twidth, theight, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
 	glGenerateMipmap(GL_TEXTURE_2D); // Generate MipMaps to use
 	SOIL_free_image_data(image); // Free the data read from file after creating opengl texture
@@ -377,11 +428,16 @@ bool playerview = false;
 bool towerview =false;
 bool is_collide =false;
 VAO *axises;
+VAO *fade;
 CUBE cubes[100];
-COIN coins[54];
+// Live coins are packed at the front, collected ones are swapped out
+#define COIN_MAX 256
+COIN coins[COIN_MAX];
+int coincount = 0, cointotal = 0;
 PLAYER player;
 SEA sea[1000];
 int flag=0;
+Input Keys;
 
 // To change the view
 void changeview()
@@ -416,9 +472,29 @@ void changeview()
 	}
 }
 
+// Maps a key to the action it drives, INPUT_COUNT for any other key
+INPUT_ACTION keyaction(int key)
+{
+	switch (key) {
+		case GLFW_KEY_W:
+			return INPUT_FORWARD;
+		case GLFW_KEY_S:
+			return INPUT_BACK;
+		case GLFW_KEY_A:
+			return INPUT_LEFT;
+		case GLFW_KEY_D:
+			return INPUT_RIGHT;
+		case GLFW_KEY_SPACE:
+			return INPUT_JUMP;
+		default:
+			return INPUT_COUNT;
+	}
+}
+
 void keyboard (GLFWwindow* window, int key, int scancode, int action, int mods)
 {
-	// Function is called first on GLFW_PRESS.
+	// Movement keys are only recorded here, draw() latches them once per tick.
+	INPUT_ACTION inputaction = keyaction(key);
 
 	if (action == GLFW_PRESS) {
 		switch (key) {
@@ -428,207 +504,15 @@ void keyboard (GLFWwindow* window, int key, int scancode, int action, int mods)
 			case GLFW_KEY_T:
 				changeview();
 				break;
-			case GLFW_KEY_W:
-				if(playerview == true || followview == true)
-				{	
-					glm::vec3 xaxis( 1.0, 0.0 ,0.0);
-  					glm::vec3 zaxis( 0.0, 0.0 ,1.0);
-					glm::vec3 eye (eyex,eyey,eyez);
-					glm::vec3 target (tarx, tary, tarz);
-					glm::vec3 difference = target - eye;
-					angx = glm::dot(difference,xaxis);
-					angz = glm::dot(difference,zaxis);
-					player.velz = 0.02;
-					player.velx = 0.02;
-					player.velz *= angz;
-					player.velx *= angx;
-				}
-				else
-					player.velz = -0.1;
-				break;
-			case GLFW_KEY_S:
-				if(playerview == true || followview == true )
-				{	
-					glm::vec3 xaxis( 1.0, 0.0 ,0.0);
-  					glm::vec3 zaxis( 0.0, 0.0 ,1.0);
-					glm::vec3 eye (eyex,eyey,eyez);
-					glm::vec3 target (tarx, tary, tarz);
-					glm::vec3 difference = target - eye;
-					angx = glm::dot(difference,xaxis);
-					angz = glm::dot(difference,zaxis);
-					player.velz = 0.02;
-					player.velx = 0.02;
-					player.velz *= -angz;
-					player.velx *= -angx;
-				}
-				else
-					player.velz = 0.1;
-				break;
-			case GLFW_KEY_A:
-				if(playerview == true || followview == true)
-				{	
-					glm::vec3 xaxis( 1.0, 0.0 ,0.0);
-  					glm::vec3 zaxis( 0.0, 0.0 ,1.0);
-  					glm::vec3 yaxis( 0.0, 1.0 ,0.0);
-					glm::vec3 eye (eyex,eyey,eyez);
-					glm::vec3 target (tarx, tary, tarz);
-					glm::vec3 difference = target - eye;
-					glm::vec3 perpendicular = glm::cross(difference,yaxis);
-					angx = glm::dot(perpendicular,xaxis);
-					angz = glm::dot(perpendicular,zaxis);
-					player.velz = 0.02;
-					player.velx = 0.02;
-					player.velz *= -angz;
-					player.velx *= -angx;
-				}
-				else
-					player.velx = -0.1;
-				
-				break;
-			case GLFW_KEY_D:
-				if(playerview == true || followview == true)
-				{	
-					glm::vec3 xaxis( 1.0, 0.0 ,0.0);
-  					glm::vec3 zaxis( 0.0, 0.0 ,1.0);
-  					glm::vec3 yaxis( 0.0, 1.0 ,0.0);
-					glm::vec3 eye (eyex,eyey,eyez);
-					glm::vec3 target (tarx, tary, tarz);
-					glm::vec3 difference = target - eye;
-					glm::vec3 perpendicular = glm::cross(difference,yaxis);
-					angx = glm::dot(perpendicular,xaxis);
-					angz = glm::dot(perpendicular,zaxis);
-					player.velz = 0.02;
-					player.velx = 0.02;
-					player.velz *= angz;
-					player.velx *= angx;
-				}
-				else
-					player.velx = 0.1;
-				
-				break;
-			case GLFW_KEY_SPACE :
-				if(is_collide == true)
-				{
-					SoundEngine->play2D("blurp.wav", GL_FALSE);
-					player.vely += 0.1;
-				}
-				break;
 			default:
+				if (inputaction != INPUT_COUNT)
+					Keys.press(inputaction);
 				break;
 		}
 	}
-	else if (action == GLFW_REPEAT) {
-        switch (key) {
-            case GLFW_KEY_W:
-				if(playerview == true || followview == true)
-				{	
-					glm::vec3 xaxis( 1.0, 0.0 ,0.0);
-  					glm::vec3 zaxis( 0.0, 0.0 ,1.0);
-					glm::vec3 eye (eyex,eyey,eyez);
-					glm::vec3 target (tarx, tary, tarz);
-					glm::vec3 difference = target - eye;
-					angx = glm::dot(difference,xaxis);
-					angz = glm::dot(difference,zaxis);
-					player.velz = 0.02;
-					player.velx = 0.02;
-					player.velz *= angz;
-					player.velx *= angx;
-				}
-				else
-					player.velz = -0.1;
-				break;
-				
-			case GLFW_KEY_S:
-				if(playerview == true || followview == true)
-				{	
-					glm::vec3 xaxis( 1.0, 0.0 ,0.0);
-  					glm::vec3 zaxis( 0.0, 0.0 ,1.0);
-					glm::vec3 eye (eyex,eyey,eyez);
-					glm::vec3 target (tarx, tary, tarz);
-					glm::vec3 difference = target - eye;
-					angx = glm::dot(difference,xaxis);
-					angz = glm::dot(difference,zaxis);
-					player.velz = 0.02;
-					player.velx = 0.02;
-					player.velz *= -angz;
-					player.velx *= -angx;
-				}
-				else
-					player.velz = -0.1;
-				break;
-				
-			case GLFW_KEY_A:
-				if(playerview == true || followview == true )
-				{	
-					glm::vec3 xaxis( 1.0, 0.0 ,0.0);
-  					glm::vec3 zaxis( 0.0, 0.0 ,1.0);
-  					glm::vec3 yaxis( 0.0, 1.0 ,0.0);
-					glm::vec3 eye (eyex,eyey,eyez);
-					glm::vec3 target (tarx, tary, tarz);
-					glm::vec3 difference = target - eye;
-					glm::vec3 perpendicular = glm::cross(difference,yaxis);
-					angx = glm::dot(perpendicular,xaxis);
-					angz = glm::dot(perpendicular,zaxis);
-					player.velz = 0.02;
-					player.velx = 0.02;
-					player.velz *= -angz;
-					player.velx *= -angx;
-				}
-				else
-					player.velx = -0.1;
-				break;
-			case GLFW_KEY_D:
-				if(playerview == true || followview == true)
-				{	
-					glm::vec3 xaxis( 1.0, 0.0 ,0.0);
-  					glm::vec3 zaxis( 0.0, 0.0 ,1.0);
-  					glm::vec3 yaxis( 0.0, 1.0 ,0.0);
-					glm::vec3 eye (eyex,eyey,eyez);
-					glm::vec3 target (tarx, tary, tarz);
-					glm::vec3 difference = target - eye;
-					glm::vec3 perpendicular = glm::cross(difference,yaxis);
-					angx = glm::dot(perpendicular,xaxis);
-					angz = glm::dot(perpendicular,zaxis);
-					player.velz = 0.02;
-					player.velx = 0.02;
-					player.velz *= angz;
-					player.velx *= angx;
-				}
-				else
-					player.velx = 0.1;
-				
-				break;
-			
-			default:
-				break;
-        }
-    }
-
-    else if (action == GLFW_RELEASE) {
-		switch (key) {
-			case GLFW_KEY_W:
-				player.velz =0;
-				player.velx =0;
-				
-				break;
-			case GLFW_KEY_S:
-				player.velz = 0;
-				player.velx=0;
-				
-				break;
-			case GLFW_KEY_A:
-				player.velx = 0;
-				player.velz = 0;
-				break;
-			case GLFW_KEY_D:
-				player.velx = 0;
-				player.velz = 0;
-
-				break;
-			
-			default:
-				break;
-		}
+	else if (action == GLFW_RELEASE) {
+		if (inputaction != INPUT_COUNT)
+			Keys.release(inputaction);
 	}
 }
 
@@ -732,6 +616,22 @@ void createaxis ()
 	axises = create3DObject(GL_LINES, 6, vertex_buffer_data, color_buffer_data, GL_LINE);
 }
 
+// Creates the full screen quad used to fade out on death
+void createfade ()
+{
+	// already in clip space, drawn with an identity MVP
+	static const GLfloat vertex_buffer_data [] = {
+		-1,-1,0,
+		1,-1,0,
+		1,1,0,
+		-1,-1,0,
+		1,1,0,
+		-1,1,0
+	};
+
+	fade = create3DObject(GL_TRIANGLES, 6, vertex_buffer_data, 0, 0, 0, GL_FILL);
+}
+
 
 // Creates the player object
 
@@ -1191,6 +1091,178 @@ CUBE movecube(CUBE cube)
 	return cube;
 
 }
+
+/* Coins sit on the pillar tops. Pickups only test the coins hashed into the
+   grid cells around the player, and all live coins are drawn by one instanced
+   call which spins them in the vertex shader. */
+#define COIN_HEIGHT 3.6    // above the pillar's centre
+#define COIN_PICKUP 0.7    // distance from the player's centre
+#define COIN_CELL 2.1      // grid cell size, one pillar
+#define COIN_HASH_SIZE 256 // buckets, must be a power of two
+int coinbucket[COIN_HASH_SIZE]; // first coin id in each bucket, -1 if empty
+int coinnext[COIN_MAX];         // next coin id in the same bucket
+int coinslot[COIN_MAX];         // index of each coin id in coins[]
+VAO *coinmesh;
+GLuint coininstances; // per coin x, y, z and spin phase
+GLuint coinProgramID, coinVPID, coinTimeID;
+
+int coincell(GLfloat pos)
+{
+	return (int)floor(pos / COIN_CELL);
+}
+
+int coinhash(int cellx, int cellz)
+{
+	return ((cellx * 73856093) ^ (cellz * 19349663)) & (COIN_HASH_SIZE - 1);
+}
+
+// Placing a coin on every pillar but the first and building the shared mesh
+void createcoins()
+{
+	for (int i = 0; i < COIN_HASH_SIZE; i++)
+		coinbucket[i] = -1;
+
+	coincount = 0;
+	for (int j = 1; j < 100 && coincount < COIN_MAX; j++)
+	{
+		if(cubes[j].missing == true)
+			continue;
+		COIN& coin = coins[coincount];
+		coin.posx = cubes[j].posx;
+		coin.posy = cubes[j].posy + COIN_HEIGHT;
+		coin.posz = cubes[j].posz;
+		coin.phase = (rand() % 360) * PI / 180;
+		coin.cube = j;
+		coin.id = coincount;
+		coinslot[coin.id] = coincount;
+
+		int bucket = coinhash(coincell(coin.posx), coincell(coin.posz));
+		coinnext[coin.id] = coinbucket[bucket];
+		coinbucket[bucket] = coin.id;
+		coincount++;
+	}
+	cointotal = coincount;
+
+	// a disc standing in the xy plane: two faces and a rim
+	const int segments = 16;
+	const GLfloat radius = 0.3, thickness = 0.04;
+	GLfloat vertex_buffer_data[segments * 12 * 3];
+	GLfloat color_buffer_data[segments * 12 * 3];
+	int n = 0;
+	for (int i = 0; i < segments; i++)
+	{
+		GLfloat a0 = 2 * PI * i / segments, a1 = 2 * PI * (i + 1) / segments;
+		GLfloat x0 = radius * cos(a0), y0 = radius * sin(a0);
+		GLfloat x1 = radius * cos(a1), y1 = radius * sin(a1);
+		GLfloat face[12][3] = {
+			{ 0, 0, thickness }, { x0, y0, thickness }, { x1, y1, thickness },
+			{ 0, 0, -thickness }, { x1, y1, -thickness }, { x0, y0, -thickness },
+			{ x0, y0, thickness }, { x0, y0, -thickness }, { x1, y1, -thickness },
+			{ x0, y0, thickness }, { x1, y1, -thickness }, { x1, y1, thickness },
+		};
+		for (int k = 0; k < 12; k++, n++)
+		{
+			bool rim = k >= 6;
+			bool centre = (k == 0 || k == 3);
+			vertex_buffer_data[n*3] = face[k][0];
+			vertex_buffer_data[n*3 + 1] = face[k][1];
+			vertex_buffer_data[n*3 + 2] = face[k][2];
+			color_buffer_data[n*3] = rim ? 0.7 : 1.0;
+			color_buffer_data[n*3 + 1] = rim ? 0.5 : (centre ? 0.9 : 0.75);
+			color_buffer_data[n*3 + 2] = rim ? 0.0 : (centre ? 0.3 : 0.1);
+		}
+	}
+	coinmesh = create3DObject(GL_TRIANGLES, n, vertex_buffer_data, color_buffer_data, GL_FILL);
+
+	// attribute 3 steps once per coin instead of once per vertex
+	glBindVertexArray(coinmesh->VertexArrayID);
+	glGenBuffers(1, &coininstances);
+	glBindBuffer(GL_ARRAY_BUFFER, coininstances);
+	glBufferData(GL_ARRAY_BUFFER, COIN_MAX*4*sizeof(GLfloat), NULL, GL_STREAM_DRAW);
+	glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, 0, (void*)0);
+	glVertexAttribDivisor(3, 1);
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	glEnableVertexAttribArray(3);
+	glBindVertexArray(0);
+
+	coinProgramID = LoadShaders( "Coin.vert", "Sample_GL3.frag" );
+	coinVPID = glGetUniformLocation(coinProgramID, "VP");
+	coinTimeID = glGetUniformLocation(coinProgramID, "time");
+}
+
+// Picking up the coins near the player, only the 3x3 cells around it are tested
+void collectcoins()
+{
+	int cellx = coincell(player.posx), cellz = coincell(player.posz);
+	for (int dx = -1; dx <= 1; dx++)
+	{
+		for (int dz = -1; dz <= 1; dz++)
+		{
+			int* link = &coinbucket[coinhash(cellx + dx, cellz + dz)];
+			while (*link != -1)
+			{
+				int id = *link;
+				int slot = coinslot[id];
+				glm::vec3 difference(coins[slot].posx - player.posx, coins[slot].posy - player.posy, coins[slot].posz - player.posz);
+				if (glm::length(difference) >= COIN_PICKUP)
+				{
+					link = &coinnext[id];
+					continue;
+				}
+
+				Audio.play3D(SOUND_COIN, irrklang::vec3df(coins[slot].posx, coins[slot].posy, coins[slot].posz));
+				*link = coinnext[id];
+
+				// swap and pop, the last live coin takes the collected one's slot
+				coins[slot] = coins[--coincount];
+				coinslot[coins[slot].id] = slot;
+			}
+		}
+	}
+}
+
+// Rendering all live coins with one instanced draw
+void drawcoins(glm::mat4 VP)
+{
+	if (coincount == 0)
+		return;
+
+	GLfloat instances[COIN_MAX*4];
+	for (int i = 0; i < coincount; i++)
+	{
+		coins[i].posy = cubes[coins[i].cube].posy + COIN_HEIGHT;
+		instances[i*4] = coins[i].posx;
+		instances[i*4 + 1] = coins[i].posy;
+		instances[i*4 + 2] = coins[i].posz;
+		instances[i*4 + 3] = coins[i].phase;
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, coininstances);
+	glBufferData(GL_ARRAY_BUFFER, COIN_MAX*4*sizeof(GLfloat), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, coincount*4*sizeof(GLfloat), instances);
+
+	glUseProgram(coinProgramID);
+	glUniformMatrix4fv(coinVPID, 1, GL_FALSE, &VP[0][0]);
+	glUniform1f(coinTimeID, glfwGetTime());
+	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	glBindVertexArray(coinmesh->VertexArrayID);
+	glDrawArraysInstanced(GL_TRIANGLES, 0, coinmesh->NumVertices, coincount);
+}
+
+// Respawn state machine, driven by glfwGetTime() so the frame loop never blocks
+enum PLAYER_STATE {
+	PLAYER_ALIVE,
+	PLAYER_DYING,     // sinking into the sea while the screen fades out
+	PLAYER_RESPAWNING // back on the first pillar while the screen fades in
+};
+#define DYING_TIME 1.0
+#define RESPAWNING_TIME 0.5
+#define SINK_SPEED 1.2 // units per second while dying
+PLAYER_STATE playerstate = PLAYER_ALIVE;
+double statetime = 0; // time at which playerstate was entered
+float fadeamount = 0; // 0 = clear, 1 = black
+float deathy = 0; // height at which the player hit the sea
+
 float camera_rotation_angle = 90;
 float rectangle_rotation = 0;
 float triangle_rotation = 0;
@@ -1199,6 +1271,7 @@ GLfloat timenow=0,timethen=0,gravitypower = -0.25;
 // gravity
 void gravity()
 {
+	PROFILE_SCOPE("gravity");
 	 timenow = glfwGetTime();
 	 player.vely += gravitypower *(timenow-timethen);
 	 // player.posy += player.vely;
@@ -1209,6 +1282,7 @@ void gravity()
 // updating position
 void updateplayer()
 {
+	PROFILE_SCOPE("updateplayer");
 	player.posx +=player.velx;
 	player.posy += player.vely;
 	player.posz += player.velz;
@@ -1338,19 +1412,133 @@ PLAYER collision(PLAYER player, CUBE cube) // AABB - Circle collision
 //Restarting player
 void restartplayer()
 {
-	SoundEngine->play2D("bubbling1.wav", GL_FALSE);
-	sleep(1);
 	player.posx=cubes[0].posx;
 	player.posy = cubes[0].posy +3.5;
 	player.posz = cubes[0].posz ;
 	player.vely =0;
 }
+
+// Advancing the respawn state machine
+void updaterespawn()
+{
+	double now = glfwGetTime();
+	double elapsed = now - statetime;
+
+	switch (playerstate)
+	{
+		case PLAYER_ALIVE:
+			if(player.posy <= 0)
+			{
+				Audio.play3D(SOUND_DEATH, irrklang::vec3df(player.posx, player.posy, player.posz));
+				player.velx = 0;
+				player.vely = 0;
+				player.velz = 0;
+				playerstate = PLAYER_DYING;
+				statetime = now;
+				deathy = player.posy;
+			}
+			fadeamount = 0;
+			break;
+		case PLAYER_DYING:
+			player.posy = deathy - SINK_SPEED * elapsed;
+			if(elapsed >= DYING_TIME)
+			{
+				restartplayer();
+				playerstate = PLAYER_RESPAWNING;
+				statetime = now;
+				elapsed = 0;
+			}
+			fadeamount = elapsed / DYING_TIME;
+			break;
+		case PLAYER_RESPAWNING:
+			if(elapsed >= RESPAWNING_TIME)
+			{
+				playerstate = PLAYER_ALIVE;
+				elapsed = RESPAWNING_TIME;
+				// gravity() didn't run while respawning, start integrating from now
+				timethen = now;
+			}
+			fadeamount = 1 - elapsed / RESPAWNING_TIME;
+			break;
+	}
+}
+// Deriving the player's velocity from the latched keys and the current camera
+void moveplayer(INPUTSTATE keys)
+{
+	float forward = keys.isHeld(INPUT_FORWARD) - keys.isHeld(INPUT_BACK);
+	float right = keys.isHeld(INPUT_RIGHT) - keys.isHeld(INPUT_LEFT);
+
+	if(playerview == true || followview == true)
+	{
+		glm::vec3 yaxis( 0.0, 1.0 ,0.0);
+		glm::vec3 eye (eyex,eyey,eyez);
+		glm::vec3 target (tarx, tary, tarz);
+		glm::vec3 difference = target - eye;
+		glm::vec3 perpendicular = glm::cross(difference,yaxis);
+		glm::vec3 move = forward*difference + right*perpendicular;
+		player.velx = 0.02 * move.x;
+		player.velz = 0.02 * move.z;
+
+		// collision() pushes the player along the last axis it moved on
+		if(forward != 0)
+		{
+			angx = difference.x;
+			angz = difference.z;
+		}
+		else if(right != 0)
+		{
+			angx = perpendicular.x;
+			angz = perpendicular.z;
+		}
+	}
+	else
+	{
+		player.velx = 0.1 * right;
+		player.velz = -0.1 * forward;
+	}
+}
+
+// Frame time shown on the HUD, smoothed over a few dozen frames
+double hudlasttime = 0, hudframetime = 0;
+
+// Queuing this frame's HUD strings
+void updatehud()
+{
+	double now = glfwGetTime();
+	if(hudlasttime > 0)
+		hudframetime += (now - hudlasttime - hudframetime) * 0.05;
+	hudlasttime = now;
+
+	char text[64];
+	snprintf(text, sizeof(text), "Coins %d/%d", cointotal - coincount, cointotal);
+	Hud.print(10, 10, text, 1, 0.85, 0.2);
+	snprintf(text, sizeof(text), "Time %.1f s", now);
+	Hud.print(10, 10 + Hud.getLineHeight(), text);
+	if(hudframetime > 0)
+	{
+		snprintf(text, sizeof(text), "%.0f fps  %.2f ms", 1 / hudframetime, hudframetime * 1000);
+		Hud.print(10, 10 + 2 * Hud.getLineHeight(), text, 0.7, 0.7, 0.7);
+	}
+}
+
 void draw ()
 {
+	PROFILE_SCOPE("draw");
+	GpuPasses.beginFrame();
+	ProfileScope camerascope("camera");
+
 	// clear the color and depth in the frame buffer
 	glClear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 	glUseProgram (programID);
 	glm::vec3 up (0, 1, 0);
+
+	// one input snapshot per tick, jumping uses the previous tick's collisions
+	INPUTSTATE keys = Keys.latch();
+	if(keys.wasPressed(INPUT_JUMP) && is_collide == true)
+	{
+		Audio.play3D(SOUND_JUMP, irrklang::vec3df(player.posx, player.posy, player.posz));
+		player.vely += 0.1;
+	}
 	is_collide = false;
 	if(towerview == true)
 	{
@@ -1412,20 +1600,31 @@ void draw ()
 	glm::vec3 target (tarx, tary, tarz);
 	Matrices.view = glm::lookAt(eye,target,up); // Fixed camera for 2D (ortho) in XY plane
 
+	// the listener follows the active camera
+	Audio.setListener(irrklang::vec3df(eyex, eyey, eyez), irrklang::vec3df(tarx, tary, tarz));
+
 	glm::mat4 VP = Matrices.projection * Matrices.view;
 	glm::mat4 MVP;	
+	camerascope.end();
 
-	gravity();
-	updateplayer();
+	if(playerstate == PLAYER_ALIVE)
+	{
+		moveplayer(keys);
+		gravity();
+		updateplayer();
+		collectcoins();
+	}
 	//Rendering cubes
 	
 	//flag=0;
+	ProfileScope pillarscope("pillars");
+	GpuPasses.begin("pillar bodies");
+	glUseProgram (programID);
 	for (int j = 0; j < 100; ++j)
 	{
 		
 		if(cubes[j].missing == false)
 		{
-			glUseProgram (programID);
 				if(cubes[j].moving == true)
 				cubes[j] = movecube(cubes[j]);
 			Matrices.model = glm::mat4(1.0f);
@@ -1437,8 +1636,17 @@ void draw ()
 			glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
 		 	draw3DObject(cubes[j].vao);
 		 	player = collision(player,cubes[j]);
+	 	}
+	 }
+	GpuPasses.end();
 
-		 	glUseProgram(textureProgramID);
+	// caps in a second pass so each pass keeps one program bound
+	GpuPasses.begin("pillar caps");
+	glUseProgram(textureProgramID);
+	for (int j = 0; j < 100; ++j)
+	{
+		if(cubes[j].missing == false)
+		{
 		 	Matrices.model = glm::mat4(1.0f);
 
 			glm::mat4 translatetop = glm::translate (glm::vec3(cubes[j].posx, cubes[j].posy+3, cubes[j].posz)); 
@@ -1453,10 +1661,20 @@ void draw ()
 		 	
 	 	}
 	 }	
+	GpuPasses.end();
+	pillarscope.end();
+
+	// Rendering coins
+	ProfileScope coinscope("coins");
+	GpuPasses.begin("coins");
+	drawcoins(VP);
+	GpuPasses.end();
+	coinscope.end();
 	 
 	glUseProgram (programID);
 
 	 //Rendering axises
+	GpuPasses.begin("axes");
 	Matrices.model = glm::mat4(1.0f);
 	glm::mat4 translateaxis = glm::translate (glm::vec3(0.0f, 0.0f, 0.0f)); // glTranslatef
 	glm::mat4 axisTransform = translateaxis;
@@ -1464,8 +1682,11 @@ void draw ()
 	MVP = VP * Matrices.model; // MVP = p * V * M
 	glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
  	draw3DObject(axises);
+	GpuPasses.end();
 
  	 // Rendering Sea
+	ProfileScope seascope("sea");
+	GpuPasses.begin("sea");
  	glUseProgram(textureProgramID);
  	for(int k = 0;k<300;k++)
  	{
@@ -1479,11 +1700,14 @@ void draw ()
 		glUniform1i(glGetUniformLocation(textureProgramID, "texSampler"), 0);
 	 	draw3DTexturedObject(sea[k].vao);
  	}
+	GpuPasses.end();
+	seascope.end();
  	
-	if(player.posy <= 0)
-		restartplayer();
+	updaterespawn();
 
 	 //Rendering Player
+	ProfileScope playerscope("player");
+	GpuPasses.begin("player");
  	glUseProgram(textureProgramID);
 	Matrices.model = glm::mat4(1.0f);
 	glm::mat4 translateplayer = glm::translate (glm::vec3(player.posx, player.posy,player.posz)); // glTranslatef
@@ -1494,6 +1718,30 @@ void draw ()
 	glUniformMatrix4fv(Matrices.TexMatrixID, 1, GL_FALSE, &MVP[0][0]);
 	glUniform1i(glGetUniformLocation(textureProgramID, "texSampler"), 0);
  	draw3DTexturedObject(player.vao);
+	GpuPasses.end();
+	playerscope.end();
+
+ 	// Rendering death fade, blended with a constant alpha since the shaders have no alpha output
+ 	if(fadeamount > 0)
+ 	{
+ 		glUseProgram (programID);
+ 		MVP = glm::mat4(1.0f);
+ 		glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
+ 		glDisable(GL_DEPTH_TEST);
+ 		glBlendColor(0, 0, 0, fadeamount);
+ 		glBlendFunc(GL_CONSTANT_ALPHA, GL_ONE_MINUS_CONSTANT_ALPHA);
+ 		draw3DObject(fade);
+ 		glBlendFunc(GL_ONE, GL_ZERO);
+ 		glEnable(GL_DEPTH_TEST);
+ 	}
+
+	// HUD over everything, all strings in one draw call
+	ProfileScope hudscope("hud");
+	GpuPasses.begin("hud");
+	updatehud();
+	Hud.draw();
+	GpuPasses.end();
+	hudscope.end();
 
 	/*// Render with texture shaders now
 	glUseProgram(textureProgramID);
@@ -1513,32 +1761,10 @@ void draw ()
 	// Increment angles
 	float increments = 1;
 */
-	/*// Render font on screen
-	static int fontScale = 0;
-	float fontScaleValue = 0.75 + 0.25*sinf(fontScale*M_PI/180.0f);
-	glm::vec3 fontColor = getRGBfromHue (fontScale);
-	// Use font Shaders for next part of code
-	glUseProgram(fontProgramID);
-	Matrices.view = glm::lookAt(glm::vec3(0,0,3), glm::vec3(0,0,0), glm::vec3(0,1,0)); // Fixed camera for 2D (ortho) in XY plane
-	// Transform the text
-	Matrices.model = glm::mat4(1.0f);
-	glm::mat4 translateText = glm::translate(glm::vec3(-3,2,0));
-	glm::mat4 scaleText = glm::scale(glm::vec3(fontScaleValue,fontScaleValue,fontScaleValue));
-	Matrices.model *= (translateText * scaleText);
-	MVP = Matrices.projection * Matrices.view * Matrices.model;
-	// send font's MVP and font color to fond shaders
-	glUniformMatrix4fv(GL3Font.fontMatrixID, 1, GL_FALSE, &MVP[0][0]);
-	glUniform3fv(GL3Font.fontColorID, 1, &fontColor[0]);
-	// Render font
-	GL3Font.font->Render("Round n Round we go !!");
-    */
 
 	//camera_rotation_angle++; // Simulating camera rotation
 	//triangle_rotation = triangle_rotation + increments*triangle_rot_dir*triangle_rot_status;
 	//rectangle_rotation = rectangle_rotation + increments*rectangle_rot_dir*rectangle_rot_status;
-
-	// font size and color changes
-	// fontScale = (fontScale + 1) % 360;
 }
 
 /* Initialise glfw window, I/O callbacks and the renderer to use */
@@ -1575,14 +1801,25 @@ GLFWwindow* initGLFW (int width, int height)
 
 void initGL (GLFWwindow* window, int width, int height)
 {
+	// Let irrKlang read sounds from the mapped asset pack
+	if (Assets.isOpen())
+	{
+		AssetPackFileFactory* factory = new AssetPackFileFactory(&Assets);
+		SoundEngine->addFileFactory(factory);
+		factory->drop();
+	}
+	Audio.start(SoundEngine);
+	GpuPasses.init();
+
 	glActiveTexture(GL_TEXTURE0);
 	GLuint seaID = createTexture("lava.png");
 	GLuint playerID = createTexture("textures.jpg");
 	GLuint topID = createTexture("lava2.jpg");
 	textureProgramID = LoadShaders( "TextureRender.vert", "TextureRender.frag" );
 	Matrices.TexMatrixID = glGetUniformLocation(textureProgramID, "MVP");
-	SoundEngine->play2D("background.wav", GL_TRUE);
+	Audio.playMusic("background.wav", true);
 	createaxis();
+	createfade();
 
 	int mark = 0;
 	float positionx =-10,positionz=6,positiony=0;
@@ -1653,6 +1890,7 @@ void initGL (GLFWwindow* window, int width, int height)
 	 	positionz-=160;
 	 }	
 	// sea[i] = create_sea(sea,seaID);
+	createcoins();
 	player = makeplayer(player,playerID);
 	// Create and compile our GLSL program from the shaders
 	programID = LoadShaders( "Sample_GL3.vert", "Sample_GL3.frag" );
@@ -1671,31 +1909,10 @@ void initGL (GLFWwindow* window, int width, int height)
 	glEnable(GL_BLEND);
 	//glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-	// Initialise FTGL stuff
-	//const char* fontfile = "arial.ttf";
-	// GL3Font.font = new FTExtrudeFont(fontfile); // 3D extrude style rendering
-
-	// if(GL3Font.font->Error())
-	// {
-	// 	cout << "Error: Could not load font `" << fontfile << "'" << endl;
-	// 	glfwTerminate();
-	// 	exit(EXIT_FAILURE);
-	// }
-
-	// // Create and compile our GLSL program from the font shaders
-	// fontProgramID = LoadShaders( "fontrender.vert", "fontrender.frag" );
-	// GLint fontVertexCoordAttrib, fontVertexNormalAttrib, fontVertexOffsetUniform;
-	// fontVertexCoordAttrib = glGetAttribLocation(fontProgramID, "vertexPosition");
-	// fontVertexNormalAttrib = glGetAttribLocation(fontProgramID, "vertexNormal");
-	// fontVertexOffsetUniform = glGetUniformLocation(fontProgramID, "pen");
-	// GL3Font.fontMatrixID = glGetUniformLocation(fontProgramID, "MVP");
-	// GL3Font.fontColorID = glGetUniformLocation(fontProgramID, "fontColor");
-
-	// GL3Font.font->ShaderLocations(fontVertexCoordAttrib, fontVertexNormalAttrib, fontVertexOffsetUniform);
-	// GL3Font.font->FaceSize(1);
-	// GL3Font.font->Depth(0);
-	// GL3Font.font->Outset(0, 0);
-	// GL3Font.font->CharMap(ft_encoding_unicode);
+	// HUD text, the font is looked up in the asset pack first
+	hudProgramID = LoadShaders( "HudText.vert", "HudText.frag" );
+	if (!loadhudfont(HUD_FONT))
+		cout << "Error: could not load font `" << HUD_FONT << "', the HUD is disabled" << endl;
 
 	cout << "VENDOR: " << glGetString(GL_VENDOR) << endl;
 	cout << "RENDERER: " << glGetString(GL_RENDERER) << endl;
@@ -1710,15 +1927,33 @@ int main (int argc, char** argv)
 	int width = 1600;
 	int height = 800;
 
+	for (int i = 1; i < argc; i++)
+		if (!strcmp(argv[i], "-profile") && i + 1 < argc)
+			profilefile = argv[++i];
+	if (profilefile)
+	{
+		Profiler::nameThread("main");
+		Profiler::enable(true);
+	}
+
+	if (!Assets.open("assets.pak"))
+		cout << "No asset pack found, loading loose files" << endl;
+
 	GLFWwindow* window = initGLFW(width, height);
 
 	initGL (window, width, height);
 
-	double last_update_time = glfwGetTime(), current_time;
+	double last_update_time = glfwGetTime(), last_stats_time = last_update_time, current_time;
 
 	
 	/* Draw in loop */
 	while (!glfwWindowShouldClose(window)) {
+		PROFILE_SCOPE("frame");
+
+		// Poll for Keyboard and mouse events right before they are latched
+		ProfileScope pollscope("poll");
+		glfwPollEvents();
+		pollscope.end();
 
 		// OpenGL Draw commands
 		draw();
@@ -1726,10 +1961,9 @@ int main (int argc, char** argv)
 		reshapeWindow (window, width, height);
 
 		// Swap Frame Buffer in double buffering
+		ProfileScope swapscope("swap");
 		glfwSwapBuffers(window);
-
-		// Poll for Keyboard and mouse events
-		glfwPollEvents();
+		swapscope.end();
 
 		// Control based on time (Time based transformation like 5 degrees rotation every 0.5s)
 		current_time = glfwGetTime(); // Time in seconds
@@ -1737,8 +1971,15 @@ int main (int argc, char** argv)
 			// do something every 0.5 seconds ..
 			last_update_time = current_time;
 		}
+		if (profilefile && current_time - last_stats_time >= 5) {
+			Profiler::printStats();
+			last_stats_time = current_time;
+		}
 	}
 
+	saveprofile();
+	GpuPasses.release();
+	Hud.release();
 	glfwTerminate();
 	exit(EXIT_SUCCESS);
 }
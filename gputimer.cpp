@@ -0,0 +1,134 @@
+// GPU pass timer
+#include "gputimer.h"
+#include <string.h>
+
+GpuTimer::GpuTimer()
+: Current(0), Depth(0), Overflow(0), Recording(false), Offset(0), FramesSinceCalibration(0), Ring(0)
+{
+	memset(Frames, 0, sizeof(Frames));
+}
+
+GpuTimer::~GpuTimer()
+{
+	// the GL context is usually gone by now, release() has to be called before
+}
+
+void GpuTimer::init()
+{
+	release();
+	for (int i = 0; i < GPUTIMER_FRAMES; i++)
+	{
+		glGenQueries(GPUTIMER_MAX_PASSES * 2, Frames[i].queries);
+		Frames[i].count = 0;
+		Frames[i].issued = false;
+	}
+	Current = 0;
+	Depth = 0;
+	Overflow = 0;
+	Recording = false;
+	FramesSinceCalibration = GPUTIMER_CALIBRATE_FRAMES;
+	if (!Ring)
+		Ring = Profiler::createRing("GPU");
+}
+
+void GpuTimer::release()
+{
+	for (int i = 0; i < GPUTIMER_FRAMES; i++)
+	{
+		if (Frames[i].queries[0])
+			glDeleteQueries(GPUTIMER_MAX_PASSES * 2, Frames[i].queries);
+		memset(Frames[i].queries, 0, sizeof(Frames[i].queries));
+		Frames[i].issued = false;
+	}
+}
+
+// Lines the GPU clock up with Profiler::now(). Reading GL_TIMESTAMP directly
+// doesn't wait for queued commands, so this is cheap but not free.
+void GpuTimer::calibrate()
+{
+	GLint64 gputime;
+	glGetInteger64v(GL_TIMESTAMP, &gputime);
+	Offset = Profiler::now() - gputime;
+	FramesSinceCalibration = 0;
+}
+
+void GpuTimer::collect(FRAME& frame)
+{
+	if (!frame.issued)
+		return;
+	frame.issued = false;
+
+	// queries finish in order, so the last one issued tells about all of them
+	GLint available = 0;
+	glGetQueryObjectiv(frame.queries[frame.last], GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available)
+		return;
+
+	for (int i = 0; i < frame.count; i++)
+	{
+		GLuint64 start, end;
+		glGetQueryObjectui64v(frame.queries[i * 2], GL_QUERY_RESULT, &start);
+		glGetQueryObjectui64v(frame.queries[i * 2 + 1], GL_QUERY_RESULT, &end);
+		Ring->add(frame.passes[i].name, (int64_t)start + Offset, (int64_t)end + Offset, frame.passes[i].depth);
+	}
+}
+
+void GpuTimer::beginFrame()
+{
+	if (!Ring)
+		return;
+
+	// a frame with passes left open is dropped, their end queries were never issued
+	if (Recording && Depth == 0 && Overflow == 0 && Frames[Current].count > 0)
+		Frames[Current].issued = true;
+	Current = (Current + 1) % GPUTIMER_FRAMES;
+
+	// the oldest frame, issued GPUTIMER_FRAMES - 1 frames ago
+	collect(Frames[Current]);
+	Frames[Current].count = 0;
+	Depth = 0;
+	Overflow = 0;
+
+	Recording = Profiler::isEnabled();
+	if (Recording && ++FramesSinceCalibration >= GPUTIMER_CALIBRATE_FRAMES)
+		calibrate();
+}
+
+void GpuTimer::begin(const char* name)
+{
+	if (!Recording)
+		return;
+
+	// passes beyond GPUTIMER_MAX_PASSES aren't timed
+	FRAME& frame = Frames[Current];
+	if (frame.count == GPUTIMER_MAX_PASSES)
+	{
+		Overflow++;
+		return;
+	}
+
+	PASS& pass = frame.passes[frame.count];
+	pass.name = name;
+	pass.depth = Depth;
+	Open[Depth++] = frame.count;
+	frame.last = frame.count * 2;
+	glQueryCounter(frame.queries[frame.last], GL_TIMESTAMP);
+	frame.count++;
+}
+
+void GpuTimer::end()
+{
+	if (!Recording)
+		return;
+	if (Overflow > 0)
+	{
+		Overflow--;
+		return;
+	}
+	if (Depth == 0)
+		return;
+
+	FRAME& frame = Frames[Current];
+	frame.last = Open[--Depth] * 2 + 1;
+	glQueryCounter(frame.queries[frame.last], GL_TIMESTAMP);
+}
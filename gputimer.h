@@ -0,0 +1,72 @@
+// GPU pass timer
+//
+// begin()/end() pairs around a render pass put GL_TIMESTAMP queries into the
+// command stream. Queries are read back GPUTIMER_FRAMES frames later, and only
+// when the GPU reports them available, so reading never stalls the pipeline;
+// a frame whose results still aren't ready when its slot comes around again
+// is dropped. Finished passes go into a "GPU" track of the Profiler, so they
+// show up in the same trace and percentile stats as the CPU scopes. Nothing
+// is recorded while the profiler is disabled.
+//
+// Needs ARB_timer_query, which is core since OpenGL 3.3 and supported by
+// Mesa's llvmpipe.
+
+#ifndef GPUTIMER_H
+#define GPUTIMER_H
+
+#include <stdint.h>
+#include <glad/glad.h>
+#include "profiler.h"
+
+#define GPUTIMER_FRAMES 4      // frames between issuing and reading queries
+#define GPUTIMER_MAX_PASSES 16 // per frame
+#define GPUTIMER_CALIBRATE_FRAMES 300
+
+class GpuTimer
+{
+public:
+
+	GpuTimer();
+	~GpuTimer();
+
+	//! Creates the queries, needs a current GL context
+	void init();
+	void release();
+
+	//! Collects a finished frame and starts recording a new one
+	void beginFrame();
+
+	//! Names must be string literals, passes may nest
+	void begin(const char* name);
+	void end();
+
+private:
+
+	struct PASS {
+		const char* name;
+		int depth;
+	};
+
+	struct FRAME {
+		GLuint queries[GPUTIMER_MAX_PASSES * 2]; // start and end timestamp of each pass
+		PASS passes[GPUTIMER_MAX_PASSES];
+		int count;   // passes begun this frame
+		int last;    // query issued last
+		bool issued; // queries are waiting to be read
+	};
+
+	void collect(FRAME& frame);
+	void calibrate();
+
+	FRAME Frames[GPUTIMER_FRAMES];
+	int Current;
+	int Open[GPUTIMER_MAX_PASSES]; // passes begun but not ended yet
+	int Depth;
+	int Overflow;                  // open passes which didn't fit into the frame
+	bool Recording;                // profiling was enabled at beginFrame()
+	int64_t Offset;                // CPU clock minus GPU clock in nanoseconds
+	int FramesSinceCalibration;
+	ProfileRing* Ring;
+};
+
+#endif
@@ -0,0 +1,204 @@
+// Batched HUD text
+#include "hudtext.h"
+#include <iostream>
+#include <string.h>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+using namespace std;
+
+HudText::HudText()
+: LineHeight(0), Ascender(0), Texture(0), VertexArray(0), VertexBuffer(0), IndexBuffer(0), Program(0),
+  ScreenSizeID(-1), SamplerID(-1)
+{
+	memset(Glyphs, 0, sizeof(Glyphs));
+}
+
+HudText::~HudText()
+{
+	// the GL context is usually gone by now, release() has to be called before
+}
+
+bool HudText::load(const unsigned char* font, size_t size, int pixelsize, GLuint program)
+{
+	release();
+
+	FT_Library library;
+	if (FT_Init_FreeType(&library))
+		return false;
+	FT_Face face;
+	if (FT_New_Memory_Face(library, font, (FT_Long)size, 0, &face))
+	{
+		cout << "Error: could not read HUD font" << endl;
+		FT_Done_FreeType(library);
+		return false;
+	}
+	FT_Set_Pixel_Sizes(face, 0, pixelsize);
+	LineHeight = (int)(face->size->metrics.height >> 6);
+	Ascender = (int)(face->size->metrics.ascender >> 6);
+
+	// shelf packing, one pixel of padding keeps linear filtering from bleeding
+	vector<GLubyte> atlas(HUDTEXT_ATLAS_SIZE * HUDTEXT_ATLAS_SIZE, 0);
+	int x = 1, y = 1, shelf = 0;
+	for (int i = 0; i < HUDTEXT_CHAR_COUNT; i++)
+	{
+		if (FT_Load_Char(face, HUDTEXT_FIRST_CHAR + i, FT_LOAD_RENDER))
+			continue;
+		FT_GlyphSlot slot = face->glyph;
+		int w = slot->bitmap.width, h = slot->bitmap.rows;
+
+		if (x + w + 1 > HUDTEXT_ATLAS_SIZE)
+		{
+			x = 1;
+			y += shelf + 1;
+			shelf = 0;
+		}
+		if (y + h + 1 > HUDTEXT_ATLAS_SIZE)
+		{
+			cout << "Error: HUD font size " << pixelsize << " does not fit the atlas" << endl;
+			break;
+		}
+
+		for (int row = 0; row < h; row++)
+			memcpy(&atlas[(y + row) * HUDTEXT_ATLAS_SIZE + x], slot->bitmap.buffer + row * slot->bitmap.pitch, w);
+
+		GLYPH& glyph = Glyphs[i];
+		glyph.u0 = (GLfloat)x / HUDTEXT_ATLAS_SIZE;
+		glyph.v0 = (GLfloat)y / HUDTEXT_ATLAS_SIZE;
+		glyph.u1 = (GLfloat)(x + w) / HUDTEXT_ATLAS_SIZE;
+		glyph.v1 = (GLfloat)(y + h) / HUDTEXT_ATLAS_SIZE;
+		glyph.width = w;
+		glyph.height = h;
+		glyph.left = slot->bitmap_left;
+		glyph.top = slot->bitmap_top;
+		glyph.advance = (int)(slot->advance.x >> 6);
+
+		x += w + 1;
+		if (h > shelf)
+			shelf = h;
+	}
+	FT_Done_Face(face);
+	FT_Done_FreeType(library);
+
+	// coverage only, the shader takes the colour from the vertices
+	glGenTextures(1, &Texture);
+	glBindTexture(GL_TEXTURE_2D, Texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, HUDTEXT_ATLAS_SIZE, HUDTEXT_ATLAS_SIZE, 0, GL_RED, GL_UNSIGNED_BYTE, &atlas[0]);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	// every glyph is a quad of 4 vertices, the indices never change
+	vector<GLushort> indices(HUDTEXT_MAX_GLYPHS * 6);
+	for (int i = 0; i < HUDTEXT_MAX_GLYPHS; i++)
+	{
+		GLushort v = (GLushort)(i * 4);
+		GLushort quad[6] = { v, (GLushort)(v + 1), (GLushort)(v + 2), v, (GLushort)(v + 2), (GLushort)(v + 3) };
+		memcpy(&indices[i * 6], quad, sizeof(quad));
+	}
+
+	glGenVertexArrays(1, &VertexArray);
+	glBindVertexArray(VertexArray);
+	glGenBuffers(1, &IndexBuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IndexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLushort), &indices[0], GL_STATIC_DRAW);
+	glGenBuffers(1, &VertexBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, VertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, HUDTEXT_MAX_GLYPHS * 4 * sizeof(HUDVERTEX), NULL, GL_STREAM_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(HUDVERTEX), (void*)offsetof(HUDVERTEX, x));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(HUDVERTEX), (void*)offsetof(HUDVERTEX, u));
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(HUDVERTEX), (void*)offsetof(HUDVERTEX, r));
+	glBindVertexArray(0);
+
+	Program = program;
+	ScreenSizeID = glGetUniformLocation(Program, "screenSize");
+	SamplerID = glGetUniformLocation(Program, "texSampler");
+	Vertices.reserve(HUDTEXT_MAX_GLYPHS * 4);
+	return true;
+}
+
+void HudText::release()
+{
+	if (Texture)
+		glDeleteTextures(1, &Texture);
+	if (VertexBuffer)
+		glDeleteBuffers(1, &VertexBuffer);
+	if (IndexBuffer)
+		glDeleteBuffers(1, &IndexBuffer);
+	if (VertexArray)
+		glDeleteVertexArrays(1, &VertexArray);
+	Texture = VertexArray = VertexBuffer = IndexBuffer = 0;
+	Vertices.clear();
+}
+
+void HudText::print(float x, float y, const char* text, float r, float g, float b)
+{
+	if (!Texture)
+		return;
+
+	GLubyte cr = (GLubyte)(r * 255), cg = (GLubyte)(g * 255), cb = (GLubyte)(b * 255);
+	float penx = x, baseline = y + Ascender;
+	for (const char* c = text; *c; c++)
+	{
+		if (*c == '\n')
+		{
+			penx = x;
+			baseline += LineHeight;
+			continue;
+		}
+		int index = (unsigned char)*c - HUDTEXT_FIRST_CHAR;
+		if (index < 0 || index >= HUDTEXT_CHAR_COUNT)
+			index = '?' - HUDTEXT_FIRST_CHAR;
+		const GLYPH& glyph = Glyphs[index];
+
+		if (glyph.width > 0 && Vertices.size() < HUDTEXT_MAX_GLYPHS * 4)
+		{
+			float x0 = penx + glyph.left, y0 = baseline - glyph.top;
+			float x1 = x0 + glyph.width, y1 = y0 + glyph.height;
+			HUDVERTEX quad[4] = {
+				{ x0, y0, glyph.u0, glyph.v0, cr, cg, cb, 255 },
+				{ x0, y1, glyph.u0, glyph.v1, cr, cg, cb, 255 },
+				{ x1, y1, glyph.u1, glyph.v1, cr, cg, cb, 255 },
+				{ x1, y0, glyph.u1, glyph.v0, cr, cg, cb, 255 },
+			};
+			Vertices.insert(Vertices.end(), quad, quad + 4);
+		}
+		penx += glyph.advance;
+	}
+}
+
+void HudText::draw()
+{
+	if (Vertices.empty())
+		return;
+
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+	// orphan the buffer so we never wait for last frame's draw to finish with it
+	glBindBuffer(GL_ARRAY_BUFFER, VertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, HUDTEXT_MAX_GLYPHS * 4 * sizeof(HUDVERTEX), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, Vertices.size() * sizeof(HUDVERTEX), &Vertices[0]);
+
+	glUseProgram(Program);
+	glUniform2f(ScreenSizeID, (GLfloat)viewport[2], (GLfloat)viewport[3]);
+	glUniform1i(SamplerID, 0);
+	glBindTexture(GL_TEXTURE_2D, Texture);
+
+	glDisable(GL_DEPTH_TEST);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glBindVertexArray(VertexArray);
+	glDrawElements(GL_TRIANGLES, (GLsizei)(Vertices.size() / 4 * 6), GL_UNSIGNED_SHORT, 0);
+	glBindVertexArray(0);
+	glBlendFunc(GL_ONE, GL_ZERO);
+	glEnable(GL_DEPTH_TEST);
+
+	Vertices.clear();
+}
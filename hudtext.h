@@ -0,0 +1,71 @@
+// Batched HUD text
+//
+// The printable ASCII glyphs of a TrueType font are rasterised with FreeType
+// into one HUDTEXT_ATLAS_SIZE square atlas texture when the font is loaded.
+// print() only appends glyph quads to a CPU side vertex array; draw() streams
+// them into one vertex buffer and renders every string queued that frame with
+// a single draw call. Positions are in pixels from the top left corner of the
+// viewport.
+
+#ifndef HUDTEXT_H
+#define HUDTEXT_H
+
+#include <stddef.h>
+#include <vector>
+#include <glad/glad.h>
+
+#define HUDTEXT_ATLAS_SIZE 512
+#define HUDTEXT_FIRST_CHAR 32
+#define HUDTEXT_CHAR_COUNT 95  // ' ' to '~'
+#define HUDTEXT_MAX_GLYPHS 4096 // per frame, further glyphs are dropped
+
+struct HUDVERTEX {
+	GLfloat x, y; // pixels
+	GLfloat u, v;
+	GLubyte r, g, b, a;
+};
+
+class HudText
+{
+public:
+
+	HudText();
+	~HudText();
+
+	//! Builds the atlas from a font file in memory. program is the HudText shader.
+	bool load(const unsigned char* font, size_t size, int pixelsize, GLuint program);
+	void release();
+	bool isLoaded() const { return Texture != 0; }
+
+	//! Queues a string, x and y are the top left corner of its first line
+	void print(float x, float y, const char* text, float r = 1, float g = 1, float b = 1);
+
+	//! Draws and clears everything queued since the last draw
+	void draw();
+
+	int getLineHeight() const { return LineHeight; }
+
+private:
+
+	struct GLYPH {
+		GLfloat u0, v0, u1, v1;
+		int width, height;
+		int left, top; // bearing from the pen position to the bitmap's top left
+		int advance;
+	};
+
+	GLYPH Glyphs[HUDTEXT_CHAR_COUNT];
+	std::vector<HUDVERTEX> Vertices;
+	int LineHeight;
+	int Ascender;
+
+	GLuint Texture;
+	GLuint VertexArray;
+	GLuint VertexBuffer;
+	GLuint IndexBuffer;
+	GLuint Program;
+	GLint ScreenSizeID;
+	GLint SamplerID;
+};
+
+#endif
@@ -0,0 +1,27 @@
+// Per-tick input sampling
+#include "input.h"
+
+Input::Input()
+: Held(0), Pressed(0)
+{
+}
+
+void Input::press(INPUT_ACTION action)
+{
+	Held |= 1u << action;
+	Pressed |= 1u << action;
+}
+
+void Input::release(INPUT_ACTION action)
+{
+	Held &= ~(1u << action);
+}
+
+INPUTSTATE Input::latch()
+{
+	INPUTSTATE state;
+	state.held = Held;
+	state.pressed = Pressed;
+	Pressed = 0;
+	return state;
+}
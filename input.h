@@ -0,0 +1,47 @@
+// Per-tick input sampling
+//
+// The GLFW key callback only records which actions are held in a bitset.
+// The simulation latches the bitset once per tick, so every tick works on
+// one consistent snapshot however many key events arrived since the last
+// one, and a key which was pressed and released between two ticks still
+// shows up as pressed.
+
+#ifndef INPUT_H
+#define INPUT_H
+
+enum INPUT_ACTION {
+	INPUT_FORWARD,
+	INPUT_BACK,
+	INPUT_LEFT,
+	INPUT_RIGHT,
+	INPUT_JUMP,
+	INPUT_COUNT
+};
+
+struct INPUTSTATE {
+	unsigned held;    // actions held down at the time of the latch
+	unsigned pressed; // actions pressed since the previous latch
+
+	bool isHeld(INPUT_ACTION action) const { return (held >> action) & 1; }
+	bool wasPressed(INPUT_ACTION action) const { return (pressed >> action) & 1; }
+};
+
+class Input
+{
+public:
+
+	Input();
+
+	void press(INPUT_ACTION action);
+	void release(INPUT_ACTION action);
+
+	//! Returns the current state and starts collecting presses for the next tick
+	INPUTSTATE latch();
+
+private:
+
+	unsigned Held;
+	unsigned Pressed;
+};
+
+#endif
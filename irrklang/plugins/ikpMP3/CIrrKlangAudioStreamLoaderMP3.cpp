@@ -11,7 +11,10 @@ namespace irrklang
 {
 
 
-CIrrKlangAudioStreamLoaderMP3::CIrrKlangAudioStreamLoaderMP3()
+CIrrKlangAudioStreamLoaderMP3::CIrrKlangAudioStreamLoaderMP3(bool decodeAhead, int precision, bool mapInput,
+															 int outputRate, int outputChannels)
+: DecodeAhead(decodeAhead), Precision(precision), MapInput(mapInput),
+	OutputRate(outputRate), OutputChannels(outputChannels)
 {
 }
 
@@ -26,7 +29,8 @@ bool CIrrKlangAudioStreamLoaderMP3::isALoadableFileExtension(const ik_c8* fileNa
 //! Creates an audio file input stream from a file
 IAudioStream* CIrrKlangAudioStreamLoaderMP3::createAudioStream(irrklang::IFileReader* file)
 {
-	CIrrKlangAudioStreamMP3* stream = new CIrrKlangAudioStreamMP3(file);
+	CIrrKlangAudioStreamMP3* stream = new CIrrKlangAudioStreamMP3(file, DecodeAhead, Precision, MapInput,
+		OutputRate, OutputChannels);
 
 	if (stream && !stream->isOK())
 	{
@@ -6,6 +6,7 @@
 #define __C_IRRKLANG_AUDIO_STREAM_LOADER_MP3_H_INCLUDED__
 
 #include <ik_IAudioStreamLoader.h>
+#include "decoder/mpaudec.h"
 
 namespace irrklang
 {
@@ -14,7 +15,12 @@ namespace irrklang
 	{
 	public:
 
-		CIrrKlangAudioStreamLoaderMP3();
+		//! \param decodeAhead: create streams which decode on their own worker thread
+		//! \param precision: arithmetic of the streams' layer 3 decoder, one of MPAUDEC_PRECISION_*
+		//! \param mapInput: create streams which memory map files found on disk
+		//! \param outputRate, outputChannels: format the streams convert to, 0 keeps the file's
+		CIrrKlangAudioStreamLoaderMP3(bool decodeAhead = false, int precision = MPAUDEC_PRECISION_FIXED23,
+			bool mapInput = false, int outputRate = 0, int outputChannels = 0);
 
 		//! Returns true if the file maybe is able to be loaded by this class.
 		/** This decision should be based only on the file extension (e.g. ".wav") */
@@ -25,6 +31,14 @@ namespace irrklang
 		If you no longer need the stream, you should call IAudioFileStream::drop().
 		See IRefCounted::drop() for more information. */
 		virtual IAudioStream* createAudioStream(irrklang::IFileReader* file);
+
+	private:
+
+		bool DecodeAhead;
+		int Precision;
+		bool MapInput;
+		int OutputRate;
+		int OutputChannels;
 	};
 
 } // end namespace irrklang
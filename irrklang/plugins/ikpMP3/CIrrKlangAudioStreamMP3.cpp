@@ -6,16 +6,21 @@
 
 #include "CIrrKlangAudioStreamMP3.h"
 #include <memory.h>
-#include <stdlib.h> // free, malloc and realloc
+#include <stdlib.h>
 #include <string.h>
+#include <algorithm>
 
 namespace irrklang
 {
 
-CIrrKlangAudioStreamMP3::CIrrKlangAudioStreamMP3(IFileReader* file)
-: File(file), TheMPAuDecContext(0), InputPosition(0), InputLength(0),
+CIrrKlangAudioStreamMP3::CIrrKlangAudioStreamMP3(IFileReader* file, bool decodeAhead, int precision,
+												 bool mapInput, int outputRate, int outputChannels)
+: File(file), TheMPAuDecContext(0), Precision(precision), Input(InputBuffer),
+	InputPosition(0), InputLength(0),
 	DecodeBuffer(0), FirstFrameRead(false), EndOfFileReached(0),
-	FileBegin(0), Position(0)
+	FileBegin(0), Position(0), LoopContext(0), LoopHead(0), LoopHeadSize(0), LoopOffset(0),
+	Converter(0), ConvertBuffer(0), ConverterFlushed(false), ConverterHoldsTail(false),
+	DecodeAhead(decodeAhead), Pool(0), AheadEnd(false)
 {
 	if (File)
 	{
@@ -32,10 +37,18 @@ CIrrKlangAudioStreamMP3::CIrrKlangAudioStreamMP3(IFileReader* file)
 			return;
 		}
 
+		TheMPAuDecContext->precision = Precision;
+
 		// init, get format
 
 		DecodeBuffer = new ik_u8[MPAUDEC_MAX_AUDIO_FRAME_SIZE];
 
+		// the mapping is only used if it shows the same file the reader reads,
+		// readers from archives or memory may have names not found on disk
+		if (mapInput && File->getSize()>0 &&
+			(!MappedFile.open(File->getFileName()) || MappedFile.getSize() != File->getSize()))
+			MappedFile.close();
+
 		if (File->getSize()>0)
 		{
 			// seekable file, now parse file to get size
@@ -43,30 +56,11 @@ CIrrKlangAudioStreamMP3::CIrrKlangAudioStreamMP3(IFileReader* file)
 
 			skipID3IfNecessary();
 
-			TheMPAuDecContext->parse_only = 1;
-			Format.FrameCount = 0;
-
-			while(!EndOfFileReached)
-			{
-				if (!decodeFrame())
-					break;
-
-				Format.FrameCount += TheMPAuDecContext->frame_size;
-
-				if (!EndOfFileReached /*&& File->isSeekable()*/ )
-				{
-					// to be able to seek in the stream, store offsets and sizes
-
-					SFramePositionData data;
-					data.size = TheMPAuDecContext->frame_size;
-					data.offset = File->getPos() - (InputLength - InputPosition) - TheMPAuDecContext->coded_frame_size;
+			if (!buildSeekIndex())
+				parseSeekIndex();
 
-					FramePositionData.push_back(data);
-				}
-			}
-
-			TheMPAuDecContext->parse_only = 0;
-			setPosition(0);
+			seekDecoder(0);
+			prepareLoop();
 		}
 		else
 			decodeFrame(); // decode first frame to read audio format
@@ -80,11 +74,24 @@ CIrrKlangAudioStreamMP3::CIrrKlangAudioStreamMP3(IFileReader* file)
 			TheMPAuDecContext = 0;
 			return;
 		}
+
+		createConverter(outputRate, outputChannels);
+
+		if (DecodeAhead)
+		{
+			Pool = CIrrKlangDecoderPool::acquire();
+			startDecodeAhead();
+		}
 	}
 }
 
 CIrrKlangAudioStreamMP3::~CIrrKlangAudioStreamMP3()
 {
+	stopDecodeAhead();
+
+	if (Pool)
+		CIrrKlangDecoderPool::release();
+
 	if (File)
 		File->drop();
 
@@ -94,20 +101,109 @@ CIrrKlangAudioStreamMP3::~CIrrKlangAudioStreamMP3()
 		delete TheMPAuDecContext;
 	}
 
+	if (LoopContext)
+	{
+		mpaudec_clear(LoopContext);
+		delete LoopContext;
+	}
+
 	delete [] DecodeBuffer;
+	delete [] LoopHead;
+	delete Converter;
+	delete [] ConvertBuffer;
 }
 
 
 
+//! sets up Converter if the output format differs from the decoded one
+void CIrrKlangAudioStreamMP3::createConverter(int outputRate, int outputChannels)
+{
+	OutputFormat = Format;
+
+	if (outputRate > 0)
+		OutputFormat.SampleRate = outputRate;
+	if (outputChannels == 1 || outputChannels == 2)
+		OutputFormat.ChannelCount = outputChannels;
+
+	if (OutputFormat.SampleRate == Format.SampleRate &&
+		OutputFormat.ChannelCount == Format.ChannelCount)
+		return;
+
+	// room for any frame the decoder may produce, see readDecodedFrames()
+	Converter = new CIrrKlangPCMConverter(Format.SampleRate, Format.ChannelCount,
+		OutputFormat.SampleRate, OutputFormat.ChannelCount,
+		MPAUDEC_MAX_AUDIO_FRAME_SIZE / Format.getFrameSize());
+	ConvertBuffer = new ik_u8[MPAUDEC_MAX_AUDIO_FRAME_SIZE];
+
+	if (Format.FrameCount >= 0)
+		OutputFormat.FrameCount = Converter->toOutputFrames(Format.FrameCount);
+}
+
+
 //! returns format of the audio stream
 SAudioStreamFormat CIrrKlangAudioStreamMP3::getFormat()
 {
-	return Format;
+	return Converter ? OutputFormat : Format;
 }
 
 
 //! tells the audio stream to read n audio frames into the specified buffer
 ik_s32 CIrrKlangAudioStreamMP3::readFrames(void* target, ik_s32 frameCountToRead)
+{
+	if (!Converter)
+		return readDecodedFrames(target, frameCountToRead);
+
+	ik_s16* out = (ik_s16*)target;
+	int framesRead = 0;
+
+	for (;;)
+	{
+		framesRead += Converter->read(out + framesRead * OutputFormat.ChannelCount,
+			frameCountToRead - framesRead);
+
+		if (framesRead == frameCountToRead || ConverterFlushed)
+			break;
+
+		const int decoded = readDecodedFrames(ConvertBuffer,
+			MPAUDEC_MAX_AUDIO_FRAME_SIZE / Format.getFrameSize());
+
+		if (decoded > 0)
+		{
+			Converter->write((const ik_s16*)ConvertBuffer, decoded);
+			continue;
+		}
+
+		// End of the stream. The short read lets the engine loop, then
+		// setPosition(0) feeds the start of the file in behind the last frames
+		// still under the filter. They are only flushed out with silence if
+		// the engine reads on past the end.
+		if (framesRead > 0)
+		{
+			ConverterHoldsTail = true;
+			break;
+		}
+
+		Converter->flush();
+		ConverterFlushed = true;
+		ConverterHoldsTail = false;
+	}
+
+	return framesRead;
+}
+
+
+//! reads frames as they come from the decoder, before any conversion
+ik_s32 CIrrKlangAudioStreamMP3::readDecodedFrames(void* target, ik_s32 frameCountToRead)
+{
+	if (DecodeAhead)
+		return readFramesAhead(target, frameCountToRead);
+
+	return decodeFrames(target, frameCountToRead);
+}
+
+
+//! decodes on the calling thread, the decoder must not be in the pool
+ik_s32 CIrrKlangAudioStreamMP3::decodeFrames(void* target, ik_s32 frameCountToRead)
 {
 	const int frameSize = Format.getFrameSize();
 
@@ -116,6 +212,22 @@ ik_s32 CIrrKlangAudioStreamMP3::readFrames(void* target, ik_s32 frameCountToRead
 
 	while (framesRead < frameCountToRead)
 	{
+		// the largest frame the decoder can produce fits, decode it straight
+		// into the target. Going by the frame size of the stream isn't enough,
+		// a stereo frame in a mono stream is only refused after decoding it.
+		if (DecodedQueue.getSize() < frameSize &&
+			(frameCountToRead - framesRead) * frameSize >= MPAUDEC_MAX_AUDIO_FRAME_SIZE)
+		{
+			int decoded;
+			if (!decodeFrame(out, &decoded) || EndOfFileReached)
+				return framesRead;
+
+			out += decoded;
+			framesRead += decoded / frameSize;
+			Position += decoded / frameSize;
+			continue;
+		}
+
 		// no more samples?  ask the MP3 for more
 		if (DecodedQueue.getSize() < frameSize)
 		{
@@ -142,28 +254,150 @@ ik_s32 CIrrKlangAudioStreamMP3::readFrames(void* target, ik_s32 frameCountToRead
 }
 
 
+//! readFrames() in decode ahead mode, copies frames the worker thread has decoded
+ik_s32 CIrrKlangAudioStreamMP3::readFramesAhead(void* target, ik_s32 frameCountToRead)
+{
+	const int frameSize = Format.getFrameSize();
+	const int size = frameCountToRead * frameSize;
+
+	ik_u8* out = (ik_u8*)target;
+	int copied = 0;
+
+	while (copied < size)
+	{
+		copied += AheadQueue.read(out + copied, size - copied);
+
+		if (copied == size)
+			break;
+
+		if (AheadEnd.load(std::memory_order_acquire))
+		{
+			// the worker may have published its last frame just before stopping
+			copied += AheadQueue.read(out + copied, size - copied);
+			break;
+		}
+
+		// The pool fell behind. A short read would be taken as the end of
+		// the stream, so decode the rest here. Taking the stream out of the
+		// pool waits for a frame being decoded for it right now, that one
+		// is read first.
+		Pool->remove(this);
+		copied += AheadQueue.read(out + copied, size - copied);
+		Position += copied / frameSize;
+
+		const int decoded = decodeFrames(out + copied, (size - copied) / frameSize);
+
+		startDecodeAhead();
+		return copied / frameSize + decoded;
+	}
+
+	Pool->wake();
+
+	Position += copied / frameSize;
+	return copied / frameSize;
+}
+
+
+//! decodes one mp3 frame into AheadQueue, called by a thread of the decoder pool
+void CIrrKlangAudioStreamMP3::decodeAheadFrame()
+{
+	ik_u8* block = AheadQueue.beginWrite();
+
+	if (!block)
+		return;
+
+	// seeking may have left part of a frame in DecodedQueue, hand that over first
+	int size = DecodedQueue.read(block, MPAUDEC_MAX_AUDIO_FRAME_SIZE);
+
+	if (!size && (!decodeFrame(block, &size) || EndOfFileReached))
+	{
+		AheadEnd.store(true, std::memory_order_release);
+		return;
+	}
+
+	AheadQueue.endWrite(size);
+}
+
+
+//! returns how many microseconds of decoded audio are queued, the pool serves the
+//! lowest first. Returns -1 if there is nothing to decode.
+int CIrrKlangAudioStreamMP3::getAheadBacklog()
+{
+	if (AheadQueue.getBlockCount() >= IKP_MP3_BLOCK_QUEUE_BLOCKS ||
+		AheadEnd.load(std::memory_order_relaxed))
+		return -1;
+
+	// frames of layer 1 hold a third of the samples of layer 3 ones, and the
+	// streams may differ in sample rate, so count time rather than blocks
+	const int frames = AheadQueue.getSize() / Format.getFrameSize();
+	return (int)((long long)frames * 1000000 / Format.SampleRate);
+}
+
 
-bool CIrrKlangAudioStreamMP3::decodeFrame()
+void CIrrKlangAudioStreamMP3::startDecodeAhead()
+{
+	AheadEnd.store(false);
+	Pool->add(this);
+}
+
+
+//! takes the stream out of the pool and drops what was decoded, the decoder has
+//! to be repositioned afterwards
+void CIrrKlangAudioStreamMP3::stopDecodeAhead()
+{
+	if (!Pool)
+		return;
+
+	Pool->remove(this);
+	AheadQueue.clear();
+}
+
+
+
+//! decodes the next mp3 frame into DecodedQueue
+/** If target is given, the frame is decoded into it instead and its size in bytes
+is returned in targetSize. target must have room for MPAUDEC_MAX_AUDIO_FRAME_SIZE
+bytes then, the frame may have more channels than the stream. */
+bool CIrrKlangAudioStreamMP3::decodeFrame(ik_u8* target, int* targetSize)
 {
     int outputSize = 0;
+	ik_u8* output = target ? target : DecodeBuffer;
+
+	if (targetSize)
+		*targetSize = 0;
 
 	while (!outputSize)
 	{
 		if (InputPosition == InputLength)
 		{
 			InputPosition = 0;
-			InputLength = File->read(InputBuffer, IKP_MP3_INPUT_BUFFER_SIZE);
 
-			if (InputLength == 0)
+			if (MappedFile.isOpen())
+			{
+				// hand the rest of the file to the decoder at once. The reader
+				// is moved to its end, so getPos() still tells the position
+				// of the end of the input like after a read().
+				const int pos = File->getPos();
+				Input = MappedFile.getData() + pos;
+				InputLength = MappedFile.getSize() - pos;
+				File->seek(MappedFile.getSize());
+			}
+			else
+			{
+				Input = InputBuffer;
+				InputLength = File->read(InputBuffer, IKP_MP3_INPUT_BUFFER_SIZE);
+			}
+
+			if (InputLength <= 0)
 			{
 				EndOfFileReached = true;
 				return true;
 			}
 		}
 
-		int rv = mpaudec_decode_frame( TheMPAuDecContext, (ik_s16*)DecodeBuffer,
+		int rv = mpaudec_decode_frame( TheMPAuDecContext, (ik_s16*)output,
 									   &outputSize,
-									   (ik_u8*)InputBuffer + InputPosition,
+									   Input + InputPosition,
 									   InputLength - InputPosition);
 
 		if (rv < 0)
@@ -196,11 +430,14 @@ bool CIrrKlangAudioStreamMP3::decodeFrame()
 			// Couldn't decode this frame.  Too bad, already lost it.
 			// This should only happen when seeking.
 
-			outputSize = TheMPAuDecContext->frame_size;
-			memset(DecodeBuffer, 0, outputSize * Format.getFrameSize());
+			outputSize = TheMPAuDecContext->frame_size * Format.getFrameSize();
+			memset(output, 0, outputSize);
 		}
 
-		DecodedQueue.write(DecodeBuffer, outputSize);
+		if (target)
+			*targetSize = outputSize;
+		else
+			DecodedQueue.write(DecodeBuffer, outputSize);
 	}
 
     return true;
@@ -208,11 +445,67 @@ bool CIrrKlangAudioStreamMP3::decodeFrame()
 
 
 
+//! decodes and throws away audio frames, used to reach a seek target
+bool CIrrKlangAudioStreamMP3::skipFrames(int frameCount)
+{
+	const int frameSize = Format.getFrameSize();
+
+	while (frameCount > 0)
+	{
+		if (DecodedQueue.getSize() < frameSize)
+		{
+			if (!decodeFrame() || EndOfFileReached)
+				return false;
+			continue;
+		}
+
+		const int dequeSize = DecodedQueue.getSize() / frameSize;
+		const int framesToSkip = frameCount < dequeSize ? frameCount : dequeSize;
+
+		DecodedQueue.skip(framesToSkip * frameSize);
+
+		frameCount -= framesToSkip;
+		Position += framesToSkip;
+	}
+
+	return true;
+}
+
+
 //! sets the position of the audio stream.
 /** For example to let the stream be read from the beginning of the file again,
 setPosition(0) would be called. This is usually done be the sound engine to
 loop a stream after if has reached the end. Return true if sucessful and 0 if not. */
 bool CIrrKlangAudioStreamMP3::setPosition(ik_s32 pos)
+{
+	if (Converter)
+	{
+		// looping keeps the converter running, so the filter sees no jump
+		// between the end of the file and its start. Anything else starts over.
+		if (pos != 0 || !ConverterHoldsTail)
+		{
+			pos = Converter->toSourceFrames(pos);
+			Converter->reset();
+			ConverterFlushed = false;
+		}
+
+		ConverterHoldsTail = false;
+	}
+
+	if (!DecodeAhead || !isOK())
+		return seekDecoder(pos);
+
+	// the decoder belongs to the worker thread while it runs
+	stopDecodeAhead();
+	const bool ok = seekDecoder(pos);
+	startDecodeAhead();
+
+	return ok;
+}
+
+
+//! moves the decoder to audio frame pos, see setPosition()
+bool CIrrKlangAudioStreamMP3::seekDecoder(ik_s32 pos)
 {
 	if (!File || !TheMPAuDecContext)
 		return false;
@@ -221,21 +514,23 @@ bool CIrrKlangAudioStreamMP3::setPosition(ik_s32 pos)
 	{
 		// usually done for looping, just reset to start
 
-		File->seek(FileBegin); // skip possible ID3 header
+		if (!LoopContext)
+		{
+			resetDecoder(FileBegin); // skip possible ID3 header
+			return true;
+		}
 
-		EndOfFileReached = false;
+		// continue behind the loop head, which then is the first thing read.
+		// Gives the same samples as decoding from the start.
 
-		DecodedQueue.clear();
+		File->seek(LoopOffset);
 
-		MPAuDecContext oldContext = *TheMPAuDecContext;
+		EndOfFileReached = false;
 
-		mpaudec_clear(TheMPAuDecContext);
-		mpaudec_init(TheMPAuDecContext);
+		DecodedQueue.clear();
+		DecodedQueue.write(LoopHead, LoopHeadSize);
 
-		TheMPAuDecContext->bit_rate = oldContext.bit_rate;
-		TheMPAuDecContext->channels = oldContext.channels;
-		TheMPAuDecContext->frame_size = oldContext.frame_size;
-		TheMPAuDecContext->sample_rate = oldContext.sample_rate;
+		mpaudec_copy_state(TheMPAuDecContext, LoopContext);
 
 		InputPosition = 0;
 		InputLength = 0;
@@ -248,57 +543,36 @@ bool CIrrKlangAudioStreamMP3::setPosition(ik_s32 pos)
 	{
 		// user wants to seek in the stream, so do this here
 
-		int scan_position = 0;
-		int target_frame = 0;
-		int frame_count = (int)FramePositionData.size();
+		if (FramePositionData.empty())
+			return false;
 
-		while (target_frame < frame_count)
+		// binary search for the last mp3 frame starting at or before pos
+		int low = 0;
+		int high = (int)FramePositionData.size() - 1;
+		while (low < high)
 		{
-			int frame_size = FramePositionData[target_frame].size;
-
-			if (pos <= scan_position + frame_size)
-				break;
+			int mid = (low + high + 1) / 2;
+			if (FramePositionData[mid].position <= pos)
+				low = mid;
 			else
-			{
-				scan_position += frame_size;
-				target_frame++;
-			}
+				high = mid - 1;
 		}
+		int target_frame = low;
 
-
+		// layer 3 frames may take their data from the frames before them,
+		// so start decoding a few frames earlier and throw that away
 		const int MAX_FRAME_DEPENDENCY = 10;
 		target_frame = std::max(0, target_frame - MAX_FRAME_DEPENDENCY);
-		setPosition(0);
-
-		File->seek(FramePositionData[target_frame].offset, false);
-
-		int i;
-		for (i = 0; i < target_frame; i++)
-		{
-			if (i>=(int)FramePositionData.size())
-			{
-				// internal error
-				setPosition(0);
-				return false;
-			}
+		resetDecoder(FramePositionData[target_frame].offset);
 
-			Position += FramePositionData[i].size;
-		}
+		Position = FramePositionData[target_frame].position;
 
-		if (!decodeFrame() || EndOfFileReached)
+		if (!skipFrames(pos - Position))
 		{
-			setPosition(0);
+			seekDecoder(0);
 			return false;
 		}
 
-		int frames_to_consume = pos - Position; // PCM frames now
-		if (frames_to_consume > 0)
-		{
-			ik_u8 *buf = new ik_u8[frames_to_consume * Format.getFrameSize()];
-			readFrames(buf, frames_to_consume);
-			delete[] buf;
-		}
-
       	return true;
 	}
 
@@ -306,60 +580,175 @@ bool CIrrKlangAudioStreamMP3::setPosition(ik_s32 pos)
 }
 
 
-CIrrKlangAudioStreamMP3::QueueBuffer::QueueBuffer()
+//! starts decoding from scratch at the file offset, without reallocating the decoder
+void CIrrKlangAudioStreamMP3::resetDecoder(ik_s32 offset)
 {
-	Capacity = 256;
-	Size = 0;
+	File->seek(offset);
 
-	Buffer = (ik_u8*)malloc(Capacity);
-}
+	EndOfFileReached = false;
 
+	DecodedQueue.clear();
 
-CIrrKlangAudioStreamMP3::QueueBuffer::~QueueBuffer()
-{
-	free(Buffer);
-}
+	// keeps the format fields of the context, they are known from the seek index
+	mpaudec_reset(TheMPAuDecContext);
 
-int CIrrKlangAudioStreamMP3::QueueBuffer::getSize()
-{
-	return Size;
+	InputPosition = 0;
+	InputLength = 0;
+	Position = 0;
+	CurrentFramePosition = 0;
 }
 
-void CIrrKlangAudioStreamMP3::QueueBuffer::write(const void* buffer, int size)
+
+//! decodes the loop head and keeps it together with the decoder state after it
+/** Called with the decoder at the start of the file. Leaves it there again. */
+void CIrrKlangAudioStreamMP3::prepareLoop()
 {
-	bool needRealloc = false;
+	LoopHead = new ik_u8[MPAUDEC_MAX_AUDIO_FRAME_SIZE];
 
-	while (size + Size > Capacity)
+	if (!decodeFrame(LoopHead, &LoopHeadSize) || EndOfFileReached)
 	{
-		Capacity *= 2;
-		needRealloc = true;
+		delete [] LoopHead;
+		LoopHead = 0;
+		resetDecoder(FileBegin);
+		return;
 	}
 
-    if (needRealloc)
+	LoopContext = new MPAuDecContext();
+
+	if (mpaudec_init(LoopContext) < 0)
 	{
-        Buffer = (ik_u8*)realloc(Buffer, Capacity);
-    }
+		delete LoopContext;
+		LoopContext = 0;
+		delete [] LoopHead;
+		LoopHead = 0;
+		resetDecoder(FileBegin);
+		return;
+	}
 
-	memcpy(Buffer + Size, buffer, size);
-	Size += size;
+	mpaudec_copy_state(LoopContext, TheMPAuDecContext);
+	LoopOffset = File->getPos() - (InputLength - InputPosition);
+
+	seekDecoder(0);
 }
 
 
-int CIrrKlangAudioStreamMP3::QueueBuffer::read(void* buffer, int size)
+//! builds the seek index by walking the frame headers of the file
+/** Only the 4 header bytes of every frame are looked at, no frame is decoded.
+Returns false for free format streams, their frame sizes are not in the headers.
+A free format header after the first frame is skipped like any other false sync. */
+bool CIrrKlangAudioStreamMP3::buildSeekIndex()
 {
-	int toRead = size < Size ? size : Size;
+	const int fileSize = File->getSize();
+	int offset = FileBegin;
+	int position = 0;
+
+	// InputBuffer is used as a window onto the file, a mapped file is one big window
+	const ik_u8* window = InputBuffer;
+	int windowBegin = 0;
+	int windowLength = 0;
+
+	if (MappedFile.isOpen())
+	{
+		window = MappedFile.getData();
+		windowLength = fileSize;
+	}
+
+	MPAuDecHeader first = MPAuDecHeader();
+	bool firstFound = false;
+
+	FramePositionData.clear();
+
+	while (offset + 4 <= fileSize)
+	{
+		if (offset < windowBegin || offset + 4 > windowBegin + windowLength)
+		{
+			windowBegin = offset;
+			File->seek(offset);
+			windowLength = File->read(InputBuffer, IKP_MP3_INPUT_BUFFER_SIZE);
+			if (windowLength < 4)
+				break;
+		}
+
+		MPAuDecHeader header;
+		int rv = mpaudec_parse_header(&header, window + (offset - windowBegin));
+
+		// a stream starting with a free format frame needs parseSeekIndex(), one
+		// turning up later is a false sync in a fixed bit rate stream
+		if (rv == 1 && !firstFound)
+			return false;
+
+		if (rv != 0 || (firstFound &&
+			(header.layer != first.layer ||
+			 header.sample_rate != first.sample_rate ||
+			 header.channels != first.channels)))
+		{
+			// no sync, move by one byte like the decoder does
+			offset++;
+			continue;
+		}
+
+		if (offset + header.coded_frame_size > fileSize)
+			break; // truncated last frame, the decoder won't output it either
+
+		if (!firstFound)
+		{
+			first = header;
+			firstFound = true;
+		}
 
-	memcpy(buffer, Buffer, toRead);
-	memmove(Buffer, Buffer + toRead, Size - toRead);
+		SFramePositionData data;
+		data.offset = offset;
+		data.size = header.frame_size;
+		data.position = position;
+		FramePositionData.push_back(data);
 
-	Size -= toRead;
-	return toRead;
+		offset += header.coded_frame_size;
+		position += header.frame_size;
+	}
+
+	if (!firstFound)
+		return false;
+
+	// the format is known now without decoding anything, seekDecoder(0)
+	// keeps these in the decoder context when it resets it
+	Format.ChannelCount = first.channels;
+	Format.SampleRate = first.sample_rate;
+	Format.SampleFormat = ESF_S16;
+	Format.FrameCount = position;
+	FirstFrameRead = true;
+
+	TheMPAuDecContext->bit_rate = first.bit_rate;
+	TheMPAuDecContext->channels = first.channels;
+	TheMPAuDecContext->frame_size = first.frame_size;
+	TheMPAuDecContext->sample_rate = first.sample_rate;
+
+	return true;
 }
 
 
-void CIrrKlangAudioStreamMP3::QueueBuffer::clear()
+//! builds the seek index by running the decoder's frame parser over the file
+/** Slower than buildSeekIndex(), but also finds the frames of free format streams. */
+void CIrrKlangAudioStreamMP3::parseSeekIndex()
 {
-	Size = 0;
+	File->seek(FileBegin);
+	FramePositionData.clear();
+
+	TheMPAuDecContext->parse_only = 1;
+	int position = 0;
+
+	while (decodeFrame() && !EndOfFileReached)
+	{
+		SFramePositionData data;
+		data.size = TheMPAuDecContext->frame_size;
+		data.offset = File->getPos() - (InputLength - InputPosition) - TheMPAuDecContext->coded_frame_size;
+		data.position = position;
+
+		FramePositionData.push_back(data);
+		position += data.size;
+	}
+
+	TheMPAuDecContext->parse_only = 0;
+	Format.FrameCount = position;
 }
 
 
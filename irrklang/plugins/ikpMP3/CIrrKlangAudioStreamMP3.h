@@ -10,7 +10,13 @@
 #include <ik_IAudioStream.h>
 #include <ik_IFileReader.h>
 #include <vector>
+#include <atomic>
 #include "decoder/mpaudec.h"
+#include "CIrrKlangQueueBuffer.h"
+#include "CIrrKlangBlockQueue.h"
+#include "CIrrKlangMappedFile.h"
+#include "CIrrKlangDecoderPool.h"
+#include "CIrrKlangPCMConverter.h"
 
 namespace irrklang
 {
@@ -24,7 +30,16 @@ namespace irrklang
 	{
 	public:
 
-		CIrrKlangAudioStreamMP3(IFileReader* file);
+		//! \param decodeAhead: decode on the threads of the shared CIrrKlangDecoderPool
+		//! ahead of the reader, so that readFrames() only copies already decoded data out.
+		//! \param precision: arithmetic of the layer 3 decoder, one of MPAUDEC_PRECISION_*.
+		//! \param mapInput: memory map the file if it is on disk and let the decoder read
+		//! from the mapping instead of reading it through the file reader.
+		//! \param outputRate, outputChannels: format the stream converts the decoded audio
+		//! to, usually the one of the output device. 0 keeps the one of the file.
+		CIrrKlangAudioStreamMP3(IFileReader* file, bool decodeAhead = false,
+			int precision = MPAUDEC_PRECISION_FIXED23, bool mapInput = false,
+			int outputRate = 0, int outputChannels = 0);
 		~CIrrKlangAudioStreamMP3();
 
 		//! returns format of the audio stream
@@ -48,17 +63,36 @@ namespace irrklang
 
 	protected:
 
+		friend class CIrrKlangDecoderPool;
+
 		ik_s32 readFrameForMP3(void* target, ik_s32 frameCountToRead, bool parseOnly=false);
-		bool decodeFrame();
+		ik_s32 readDecodedFrames(void* target, ik_s32 frameCountToRead);
+		void createConverter(int outputRate, int outputChannels);
+		ik_s32 readFramesAhead(void* target, ik_s32 frameCountToRead);
+		ik_s32 decodeFrames(void* target, ik_s32 frameCountToRead);
+		bool seekDecoder(ik_s32 pos);
+		void resetDecoder(ik_s32 offset);
+		void prepareLoop();
+		bool decodeFrame(ik_u8* target = 0, int* targetSize = 0);
+		bool skipFrames(int frameCount);
 		void skipID3IfNecessary();
+		bool buildSeekIndex();
+		void parseSeekIndex();
+		void startDecodeAhead();
+		void stopDecodeAhead();
+		void decodeAheadFrame();
+		int getAheadBacklog();
 
 		irrklang::IFileReader* File;
-		SAudioStreamFormat Format;
+		SAudioStreamFormat Format;	// of the decoded audio, before Converter
 
 		// mpaudec specific
 		MPAuDecContext* TheMPAuDecContext;
+		int Precision;
 
 		ik_u8 InputBuffer[IKP_MP3_INPUT_BUFFER_SIZE];
+		CIrrKlangMappedFile MappedFile;
+		const ik_u8* Input;		// InputBuffer or the rest of MappedFile
 
 		int InputPosition;
 		int InputLength;
@@ -67,37 +101,39 @@ namespace irrklang
 		ik_s32 FileBegin;
 		ik_u32 CurrentFramePosition;
 
+		// loop head, the output of the first mp3 frame and the decoder state
+		// after it, so that looping doesn't need to reset and decode anything
+		MPAuDecContext* LoopContext;
+		ik_u8* LoopHead;
+		int LoopHeadSize;
+		ik_s32 LoopOffset;	// file offset of the second mp3 frame
+
 		bool FirstFrameRead;
 		bool EndOfFileReached;
 
-		// helper class for managing the streaming decoded audio data
-		class QueueBuffer
-		{
-		public:	
-
-			QueueBuffer();
-			~QueueBuffer();
-
-			int getSize();
-			void write(const void* buffer, int size);
-			int read(void* buffer, int size);
-			void clear();
-
-		private:
-
-			ik_u8* Buffer;
-			int Capacity;
-			int Size;
-		};
-
 		struct SFramePositionData
 		{
 			int offset;
 			int size;
+			int position; // first audio frame decoded from this mp3 frame
 		};
 
 		std::vector<SFramePositionData> FramePositionData;
-		QueueBuffer DecodedQueue;
+		CIrrKlangQueueBuffer DecodedQueue;
+
+		// conversion to the output format, 0 if the file already has it
+		CIrrKlangPCMConverter* Converter;
+		ik_u8* ConvertBuffer;	// decoded frames on their way into Converter
+		bool ConverterFlushed;	// the end of the stream was passed to Converter
+		bool ConverterHoldsTail;	// the decoder ran dry, the last frames wait in Converter for a loop
+		SAudioStreamFormat OutputFormat;
+
+		// decode ahead mode, the pool owns the decoder and DecodedQueue while the
+		// stream is added to it and hands finished frames over through AheadQueue
+		bool DecodeAhead;
+		CIrrKlangDecoderPool* Pool;
+		CIrrKlangBlockQueue AheadQueue;
+		std::atomic<bool> AheadEnd;	// the pool reached the end of the file or failed
 	};
 
 
@@ -0,0 +1,105 @@
+// Copyright (C) 2002-2007 Nikolaus Gebhardt
+// This file is part of the "irrKlang" library.
+// For conditions of distribution and use, see copyright notice in irrKlang.h
+
+#include "CIrrKlangBlockQueue.h"
+#include <string.h>
+
+namespace irrklang
+{
+
+CIrrKlangBlockQueue::CIrrKlangBlockQueue()
+: ReadOffset(0), Head(0), Tail(0), BytesWritten(0), BytesRead(0)
+{
+	Blocks = new SBlock[IKP_MP3_BLOCK_QUEUE_BLOCKS];
+}
+
+
+CIrrKlangBlockQueue::~CIrrKlangBlockQueue()
+{
+	delete [] Blocks;
+}
+
+
+ik_u8* CIrrKlangBlockQueue::beginWrite()
+{
+	const ik_u32 head = Head.load(std::memory_order_relaxed);
+
+	// acquire so the consumer is done copying out of the block before it is reused
+	if (head - Tail.load(std::memory_order_acquire) == (ik_u32)IKP_MP3_BLOCK_QUEUE_BLOCKS)
+		return 0;
+
+	return Blocks[head % IKP_MP3_BLOCK_QUEUE_BLOCKS].Data;
+}
+
+
+void CIrrKlangBlockQueue::endWrite(int size)
+{
+	const ik_u32 head = Head.load(std::memory_order_relaxed);
+
+	Blocks[head % IKP_MP3_BLOCK_QUEUE_BLOCKS].Size = size;
+	BytesWritten.store(BytesWritten.load(std::memory_order_relaxed) + size, std::memory_order_relaxed);
+	Head.store(head + 1, std::memory_order_release);
+}
+
+
+int CIrrKlangBlockQueue::read(void* buffer, int size)
+{
+	ik_u8* out = (ik_u8*)buffer;
+	int copied = 0;
+
+	ik_u32 tail = Tail.load(std::memory_order_relaxed);
+	const ik_u32 head = Head.load(std::memory_order_acquire);
+
+	while (copied < size && tail != head)
+	{
+		const SBlock& block = Blocks[tail % IKP_MP3_BLOCK_QUEUE_BLOCKS];
+		const int left = block.Size - ReadOffset;
+		const int count = size - copied < left ? size - copied : left;
+
+		memcpy(out + copied, block.Data + ReadOffset, count);
+		copied += count;
+		ReadOffset += count;
+
+		if (ReadOffset == block.Size)
+		{
+			ReadOffset = 0;
+			++tail;
+			Tail.store(tail, std::memory_order_release);
+		}
+	}
+
+	BytesRead.store(BytesRead.load(std::memory_order_relaxed) + copied, std::memory_order_relaxed);
+	return copied;
+}
+
+
+bool CIrrKlangBlockQueue::isEmpty() const
+{
+	return Tail.load(std::memory_order_relaxed) == Head.load(std::memory_order_acquire);
+}
+
+
+int CIrrKlangBlockQueue::getBlockCount() const
+{
+	return (int)(Head.load(std::memory_order_relaxed) - Tail.load(std::memory_order_relaxed));
+}
+
+
+int CIrrKlangBlockQueue::getSize() const
+{
+	return (int)(BytesWritten.load(std::memory_order_relaxed) - BytesRead.load(std::memory_order_relaxed));
+}
+
+
+void CIrrKlangBlockQueue::clear()
+{
+	ReadOffset = 0;
+	BytesWritten.store(0, std::memory_order_relaxed);
+	BytesRead.store(0, std::memory_order_relaxed);
+	Head.store(0, std::memory_order_relaxed);
+	Tail.store(0, std::memory_order_relaxed);
+}
+
+
+} // end namespace irrklang
@@ -0,0 +1,68 @@
+// Copyright (C) 2002-2007 Nikolaus Gebhardt
+// This file is part of the "irrKlang" library.
+// For conditions of distribution and use, see copyright notice in irrKlang.h
+
+#ifndef __C_IRRKLANG_BLOCK_QUEUE_H_INCLUDED__
+#define __C_IRRKLANG_BLOCK_QUEUE_H_INCLUDED__
+
+#include <ik_irrKlangTypes.h>
+#include <atomic>
+#include "decoder/mpaudec.h"
+
+namespace irrklang
+{
+	//! Number of decoded frames the decode ahead thread keeps ready, about 0.4s at 44.1kHz
+	const int IKP_MP3_BLOCK_QUEUE_BLOCKS = 16;
+
+	//!	Bounded lock free queue of decoded frames, one producer and one consumer thread
+	/** Every block holds the output of one mp3 frame. The producer fills the block
+	returned by beginWrite() and publishes it with endWrite(), the consumer copies
+	data out with read(), which frees every block it has emptied. Neither side ever
+	waits for the other, a full or empty queue is reported to the caller instead. */
+	class CIrrKlangBlockQueue
+	{
+	public:
+
+		CIrrKlangBlockQueue();
+		~CIrrKlangBlockQueue();
+
+		//! returns the block to decode into, or 0 if all blocks are in use. Producer only.
+		ik_u8* beginWrite();
+
+		//! publishes the block returned by beginWrite() holding size bytes. Producer only.
+		void endWrite(int size);
+
+		//! copies up to size bytes out of the queue, returns the amount copied. Consumer only.
+		int read(void* buffer, int size);
+
+		//! true if there is nothing to read. Consumer only.
+		bool isEmpty() const;
+
+		//! number of blocks written and not completely read yet. Any thread.
+		int getBlockCount() const;
+
+		//! number of bytes written and not read yet. Any thread.
+		int getSize() const;
+
+		//! drops all queued data, only allowed while no producer is running
+		void clear();
+
+	private:
+
+		struct SBlock
+		{
+			ik_u8 Data[MPAUDEC_MAX_AUDIO_FRAME_SIZE];
+			int Size;
+		};
+
+		SBlock* Blocks;
+		int ReadOffset;             // consumer position inside the block at Tail
+		std::atomic<ik_u32> Head;   // free running, next block to be written
+		std::atomic<ik_u32> Tail;   // free running, next block to be read
+		std::atomic<ik_u32> BytesWritten;	// free running, producer only
+		std::atomic<ik_u32> BytesRead;		// free running, consumer only
+	};
+
+} // end namespace irrklang
+
+#endif
@@ -0,0 +1,187 @@
+// Copyright (C) 2002-2007 Nikolaus Gebhardt
+// This file is part of the "irrKlang" library.
+// For conditions of distribution and use, see copyright notice in irrKlang.h
+
+#include "CIrrKlangDecoderPool.h"
+#include "CIrrKlangAudioStreamMP3.h"
+
+namespace irrklang
+{
+
+// the shared pool and the number of streams holding it
+static std::mutex PoolMutex;
+static CIrrKlangDecoderPool* Pool = 0;
+static int PoolUsers = 0;
+
+
+CIrrKlangDecoderPool* CIrrKlangDecoderPool::acquire()
+{
+	std::lock_guard<std::mutex> lock(PoolMutex);
+
+	if (!Pool)
+		Pool = new CIrrKlangDecoderPool();
+
+	++PoolUsers;
+	return Pool;
+}
+
+
+void CIrrKlangDecoderPool::release()
+{
+	std::lock_guard<std::mutex> lock(PoolMutex);
+
+	if (--PoolUsers == 0)
+	{
+		delete Pool;
+		Pool = 0;
+	}
+}
+
+
+CIrrKlangDecoderPool::CIrrKlangDecoderPool()
+: Stop(false), WakeCount(0), Sleepers(0)
+{
+	// leave one core to the game and the engine's mixing thread
+	int threadCount = (int)std::thread::hardware_concurrency() - 1;
+	if (threadCount < 1)
+		threadCount = 1;
+	if (threadCount > IKP_MP3_MAX_DECODER_THREADS)
+		threadCount = IKP_MP3_MAX_DECODER_THREADS;
+
+	for (int i=0; i<threadCount; ++i)
+		Workers.push_back(std::thread(&CIrrKlangDecoderPool::workerThread, this));
+}
+
+
+CIrrKlangDecoderPool::~CIrrKlangDecoderPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		Stop = true;
+		WakeCount.fetch_add(1);
+	}
+
+	Wake.notify_all();
+
+	for (int i=0; i<(int)Workers.size(); ++i)
+		Workers[i].join();
+}
+
+
+void CIrrKlangDecoderPool::add(CIrrKlangAudioStreamMP3* stream)
+{
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+
+		SEntry entry;
+		entry.Stream = stream;
+		entry.Busy = false;
+		Streams.push_back(entry);
+		WakeCount.fetch_add(1);
+	}
+
+	Wake.notify_one();
+}
+
+
+void CIrrKlangDecoderPool::remove(CIrrKlangAudioStreamMP3* stream)
+{
+	std::unique_lock<std::mutex> lock(Mutex);
+
+	for (;;)
+	{
+		int i = 0;
+		while (i < (int)Streams.size() && Streams[i].Stream != stream)
+			++i;
+
+		if (i == (int)Streams.size())
+			return;
+
+		if (!Streams[i].Busy)
+		{
+			Streams.erase(Streams.begin() + i);
+			return;
+		}
+
+		Idle.wait(lock);
+	}
+}
+
+
+void CIrrKlangDecoderPool::wake()
+{
+	WakeCount.fetch_add(1);
+
+	// A worker counts itself as a sleeper under the lock before it checks
+	// WakeCount. If it is one already, taking the lock makes sure it is
+	// really waiting before it is notified, otherwise it sees the new count.
+	if (Sleepers.load() > 0)
+	{
+		{
+			std::lock_guard<std::mutex> lock(Mutex);
+		}
+		Wake.notify_one();
+	}
+}
+
+
+//! returns the index of the idle stream with the shortest audio queued, or -1
+int CIrrKlangDecoderPool::findMostUrgent() const
+{
+	int best = -1;
+	int bestBacklog = 0;
+
+	for (int i=0; i<(int)Streams.size(); ++i)
+	{
+		if (Streams[i].Busy)
+			continue;
+
+		const int backlog = Streams[i].Stream->getAheadBacklog();
+
+		if (backlog >= 0 && (best == -1 || backlog < bestBacklog))
+		{
+			best = i;
+			bestBacklog = backlog;
+		}
+	}
+
+	return best;
+}
+
+
+void CIrrKlangDecoderPool::workerThread()
+{
+	std::unique_lock<std::mutex> lock(Mutex);
+
+	while (!Stop)
+	{
+		// anything which makes work after this shows up as a new count
+		const unsigned seen = WakeCount.load();
+		const int i = findMostUrgent();
+
+		if (i == -1)
+		{
+			Sleepers.fetch_add(1);
+			Wake.wait(lock, [&]{ return Stop || WakeCount.load() != seen; });
+			Sleepers.fetch_sub(1);
+			continue;
+		}
+
+		CIrrKlangAudioStreamMP3* stream = Streams[i].Stream;
+		Streams[i].Busy = true;
+
+		lock.unlock();
+		stream->decodeAheadFrame();
+		lock.lock();
+
+		// remove() may have erased other entries meanwhile, but not this one
+		for (int j=0; j<(int)Streams.size(); ++j)
+			if (Streams[j].Stream == stream)
+				Streams[j].Busy = false;
+
+		Idle.notify_all();
+	}
+}
+
+
+} // end namespace irrklang
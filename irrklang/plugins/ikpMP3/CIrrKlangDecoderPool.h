@@ -0,0 +1,77 @@
+// Copyright (C) 2002-2007 Nikolaus Gebhardt
+// This file is part of the "irrKlang" library.
+// For conditions of distribution and use, see copyright notice in irrKlang.h
+
+#ifndef __C_IRRKLANG_DECODER_POOL_H_INCLUDED__
+#define __C_IRRKLANG_DECODER_POOL_H_INCLUDED__
+
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace irrklang
+{
+	class CIrrKlangAudioStreamMP3;
+
+	//! Upper limit for the worker threads of the decoder pool
+	const int IKP_MP3_MAX_DECODER_THREADS = 8;
+
+	//!	Worker threads decoding ahead for all mp3 streams in decode ahead mode
+	/** The pool is shared by all streams and exists while at least one stream holds
+	it. Each worker repeatedly picks the stream with the least decoded audio queued,
+	measured in playing time, and decodes one mp3 frame for it, so the stream closest
+	to running dry is always served first. A stream is only ever decoded by one worker
+	at a time, which keeps its AheadQueue a single producer queue even though the
+	producing thread changes. Workers without anything to do block until wake() or
+	add() hands them work. */
+	class CIrrKlangDecoderPool
+	{
+	public:
+
+		//! returns the shared pool, starting its threads if no stream held it before
+		static CIrrKlangDecoderPool* acquire();
+
+		//! releases the pool returned by acquire(), the last release stops it
+		static void release();
+
+		//! lets the workers decode for the stream until remove() is called
+		void add(CIrrKlangAudioStreamMP3* stream);
+
+		//! stops decoding for the stream, waits if a worker is decoding for it right now
+		void remove(CIrrKlangAudioStreamMP3* stream);
+
+		//! tells the workers that a stream has room for more frames again. Only
+		//! locks if a worker is asleep.
+		void wake();
+
+	private:
+
+		CIrrKlangDecoderPool();
+		~CIrrKlangDecoderPool();
+
+		void workerThread();
+		int findMostUrgent() const;
+
+		struct SEntry
+		{
+			CIrrKlangAudioStreamMP3* Stream;
+			bool Busy;	// a worker is decoding for the stream
+		};
+
+		std::vector<SEntry> Streams;
+		std::vector<std::thread> Workers;
+		bool Stop;
+
+		std::mutex Mutex;			// guards Streams and Stop
+		std::condition_variable Wake;	// workers sleep on it while there is nothing to do
+		std::condition_variable Idle;	// remove() waits on it for a busy stream
+
+		std::atomic<unsigned> WakeCount;	// bumped whenever there may be new work
+		std::atomic<int> Sleepers;		// workers waiting on Wake
+	};
+
+} // end namespace irrklang
+
+#endif
@@ -0,0 +1,128 @@
+// Copyright (C) 2002-2007 Nikolaus Gebhardt
+// This file is part of the "irrKlang" library.
+// For conditions of distribution and use, see copyright notice in irrKlang.h
+
+#include "CIrrKlangMappedFile.h"
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace irrklang
+{
+
+CIrrKlangMappedFile::CIrrKlangMappedFile()
+: Data(0), Size(0)
+#ifdef WIN32
+	, Mapping(0)
+#endif
+{
+}
+
+
+CIrrKlangMappedFile::~CIrrKlangMappedFile()
+{
+	close();
+}
+
+
+#ifdef WIN32
+
+bool CIrrKlangMappedFile::open(const ik_c8* fileName)
+{
+	close();
+
+	HANDLE file = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, 0,
+		OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart <= 0 || size.QuadPart > 0x7fffffff)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	// the mapping keeps the file open, the handle itself is not needed anymore
+	HANDLE mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+	CloseHandle(file);
+	if (!mapping)
+		return false;
+
+	Data = (const ik_u8*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!Data)
+	{
+		CloseHandle(mapping);
+		return false;
+	}
+
+	Mapping = mapping;
+	Size = (ik_s32)size.QuadPart;
+	return true;
+}
+
+
+void CIrrKlangMappedFile::close()
+{
+	if (Data)
+		UnmapViewOfFile(Data);
+	if (Mapping)
+		CloseHandle(Mapping);
+
+	Data = 0;
+	Size = 0;
+	Mapping = 0;
+}
+
+#else
+
+bool CIrrKlangMappedFile::open(const ik_c8* fileName)
+{
+	close();
+
+	int fd = ::open(fileName, O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) ||
+		st.st_size <= 0 || st.st_size > 0x7fffffff)
+	{
+		::close(fd);
+		return false;
+	}
+
+	// the mapping keeps the file open, the descriptor itself is not needed anymore
+	void* data = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (data == MAP_FAILED)
+		return false;
+
+	// the decoder walks the file front to back, let the kernel read ahead
+	madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+	Data = (const ik_u8*)data;
+	Size = (ik_s32)st.st_size;
+	return true;
+}
+
+
+void CIrrKlangMappedFile::close()
+{
+	if (Data)
+		munmap((void*)Data, Size);
+
+	Data = 0;
+	Size = 0;
+}
+
+#endif
+
+
+} // end namespace irrklang
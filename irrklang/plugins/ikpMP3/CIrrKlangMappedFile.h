@@ -0,0 +1,46 @@
+// Copyright (C) 2002-2007 Nikolaus Gebhardt
+// This file is part of the "irrKlang" library.
+// For conditions of distribution and use, see copyright notice in irrKlang.h
+
+#ifndef __C_IRRKLANG_MAPPED_FILE_H_INCLUDED__
+#define __C_IRRKLANG_MAPPED_FILE_H_INCLUDED__
+
+#include <ik_irrKlangTypes.h>
+
+namespace irrklang
+{
+	//!	Read only memory mapping of a whole file on disk
+	/** Lets the mp3 stream hand file data to the decoder without reading it
+	into a buffer first. The pages are loaded by the OS on first access. */
+	class CIrrKlangMappedFile
+	{
+	public:
+
+		CIrrKlangMappedFile();
+		~CIrrKlangMappedFile();
+
+		//! maps the file, returns false if it can't be opened or is empty
+		bool open(const ik_c8* fileName);
+
+		//! unmaps the file again, open() may be called afterwards
+		void close();
+
+		bool isOpen() const { return Data != 0; }
+		const ik_u8* getData() const { return Data; }
+		ik_s32 getSize() const { return Size; }
+
+	private:
+
+		CIrrKlangMappedFile(const CIrrKlangMappedFile&);
+		CIrrKlangMappedFile& operator=(const CIrrKlangMappedFile&);
+
+		const ik_u8* Data;
+		ik_s32 Size;
+#ifdef WIN32
+		void* Mapping;
+#endif
+	};
+
+} // end namespace irrklang
+
+#endif
@@ -0,0 +1,270 @@
+// Copyright (C) 2002-2007 Nikolaus Gebhardt
+// This file is part of the "irrKlang" library.
+// For conditions of distribution and use, see copyright notice in irrKlang.h
+
+#include "CIrrKlangPCMConverter.h"
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define IKP_MP3_SSE
+#endif
+
+namespace irrklang
+{
+
+static int gcd(int a, int b)
+{
+	while (b)
+	{
+		const int t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+
+//! modified Bessel function of the first kind, for the Kaiser window
+static double besselI0(double x)
+{
+	double sum = 1.0;
+	double term = 1.0;
+
+	for (int k=1; k<32; ++k)
+	{
+		term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum += term;
+	}
+
+	return sum;
+}
+
+
+static inline float dot(const float* a, const float* b, int n)
+{
+#ifdef IKP_MP3_SSE
+	if ((n & 3) == 0)
+	{
+		__m128 sum = _mm_setzero_ps();
+		for (int i=0; i<n; i+=4)
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+
+		sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+		sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+		return _mm_cvtss_f32(sum);
+	}
+#endif
+
+	float sum = 0.0f;
+	for (int i=0; i<n; ++i)
+		sum += a[i] * b[i];
+	return sum;
+}
+
+
+static inline ik_s16 toS16(float v)
+{
+	if (v >= 32767.0f)
+		return 32767;
+	if (v <= -32768.0f)
+		return -32768;
+	return (ik_s16)(v >= 0.0f ? (int)(v + 0.5f) : (int)(v - 0.5f));
+}
+
+
+CIrrKlangPCMConverter::CIrrKlangPCMConverter(int srcRate, int srcChannels, int dstRate,
+											 int dstChannels, int maxWriteFrames)
+: SrcChannels(srcChannels), DstChannels(dstChannels)
+{
+	const int divisor = gcd(srcRate, dstRate);
+	Phases = dstRate / divisor;
+	Step = srcRate / divisor;
+	Taps = IKP_MP3_RESAMPLER_TAPS;
+
+	// when downsampling the filter cuts lower and has to be longer for the
+	// same sharpness, it always spans IKP_MP3_RESAMPLER_TAPS output frames
+	if (Step > Phases)
+		Taps = (int)(((long long)IKP_MP3_RESAMPLER_TAPS * Step / Phases + 3) & ~3);
+
+	if (srcRate == dstRate)
+		Taps = 1;
+	FilterRows = Phases < IKP_MP3_RESAMPLER_MAX_PHASES ? Phases : IKP_MP3_RESAMPLER_MAX_PHASES;
+
+	Filter = new float[FilterRows * Taps];
+	buildFilter();
+
+	// what read() leaves over is less than Taps frames, flush() adds less than Taps
+	Capacity = 2 * Taps + maxWriteFrames;
+	Input[0] = new float[Capacity];
+	Input[1] = DstChannels == 2 ? new float[Capacity] : 0;
+
+	reset();
+}
+
+
+CIrrKlangPCMConverter::~CIrrKlangPCMConverter()
+{
+	delete [] Filter;
+	delete [] Input[0];
+	delete [] Input[1];
+}
+
+
+void CIrrKlangPCMConverter::buildFilter()
+{
+	if (Taps == 1)
+	{
+		Filter[0] = 1.0f;
+		return;
+	}
+
+	// cutoff in cycles per input frame, a bit below the lower Nyquist frequency
+	const double ratio = (double)Phases / Step;
+	const double cutoff = 0.5 * (ratio < 1.0 ? ratio : 1.0) * 0.9;
+	const double beta = 8.0;
+	const double center = (Taps - 1) / 2;
+	const double halfWidth = Taps / 2.0;
+	const double pi = 3.14159265358979323846;
+
+	for (int row=0; row<FilterRows; ++row)
+	{
+		// the output frame lies this far behind the input frame at center
+		const double frac = (double)row / FilterRows;
+		float* coefficients = Filter + row * Taps;
+		double sum = 0.0;
+
+		for (int i=0; i<Taps; ++i)
+		{
+			const double x = i - center - frac;
+			const double u = x / halfWidth;
+			const double window = u < 1.0 && u > -1.0 ? besselI0(beta * sqrt(1.0 - u * u)) / besselI0(beta) : 0.0;
+			const double arg = 2.0 * cutoff * x;
+			const double sinc = arg == 0.0 ? 1.0 : sin(pi * arg) / (pi * arg);
+
+			coefficients[i] = (float)(sinc * window);
+			sum += coefficients[i];
+		}
+
+		// unity gain for every phase
+		for (int i=0; i<Taps; ++i)
+			coefficients[i] = (float)(coefficients[i] / sum);
+	}
+}
+
+
+void CIrrKlangPCMConverter::reset()
+{
+	Phase = 0;
+	ReadPos = 0;
+
+	// silence before the first frame, so that its output is not delayed
+	InputCount = (Taps - 1) / 2;
+
+	for (int ch=0; ch<DstChannels; ++ch)
+		memset(Input[ch], 0, InputCount * sizeof(float));
+}
+
+
+//! moves what is still under the filter to the front
+void CIrrKlangPCMConverter::compact()
+{
+	if (ReadPos)
+	{
+		InputCount -= ReadPos;
+		for (int ch=0; ch<DstChannels; ++ch)
+			memmove(Input[ch], Input[ch] + ReadPos, InputCount * sizeof(float));
+		ReadPos = 0;
+	}
+}
+
+
+void CIrrKlangPCMConverter::write(const ik_s16* frames, int frameCount)
+{
+	compact();
+
+	float* left = Input[0] + InputCount;
+	float* right = Input[1] + InputCount;
+
+	if (SrcChannels == DstChannels && DstChannels == 1)
+	{
+		for (int i=0; i<frameCount; ++i)
+			left[i] = frames[i];
+	}
+	else if (SrcChannels == DstChannels)
+	{
+		for (int i=0; i<frameCount; ++i)
+		{
+			left[i] = frames[2*i];
+			right[i] = frames[2*i + 1];
+		}
+	}
+	else if (DstChannels == 2)
+	{
+		for (int i=0; i<frameCount; ++i)
+			left[i] = right[i] = frames[i];
+	}
+	else
+	{
+		for (int i=0; i<frameCount; ++i)
+			left[i] = (frames[2*i] + frames[2*i + 1]) * 0.5f;
+	}
+
+	InputCount += frameCount;
+}
+
+
+void CIrrKlangPCMConverter::flush()
+{
+	// enough for the last frame written to reach the center of the filter
+	const int count = Taps - 1 - (Taps - 1) / 2;
+
+	compact();
+
+	for (int ch=0; ch<DstChannels; ++ch)
+		memset(Input[ch] + InputCount, 0, count * sizeof(float));
+
+	InputCount += count;
+}
+
+
+int CIrrKlangPCMConverter::read(ik_s16* target, int frameCount)
+{
+	int n = 0;
+
+	while (n < frameCount && ReadPos + Taps <= InputCount)
+	{
+		const int row = FilterRows == Phases ? Phase : (int)((long long)Phase * FilterRows / Phases);
+		const float* coefficients = Filter + row * Taps;
+
+		for (int ch=0; ch<DstChannels; ++ch)
+			target[n * DstChannels + ch] = toS16(dot(Input[ch] + ReadPos, coefficients, Taps));
+
+		++n;
+
+		Phase += Step;
+		while (Phase >= Phases)
+		{
+			Phase -= Phases;
+			++ReadPos;
+		}
+	}
+
+	return n;
+}
+
+
+ik_s32 CIrrKlangPCMConverter::toOutputFrames(ik_s32 srcFrames) const
+{
+	return (ik_s32)(((long long)srcFrames * Phases + Step - 1) / Step);
+}
+
+
+ik_s32 CIrrKlangPCMConverter::toSourceFrames(ik_s32 dstFrames) const
+{
+	return (ik_s32)((long long)dstFrames * Step / Phases);
+}
+
+
+} // end namespace irrklang
@@ -0,0 +1,81 @@
+// Copyright (C) 2002-2007 Nikolaus Gebhardt
+// This file is part of the "irrKlang" library.
+// For conditions of distribution and use, see copyright notice in irrKlang.h
+
+#ifndef __C_IRRKLANG_PCM_CONVERTER_H_INCLUDED__
+#define __C_IRRKLANG_PCM_CONVERTER_H_INCLUDED__
+
+#include <ik_irrKlangTypes.h>
+
+namespace irrklang
+{
+	//! Filter taps per output sample of the resampler, more when downsampling
+	const int IKP_MP3_RESAMPLER_TAPS = 32;
+
+	//! Upper limit for the filter phases, rate ratios needing more share the nearest phase
+	const int IKP_MP3_RESAMPLER_MAX_PHASES = 1024;
+
+	//!	Converts 16 bit interleaved PCM to another sample rate and channel count
+	/** Resampling uses a polyphase Kaiser windowed sinc filter with one phase per
+	output position between two input frames, low passed below the lower of both
+	Nyquist frequencies. Mono is converted to stereo by copying the channel, stereo
+	to mono by averaging both. Internally the samples are floats, the filter runs
+	with SSE where available.
+
+	Data is pushed in with write() and pulled out with read(), which returns less
+	than asked for if more input is needed. The output is aligned with the input,
+	the filter delay is compensated. */
+	class CIrrKlangPCMConverter
+	{
+	public:
+
+		//! \param maxWriteFrames: the most frames ever passed to a single write()
+		CIrrKlangPCMConverter(int srcRate, int srcChannels, int dstRate, int dstChannels,
+			int maxWriteFrames);
+		~CIrrKlangPCMConverter();
+
+		//! appends frameCount source frames. Only allowed when read() returned less than asked for.
+		void write(const ik_s16* frames, int frameCount);
+
+		//! appends silence to get out the last frames written, call once at the end of the input
+		void flush();
+
+		//! converts up to frameCount frames into target, returns the amount converted
+		int read(ik_s16* target, int frameCount);
+
+		//! drops all buffered data and starts over, as if the object was new
+		void reset();
+
+		//! converts a position in source frames to output frames and back
+		ik_s32 toOutputFrames(ik_s32 srcFrames) const;
+		ik_s32 toSourceFrames(ik_s32 dstFrames) const;
+
+	private:
+
+		CIrrKlangPCMConverter(const CIrrKlangPCMConverter&);
+		CIrrKlangPCMConverter& operator=(const CIrrKlangPCMConverter&);
+
+		void buildFilter();
+		void compact();
+
+		int SrcChannels;
+		int DstChannels;
+
+		// one output frame is produced every Step/Phases input frames
+		int Phases;
+		int Step;
+		int Phase;
+		int Taps;		// 1 if the rate is not converted
+		int FilterRows;	// Phases, or less if that would be too many
+		float* Filter;	// FilterRows rows of Taps coefficients
+
+		// input already in the output channel layout, one array per channel
+		float* Input[2];
+		int Capacity;
+		int InputCount;
+		int ReadPos;	// first input frame under the filter for the next output frame
+	};
+
+} // end namespace irrklang
+
+#endif
@@ -0,0 +1,86 @@
+// Copyright (C) 2002-2007 Nikolaus Gebhardt
+// This file is part of the "irrKlang" library.
+// For conditions of distribution and use, see copyright notice in irrKlang.h
+
+#include "CIrrKlangQueueBuffer.h"
+#include <stdlib.h> // free and malloc
+#include <string.h>
+
+namespace irrklang
+{
+
+CIrrKlangQueueBuffer::CIrrKlangQueueBuffer(int capacity)
+: ReadPos(0), WritePos(0)
+{
+	Capacity = 1;
+	while (Capacity < capacity)
+		Capacity *= 2;
+
+	Buffer = (ik_u8*)malloc(Capacity);
+}
+
+
+CIrrKlangQueueBuffer::~CIrrKlangQueueBuffer()
+{
+	free(Buffer);
+}
+
+
+void CIrrKlangQueueBuffer::write(const void* buffer, int size)
+{
+	if (getSize() + size > Capacity)
+		grow(getSize() + size);
+
+	const int start = WritePos & (Capacity - 1);
+	const int first = size < Capacity - start ? size : Capacity - start;
+
+	memcpy(Buffer + start, buffer, first);
+	memcpy(Buffer, (const ik_u8*)buffer + first, size - first);
+
+	WritePos += size;
+}
+
+
+int CIrrKlangQueueBuffer::read(void* buffer, int size)
+{
+	const int toRead = size < getSize() ? size : getSize();
+
+	const int start = ReadPos & (Capacity - 1);
+	const int first = toRead < Capacity - start ? toRead : Capacity - start;
+
+	memcpy(buffer, Buffer + start, first);
+	memcpy((ik_u8*)buffer + first, Buffer, toRead - first);
+
+	ReadPos += toRead;
+	return toRead;
+}
+
+
+int CIrrKlangQueueBuffer::skip(int size)
+{
+	const int toSkip = size < getSize() ? size : getSize();
+	ReadPos += toSkip;
+	return toSkip;
+}
+
+
+void CIrrKlangQueueBuffer::grow(int size)
+{
+	int capacity = Capacity;
+	while (capacity < size)
+		capacity *= 2;
+
+	// unwrap the queued data to the start of the new buffer
+	const int queued = getSize();
+	ik_u8* buffer = (ik_u8*)malloc(capacity);
+	read(buffer, queued);
+
+	free(Buffer);
+	Buffer = buffer;
+	Capacity = capacity;
+	ReadPos = 0;
+	WritePos = queued;
+}
+
+
+} // end namespace irrklang
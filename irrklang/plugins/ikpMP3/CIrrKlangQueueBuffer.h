@@ -0,0 +1,57 @@
+// Copyright (C) 2002-2007 Nikolaus Gebhardt
+// This file is part of the "irrKlang" library.
+// For conditions of distribution and use, see copyright notice in irrKlang.h
+
+#ifndef __C_IRRKLANG_QUEUE_BUFFER_H_INCLUDED__
+#define __C_IRRKLANG_QUEUE_BUFFER_H_INCLUDED__
+
+#include <ik_irrKlangTypes.h>
+#include "decoder/mpaudec.h"
+
+namespace irrklang
+{
+	//! returns the smallest power of two which is at least n
+	constexpr int nextPowerOfTwo(int n, int p = 1)
+	{
+		return p >= n ? p : nextPowerOfTwo(n, p * 2);
+	}
+
+	//! Smallest capacity which still holds two fully decoded frames
+	const int IKP_MP3_QUEUE_BUFFER_SIZE = nextPowerOfTwo(2 * MPAUDEC_MAX_AUDIO_FRAME_SIZE);
+
+	static_assert((IKP_MP3_QUEUE_BUFFER_SIZE & (IKP_MP3_QUEUE_BUFFER_SIZE - 1)) == 0,
+		"the queue buffer capacity has to be a power of two");
+
+	//!	FIFO for streaming decoded audio data
+	/** Implemented as a circular buffer with a power of two capacity, so reads and
+	writes only copy the bytes passed in or out and never move the queued data.
+	The capacity is doubled if a write does not fit, which does not happen in
+	steady state since the stream only decodes when less than a frame is queued. */
+	class CIrrKlangQueueBuffer
+	{
+	public:
+
+		CIrrKlangQueueBuffer(int capacity = IKP_MP3_QUEUE_BUFFER_SIZE);
+		~CIrrKlangQueueBuffer();
+
+		int getSize() const { return (int)(WritePos - ReadPos); }
+		int getCapacity() const { return Capacity; }
+
+		void write(const void* buffer, int size);
+		int read(void* buffer, int size);
+		int skip(int size);
+		void clear() { ReadPos = WritePos = 0; }
+
+	private:
+
+		void grow(int size);
+
+		ik_u8* Buffer;
+		int Capacity;	// always a power of two
+		ik_u32 ReadPos;	// free running, masked with Capacity-1 on access
+		ik_u32 WritePos;
+	};
+
+} // end namespace irrklang
+
+#endif
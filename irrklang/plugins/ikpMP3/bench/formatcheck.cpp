@@ -0,0 +1,151 @@
+// Checks that a channel mode change in the middle of a stream is handled.
+//
+// The decoder accepts every valid frame, so a mono file may run into stereo
+// frames which decode to twice as many bytes. The stream has to end at the
+// first of them without writing it into buffers sized for the mono format.
+// The synthetic stream is FrameCount silent mono layer 3 frames followed by
+// FrameCount stereo ones. It is read through CIrrKlangAudioStreamMP3 without
+// conversion, with conversion to 48 kHz and in decode ahead mode, into buffers
+// exactly as big as asked for, in chunks taking both the direct decoding and
+// the queued path. Build with -fsanitize=address to catch the overflow.
+//
+// Build and run from the plugin directory:
+//   gcc -O1 -g -fsanitize=address -c decoder/mpaudec.c decoder/bits.c
+//   g++ -O1 -g -fsanitize=address -pthread -I../../include -I. bench/formatcheck.cpp CIrrKlang*.cpp mpaudec.o bits.o -o formatcheck
+//   ./formatcheck
+
+#include "CIrrKlangAudioStreamMP3.h"
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+using namespace irrklang;
+
+// mp3 frames of each channel mode
+static const int FrameCount = 20;
+
+// MPEG1 layer 3, 128 kbps at 44.1 kHz without padding
+static const int CodedFrameSize = 417;
+
+// irrKlang file reader reading from memory
+class MemoryFileReader : public IFileReader
+{
+public:
+
+	MemoryFileReader(const std::vector<ik_u8>& data)
+	: Data(data), Pos(0)
+	{
+	}
+
+	virtual ik_s32 read(void* buffer, ik_u32 sizeToRead)
+	{
+		const ik_u32 left = (ik_u32)Data.size() - Pos;
+		if (sizeToRead > left)
+			sizeToRead = left;
+		memcpy(buffer, &Data[0] + Pos, sizeToRead);
+		Pos += sizeToRead;
+		return sizeToRead;
+	}
+
+	virtual bool seek(ik_s32 finalPos, bool relativeMovement)
+	{
+		const long pos = relativeMovement ? (long)Pos + finalPos : finalPos;
+		if (pos < 0 || pos > (long)Data.size())
+			return false;
+		Pos = pos;
+		return true;
+	}
+
+	virtual ik_s32 getSize() { return (ik_s32)Data.size(); }
+	virtual ik_s32 getPos() { return Pos; }
+	virtual const ik_c8* getFileName() { return "formatcheck.mp3"; }
+
+private:
+
+	const std::vector<ik_u8>& Data;
+	ik_u32 Pos;
+};
+
+//! appends a frame of silence, all side info is zero so no bits are coded
+static void appendFrame(std::vector<ik_u8>& data, bool stereo)
+{
+	const size_t begin = data.size();
+	data.resize(begin + CodedFrameSize, 0);
+	data[begin] = 0xff;
+	data[begin + 1] = 0xfb;					// MPEG1, layer 3, no CRC
+	data[begin + 2] = 0x90;					// 128 kbps, 44.1 kHz
+	data[begin + 3] = stereo ? 0x00 : 0xc0;	// stereo or single channel
+}
+
+//! reads the stream in chunks of chunkFrames until it ends, returns the frames read
+static long readAll(CIrrKlangAudioStreamMP3& stream, int chunkFrames)
+{
+	const int frameSize = stream.getFormat().getFrameSize();
+	long total = 0;
+
+	for (;;)
+	{
+		// a new buffer of the exact size every time, so ASan sees any overflow
+		std::vector<ik_u8> buffer(chunkFrames * frameSize);
+		const int read = stream.readFrames(&buffer[0], chunkFrames);
+		total += read;
+		if (read == 0)
+			return total;
+	}
+}
+
+int main()
+{
+	std::vector<ik_u8> data;
+	for (int i=0; i<FrameCount; ++i)
+		appendFrame(data, false);
+	for (int i=0; i<FrameCount; ++i)
+		appendFrame(data, true);
+
+	struct SMode
+	{
+		const char* Name;
+		bool DecodeAhead;
+		int OutputRate;
+	};
+
+	static const SMode modes[] =
+	{
+		{ "direct", false, 0 },
+		{ "converted", false, 48000 },
+		{ "ahead", true, 0 },
+	};
+
+	// a whole decoded frame, a mono frame short of a stereo one, odd sizes
+	static const int chunks[] = { 4096, 2304, 1152, 1000, 100 };
+
+	bool ok = true;
+
+	for (size_t m=0; m<sizeof(modes)/sizeof(modes[0]); ++m)
+	{
+		for (size_t c=0; c<sizeof(chunks)/sizeof(chunks[0]); ++c)
+		{
+			MemoryFileReader* reader = new MemoryFileReader(data);
+			CIrrKlangAudioStreamMP3* stream = new CIrrKlangAudioStreamMP3(reader,
+				modes[m].DecodeAhead, MPAUDEC_PRECISION_FIXED23, false, modes[m].OutputRate);
+			reader->drop();
+
+			const SAudioStreamFormat format = stream->getFormat();
+			const long read = readAll(*stream, chunks[c]);
+			stream->drop();
+
+			// the mono part, give or take what the converter holds back
+			const long expected = (long)FrameCount * MPAUDEC_MAX_FRAME_SAMPLES *
+				format.SampleRate / 44100;
+			const bool passed = format.ChannelCount == 1 &&
+				read > expected - MPAUDEC_MAX_FRAME_SAMPLES && read <= expected + 64;
+
+			printf("%-9s chunk %4d: %ld frames, expected about %ld  %s\n", modes[m].Name,
+				chunks[c], read, expected, passed ? "ok" : "FAILED");
+			ok = ok && passed;
+		}
+	}
+
+	printf(ok ? "all format changes handled\n" : "format change not handled\n");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,425 @@
+// Throughput benchmark for the mp3 decoder.
+//
+// Every file is loaded into memory and decoded in three ways: by calling
+// mpaudec_decode_frame() directly, through CIrrKlangAudioStreamMP3 read in
+// chunks the way the sound engine reads it, and through the stream in decode
+// ahead mode. No sound engine or audio device is involved. Each measurement is
+// the best of several runs and reports mp3 frames per second, the real-time
+// factor and, if the decoder was compiled with MPAUDEC_PROFILE, the time spent
+// in each decoding stage.
+//
+// Results can be written as JSON and compared against the JSON of an earlier
+// build, the exit code is 1 if anything got slower than the tolerance allows.
+//
+// Build and run from the plugin directory:
+//   gcc -O2 -DMPAUDEC_PROFILE -c decoder/mpaudec.c decoder/bits.c
+//   g++ -O2 -pthread -I../../include -I. bench/mp3bench.cpp CIrrKlang*.cpp mpaudec.o bits.o -o mp3bench
+//   ./mp3bench [-runs n] [-simd level] [-precision p] [-json out.json]
+//              [-baseline old.json] [-tolerance percent] file.mp3 ...
+//
+// -precision selects the decoder arithmetic, one of the MPAUDEC_PRECISION_*
+// values: 0 is the bit exact default, 1 the 15 bit and 2 the float decoder.
+//
+// The stage timers cost a little time themselves, leave MPAUDEC_PROFILE out
+// when only the totals are of interest.
+
+#include "CIrrKlangAudioStreamMP3.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+using namespace irrklang;
+
+static const char* const StageNames[MPAUDEC_STAGE_COUNT] =
+{
+	"header", "huffman", "dequant", "stereo", "imdct", "synth"
+};
+
+// frames the engine asks for at a time, roughly one mixing period
+static const int ReadChunkFrames = 512;
+
+//! MPAUDEC_PRECISION_* every decoder is run with
+static int Precision = MPAUDEC_PRECISION_FIXED23;
+
+// irrKlang file reader reading from memory
+class MemoryFileReader : public IFileReader
+{
+public:
+
+	MemoryFileReader(const std::vector<ik_u8>& data, const char* filename)
+	: Data(data), Pos(0), FileName(filename)
+	{
+	}
+
+	virtual ik_s32 read(void* buffer, ik_u32 sizeToRead)
+	{
+		const ik_u32 left = (ik_u32)Data.size() - Pos;
+		if (sizeToRead > left)
+			sizeToRead = left;
+		memcpy(buffer, &Data[0] + Pos, sizeToRead);
+		Pos += sizeToRead;
+		return sizeToRead;
+	}
+
+	virtual bool seek(ik_s32 finalPos, bool relativeMovement)
+	{
+		const long pos = relativeMovement ? (long)Pos + finalPos : finalPos;
+		if (pos < 0 || pos > (long)Data.size())
+			return false;
+		Pos = pos;
+		return true;
+	}
+
+	virtual ik_s32 getSize() { return (ik_s32)Data.size(); }
+	virtual ik_s32 getPos() { return Pos; }
+	virtual const ik_c8* getFileName() { return FileName; }
+
+private:
+
+	const std::vector<ik_u8>& Data;
+	ik_u32 Pos;
+	const char* FileName;
+};
+
+struct SResult
+{
+	std::string Name;        // "<file>/<mode>"
+	long long Mp3Frames;
+	long long SampleFrames;
+	int SampleRate;
+	double Seconds;
+	bool Profiled;
+	MPAuDecProfile Profile;
+
+	double getMp3FramesPerSecond() const { return Mp3Frames / Seconds; }
+	double getRealtimeFactor() const { return (double)SampleFrames / SampleRate / Seconds; }
+};
+
+static double now()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool loadFile(const char* filename, std::vector<ik_u8>& data)
+{
+	FILE* file = fopen(filename, "rb");
+	if (!file)
+		return false;
+
+	fseek(file, 0, SEEK_END);
+	data.resize(ftell(file));
+	fseek(file, 0, SEEK_SET);
+	const bool ok = data.empty() || fread(&data[0], 1, data.size(), file) == data.size();
+	fclose(file);
+	return ok;
+}
+
+//! decodes the whole file with the bare decoder, feeding it like the stream does
+static bool decodeDirect(const std::vector<ik_u8>& data, SResult& result)
+{
+	MPAuDecContext context;
+	memset(&context, 0, sizeof(context));
+	if (mpaudec_init(&context) < 0)
+		return false;
+	context.precision = Precision;
+
+	static ik_u8 output[MPAUDEC_MAX_AUDIO_FRAME_SIZE];
+	result.Mp3Frames = 0;
+	result.SampleFrames = 0;
+
+	int pos = 0;
+	const int size = (int)data.size();
+
+	while (pos < size)
+	{
+		const int length = size - pos < IKP_MP3_INPUT_BUFFER_SIZE ? size - pos : IKP_MP3_INPUT_BUFFER_SIZE;
+		int offset = 0;
+
+		while (offset < length)
+		{
+			int outputSize = 0;
+			const int rv = mpaudec_decode_frame(&context, output, &outputSize, &data[pos + offset], length - offset);
+			if (rv < 0)
+			{
+				mpaudec_clear(&context);
+				return false;
+			}
+			offset += rv;
+
+			if (outputSize > 0)
+			{
+				result.Mp3Frames++;
+				result.SampleFrames += outputSize / (2 * context.channels);
+			}
+		}
+
+		pos += length;
+	}
+
+	result.SampleRate = context.sample_rate;
+	mpaudec_clear(&context);
+	return result.SampleFrames > 0;
+}
+
+//! decodes the whole file through the plugin's audio stream
+static bool decodeStream(const std::vector<ik_u8>& data, const char* filename, bool decodeAhead, SResult& result)
+{
+	MemoryFileReader* reader = new MemoryFileReader(data, filename);
+	CIrrKlangAudioStreamMP3* stream = new CIrrKlangAudioStreamMP3(reader, decodeAhead, Precision);
+	reader->drop();
+
+	if (!stream->isOK())
+	{
+		stream->drop();
+		return false;
+	}
+
+	const SAudioStreamFormat format = stream->getFormat();
+	std::vector<ik_u8> buffer(ReadChunkFrames * format.getFrameSize());
+
+	result.SampleFrames = 0;
+	result.SampleRate = format.SampleRate;
+
+	for (;;)
+	{
+		const int read = stream->readFrames(&buffer[0], ReadChunkFrames);
+		result.SampleFrames += read;
+		if (read < ReadChunkFrames)
+			break;
+	}
+
+	stream->drop();
+	return result.SampleFrames > 0;
+}
+
+//! runs one mode several times and keeps the fastest run
+static bool measure(const std::vector<ik_u8>& data, const char* filename, int mode, int runs, SResult& best)
+{
+	for (int i = 0; i < runs; ++i)
+	{
+		SResult result = best;
+
+		mpaudec_reset_profile();
+		const double start = now();
+
+		bool ok;
+		if (mode == 0)
+			ok = decodeDirect(data, result);
+		else
+			ok = decodeStream(data, filename, mode == 2, result);
+
+		result.Seconds = now() - start;
+		result.Profiled = mpaudec_get_profile(&result.Profile) != 0;
+
+		if (!ok)
+			return false;
+
+		if (i == 0 || result.Seconds < best.Seconds)
+			best = result;
+	}
+
+	return true;
+}
+
+static void printResult(const SResult& r)
+{
+	printf("%-40s %8.0f mp3 frames/s  %7.1fx realtime", r.Name.c_str(),
+		r.getMp3FramesPerSecond(), r.getRealtimeFactor());
+
+	if (r.Profiled)
+	{
+		unsigned long long total = 0;
+		for (int i = 0; i < MPAUDEC_STAGE_COUNT; ++i)
+			total += r.Profile.ns[i];
+
+		printf("  |");
+		for (int i = 0; i < MPAUDEC_STAGE_COUNT; ++i)
+			printf(" %s %.1f%%", StageNames[i], total ? 100.0 * r.Profile.ns[i] / total : 0.0);
+	}
+
+	printf("\n");
+}
+
+static bool writeJson(const char* filename, const std::vector<SResult>& results, int simd)
+{
+	FILE* out = fopen(filename, "w");
+	if (!out)
+		return false;
+
+	fprintf(out, "{\n  \"benchmark\": \"mp3bench\",\n  \"simd\": %d,\n  \"precision\": %d,\n  \"results\": [\n",
+		simd, Precision);
+
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const SResult& r = results[i];
+
+		fprintf(out, "    {\"name\": \"%s\", \"mp3_frames\": %lld, \"sample_frames\": %lld, "
+			"\"seconds\": %.6f, \"mp3_frames_per_sec\": %.1f, \"realtime_factor\": %.2f",
+			r.Name.c_str(), r.Mp3Frames, r.SampleFrames, r.Seconds,
+			r.getMp3FramesPerSecond(), r.getRealtimeFactor());
+
+		if (r.Profiled)
+		{
+			fprintf(out, ", \"stage_seconds\": {");
+			for (int s = 0; s < MPAUDEC_STAGE_COUNT; ++s)
+				fprintf(out, "%s\"%s\": %.6f", s ? ", " : "", StageNames[s], r.Profile.ns[s] * 1e-9);
+			fprintf(out, "}");
+		}
+
+		fprintf(out, "}%s\n", i + 1 < results.size() ? "," : "");
+	}
+
+	fprintf(out, "  ]\n}\n");
+	fclose(out);
+	return true;
+}
+
+//! looks up mp3_frames_per_sec of the named result in a file written by writeJson()
+static bool findBaseline(const std::string& json, const std::string& name, double* framesPerSec)
+{
+	const std::string key = "\"name\": \"" + name + "\"";
+	const size_t entry = json.find(key);
+	if (entry == std::string::npos)
+		return false;
+
+	const size_t end = json.find('}', entry);
+	const size_t value = json.find("\"mp3_frames_per_sec\": ", entry);
+	if (value == std::string::npos || value > end)
+		return false;
+
+	*framesPerSec = atof(json.c_str() + value + strlen("\"mp3_frames_per_sec\": "));
+	return true;
+}
+
+//! returns false if any result is slower than the baseline by more than tolerance percent
+static bool compareBaseline(const char* filename, const std::vector<SResult>& results, double tolerance)
+{
+	std::vector<ik_u8> data;
+	if (!loadFile(filename, data))
+	{
+		printf("Error: could not read baseline `%s'\n", filename);
+		return false;
+	}
+	const std::string json(data.begin(), data.end());
+
+	bool ok = true;
+	printf("\ncompared to %s:\n", filename);
+
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		double baseline;
+		if (!findBaseline(json, results[i].Name, &baseline) || baseline <= 0)
+		{
+			printf("%-40s not in baseline\n", results[i].Name.c_str());
+			continue;
+		}
+
+		const double change = 100.0 * (results[i].getMp3FramesPerSecond() / baseline - 1.0);
+		const bool regressed = change < -tolerance;
+
+		printf("%-40s %+6.1f%%%s\n", results[i].Name.c_str(), change, regressed ? "  REGRESSION" : "");
+		if (regressed)
+			ok = false;
+	}
+
+	return ok;
+}
+
+int main(int argc, char* argv[])
+{
+	int runs = 5;
+	int simd = MPAUDEC_SIMD_AVX2;
+	double tolerance = 5.0;
+	const char* jsonFile = 0;
+	const char* baselineFile = 0;
+	std::vector<const char*> files;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const bool hasValue = i + 1 < argc;
+
+		if (!strcmp(argv[i], "-runs") && hasValue)
+			runs = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-simd") && hasValue)
+			simd = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-precision") && hasValue)
+			Precision = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-json") && hasValue)
+			jsonFile = argv[++i];
+		else if (!strcmp(argv[i], "-baseline") && hasValue)
+			baselineFile = argv[++i];
+		else if (!strcmp(argv[i], "-tolerance") && hasValue)
+			tolerance = atof(argv[++i]);
+		else if (argv[i][0] == '-')
+		{
+			printf("Usage: %s [-runs n] [-simd level] [-precision p] [-json out.json] "
+				"[-baseline old.json] [-tolerance percent] file.mp3 ...\n", argv[0]);
+			return 2;
+		}
+		else
+			files.push_back(argv[i]);
+	}
+
+	if (files.empty() || runs < 1)
+	{
+		printf("Usage: %s [-runs n] [-simd level] [-precision p] [-json out.json] "
+			"[-baseline old.json] [-tolerance percent] file.mp3 ...\n", argv[0]);
+		return 2;
+	}
+
+	simd = mpaudec_set_simd(simd);
+
+	static const char* const ModeNames[3] = { "decoder", "stream", "stream-ahead" };
+	std::vector<SResult> results;
+
+	for (size_t f = 0; f < files.size(); ++f)
+	{
+		std::vector<ik_u8> data;
+		if (!loadFile(files[f], data))
+		{
+			printf("Error: could not read `%s'\n", files[f]);
+			return 2;
+		}
+
+		const char* base = strrchr(files[f], '/');
+		base = base ? base + 1 : files[f];
+
+		long long mp3Frames = 0;
+
+		for (int mode = 0; mode < 3; ++mode)
+		{
+			SResult result;
+			memset(&result.Profile, 0, sizeof(result.Profile));
+			result.Name = std::string(base) + "/" + ModeNames[mode];
+
+			if (!measure(data, files[f], mode, runs, result))
+			{
+				printf("Error: could not decode `%s' (%s)\n", files[f], ModeNames[mode]);
+				return 2;
+			}
+
+			// the stream does not tell how many mp3 frames it decoded
+			if (mode == 0)
+				mp3Frames = result.Mp3Frames;
+			else
+				result.Mp3Frames = mp3Frames;
+
+			printResult(result);
+			results.push_back(result);
+		}
+	}
+
+	if (jsonFile && !writeJson(jsonFile, results, simd))
+	{
+		printf("Error: could not write `%s'\n", jsonFile);
+		return 2;
+	}
+
+	if (baselineFile && !compareBaseline(baselineFile, results, tolerance))
+		return 1;
+
+	return 0;
+}
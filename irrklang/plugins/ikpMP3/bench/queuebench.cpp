@@ -0,0 +1,129 @@
+// Microbenchmark for the decoded audio queue of the mp3 stream.
+//
+// Replays the access pattern of CIrrKlangAudioStreamMP3::readFrames: whenever
+// less than one sample frame is queued a whole decoded mp3 frame is written,
+// and the engine pulls fixed sized chunks out. Compares the circular
+// CIrrKlangQueueBuffer against the previous linear queue which moved the
+// remaining data to the front on every read.
+//
+// Build and run from the plugin directory:
+//   g++ -O2 -I../../include -I. bench/queuebench.cpp CIrrKlangQueueBuffer.cpp -o queuebench
+//   ./queuebench [readChunkBytes]
+
+#include "CIrrKlangQueueBuffer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+using namespace irrklang;
+
+// the queue as it was implemented before, kept as reference
+class LinearQueueBuffer
+{
+public:
+
+	LinearQueueBuffer() : Capacity(256), Size(0) { Buffer = (ik_u8*)malloc(Capacity); }
+	~LinearQueueBuffer() { free(Buffer); }
+
+	int getSize() const { return Size; }
+
+	void write(const void* buffer, int size)
+	{
+		bool needRealloc = false;
+		while (size + Size > Capacity)
+		{
+			Capacity *= 2;
+			needRealloc = true;
+		}
+		if (needRealloc)
+			Buffer = (ik_u8*)realloc(Buffer, Capacity);
+
+		memcpy(Buffer + Size, buffer, size);
+		Size += size;
+	}
+
+	int read(void* buffer, int size)
+	{
+		int toRead = size < Size ? size : Size;
+		memcpy(buffer, Buffer, toRead);
+		memmove(Buffer, Buffer + toRead, Size - toRead);
+		Size -= toRead;
+		return toRead;
+	}
+
+private:
+
+	ik_u8* Buffer;
+	int Capacity;
+	int Size;
+};
+
+static double now()
+{
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+template <class T>
+static double run(T& queue, int chunk, long long total, unsigned* checksum)
+{
+	const int frameSize = 4; // stereo 16 bit
+	ik_u8 decoded[MPAUDEC_MAX_AUDIO_FRAME_SIZE];
+	ik_u8* out = new ik_u8[chunk];
+	for (int i = 0; i < MPAUDEC_MAX_AUDIO_FRAME_SIZE; i++)
+		decoded[i] = (ik_u8)(i * 7);
+
+	unsigned sum = 0;
+	long long moved = 0;
+	double start = now();
+
+	while (moved < total)
+	{
+		int got = 0;
+		while (got < chunk)
+		{
+			if (queue.getSize() < frameSize)
+				queue.write(decoded, MPAUDEC_MAX_AUDIO_FRAME_SIZE);
+			got += queue.read(out + got, chunk - got);
+		}
+		sum += out[0] + out[chunk - 1];
+		moved += chunk;
+	}
+
+	double seconds = now() - start;
+	delete [] out;
+	*checksum = sum;
+	return moved / seconds;
+}
+
+int main(int argc, char** argv)
+{
+	const int chunk = argc > 1 ? atoi(argv[1]) : 2048;
+	const long long total = 1LL << 30;
+
+	if (chunk <= 0)
+	{
+		printf("usage: queuebench [readChunkBytes]\n");
+		return 1;
+	}
+
+	unsigned linearSum, ringSum;
+	LinearQueueBuffer linear;
+	CIrrKlangQueueBuffer ring;
+
+	double linearRate = run(linear, chunk, total, &linearSum);
+	double ringRate = run(ring, chunk, total, &ringSum);
+
+	printf("chunk %d bytes\n", chunk);
+	printf("linear: %8.1f MB/s\n", linearRate / (1024 * 1024));
+	printf("ring:   %8.1f MB/s (%.2fx)\n", ringRate / (1024 * 1024), ringRate / linearRate);
+
+	if (linearSum != ringSum)
+	{
+		printf("error: queues returned different data\n");
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,185 @@
+/* Checks that the SIMD code paths of the mp3 decoder are bit exact.
+ *
+ * Every input is decoded with the scalar reference code and again with
+ * every SIMD level the CPU supports, and the PCM output is compared. The
+ * inputs are the mp3 files given on the command line plus synthetic
+ * streams: valid frame headers of all layers, versions and channel modes
+ * followed by random payload. Decoding random side info and Huffman data
+ * reaches block types, switch points and stereo modes a single music file
+ * may never use.
+ *
+ * Build and run from the plugin directory:
+ *   gcc -O2 bench/simdcheck.c decoder/mpaudec.c decoder/bits.c -lm -o simdcheck
+ *   ./simdcheck ../../media/ophelia.mp3
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../decoder/mpaudec.h"
+
+typedef struct Buffer {
+    unsigned char *data;
+    int size;
+    int capacity;
+} Buffer;
+
+static void append(Buffer *b, const void *data, int size)
+{
+    if (b->size + size > b->capacity) {
+        while (b->size + size > b->capacity)
+            b->capacity = b->capacity ? b->capacity * 2 : 65536;
+        b->data = realloc(b->data, b->capacity);
+    }
+    memcpy(b->data + b->size, data, size);
+    b->size += size;
+}
+
+/* decodes the stream the same way CIrrKlangAudioStreamMP3 feeds it */
+static void decode(const Buffer *in, Buffer *out)
+{
+    MPAuDecContext ctx;
+    static short pcm[MPAUDEC_MAX_AUDIO_FRAME_SIZE / 2];
+    int pos = 0, chunk, rv, size;
+
+    memset(&ctx, 0, sizeof(ctx));
+    out->size = 0;
+    if (mpaudec_init(&ctx) < 0)
+        return;
+
+    while (pos < in->size) {
+        chunk = in->size - pos < 4096 ? in->size - pos : 4096;
+        while (chunk > 0) {
+            size = 0;
+            rv = mpaudec_decode_frame(&ctx, pcm, &size, in->data + pos, chunk);
+            if (rv < 0) {
+                rv = 1; /* skip a byte, keeps both runs in step */
+                size = 0;
+            }
+            if (size > 0)
+                append(out, pcm, size);
+            else if (size < 0)
+                append(out, &size, sizeof(size)); /* record the error */
+            pos += rv;
+            chunk -= rv;
+        }
+    }
+    mpaudec_clear(&ctx);
+}
+
+/* largest frame the header table allows: MPEG2.5 layer II at 160 kbps and
+   8 kHz, 160 * 144000 / 8000 bytes plus a padding byte */
+#define MAX_CODED_FRAME_SIZE 2881
+
+static unsigned int seed;
+
+static unsigned int random32(void)
+{
+    /* xorshift, so streams are the same on every platform */
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+/* a stream of frames with valid headers and random payload */
+static void synthesize(Buffer *b, unsigned int streamSeed)
+{
+    /* version bits: 3 = MPEG1, 2 = MPEG2, 0 = MPEG2.5 */
+    static const int versions[3] = { 3, 2, 0 };
+    unsigned char header[4], payload[MAX_CODED_FRAME_SIZE];
+    int frame, i, version, layer, bitrate, rate, mode, modeExt;
+    MPAuDecHeader h;
+
+    seed = streamSeed * 2654435761u + 1;
+    b->size = 0;
+
+    version = versions[random32() % 3];
+    layer = 1 + random32() % 3;   /* layer bits: 1 = layer 3 .. 3 = layer 1 */
+    rate = random32() % 3;
+
+    for(frame=0;frame<200;frame++) {
+        bitrate = 1 + random32() % 14;
+        mode = random32() % 4;
+        modeExt = random32() % 4;
+
+        header[0] = 0xff;
+        header[1] = 0xe0 | (version << 3) | (layer << 1) | 1;
+        header[2] = (bitrate << 4) | (rate << 2) | ((random32() & 1) << 1);
+        header[3] = (mode << 6) | (modeExt << 4);
+        if (mpaudec_parse_header(&h, header) != 0)
+            continue;
+        if (h.coded_frame_size - 4 > (int)sizeof(payload))
+            continue;
+
+        for(i=0;i<h.coded_frame_size - 4;i++)
+            payload[i] = random32();
+        /* mostly small main_data_begin, so the bit reservoir gets used
+           without running off the start of the stream */
+        if (frame < 4 || random32() % 2)
+            payload[0] = 0;
+
+        append(b, header, 4);
+        append(b, payload, h.coded_frame_size - 4);
+    }
+}
+
+static int check(const char *name, const Buffer *in, int maxLevel)
+{
+    static const char *levels[] = { "scalar", "sse4.1", "avx2" };
+    Buffer ref = { 0, 0, 0 }, out = { 0, 0, 0 };
+    int level, failed = 0;
+
+    mpaudec_set_simd(MPAUDEC_SIMD_NONE);
+    decode(in, &ref);
+
+    for(level=MPAUDEC_SIMD_NONE+1;level<=maxLevel;level++) {
+        mpaudec_set_simd(level);
+        decode(in, &out);
+        if (out.size != ref.size || memcmp(out.data, ref.data, ref.size) != 0) {
+            printf("%s: %s output differs from scalar\n", name, levels[level]);
+            failed = 1;
+        }
+    }
+
+    free(ref.data);
+    free(out.data);
+    return failed;
+}
+
+int main(int argc, char **argv)
+{
+    Buffer in = { 0, 0, 0 };
+    char name[64], data[65536];
+    int i, n, failed = 0, maxLevel;
+    FILE *f;
+
+    maxLevel = mpaudec_set_simd(MPAUDEC_SIMD_AVX2);
+    if (maxLevel == MPAUDEC_SIMD_NONE) {
+        printf("no SIMD code paths on this CPU, nothing to check\n");
+        return 0;
+    }
+
+    for(i=1;i<argc;i++) {
+        f = fopen(argv[i], "rb");
+        if (!f) {
+            printf("could not open %s\n", argv[i]);
+            return 1;
+        }
+        in.size = 0;
+        while ((n = fread(data, 1, sizeof(data), f)) > 0)
+            append(&in, data, n);
+        fclose(f);
+        failed |= check(argv[i], &in, maxLevel);
+    }
+
+    for(i=0;i<200;i++) {
+        synthesize(&in, i);
+        sprintf(name, "synthetic stream %d", i);
+        failed |= check(name, &in, maxLevel);
+    }
+
+    printf(failed ? "FAILED\n" : "all outputs bit exact\n");
+    free(in.data);
+    return failed;
+}
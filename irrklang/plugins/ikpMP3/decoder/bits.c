@@ -24,7 +24,7 @@
 
 /**
  * init GetBitContext.
- * @param buffer bitstream buffer
+ * @param buffer bitstream buffer, followed by GET_BITS_PADDING readable bytes
  * @param bit_size the size of the buffer in bits
  */
 void init_get_bits(GetBitContext *s,
@@ -33,43 +33,7 @@ void init_get_bits(GetBitContext *s,
     s->buffer= buffer;
     s->size_in_bits= bit_size;
     s->index=0;
-}
-
-unsigned int show_bits(const GetBitContext *s, int n)
-{
-    int i;
-    unsigned int result = 0;
-    assert(s->size_in_bits - s->index >= n);
-    for (i = s->index; i < s->index + n; i++) {
-        int byte_index = i / 8;
-        unsigned int right_shift = 7 - (i % 8);
-        uint8_t byte = s->buffer[byte_index];
-        uint8_t bit;
-        result <<= 1;
-        if (right_shift == 0)
-            bit = byte & 0x1;
-        else
-            bit = (byte >> right_shift) & 0x1;
-        result |= (unsigned int)bit;
-    }
-    return result;
-}
-
-void skip_bits(GetBitContext *s, int n)
-{
-    s->index += n;
-}
-
-unsigned int get_bits(GetBitContext *s, int n)
-{
-    unsigned int result = show_bits(s, n);
-    skip_bits(s, n);
-    return result;
-}
-
-int get_bits_count(const GetBitContext *s)
-{
-    return s->index;
+    refill_bits(s);
 }
 
 /* VLC decoding */
@@ -249,25 +213,3 @@ void free_vlc(VLC *vlc)
 {
     free(vlc->table);
 }
-
-int get_vlc(GetBitContext *s, const VLC *vlc)
-{
-    int code = 0;
-    int depth = 0, max_depth = 3;
-    int n, index, bits = vlc->bits;
-    
-    do {
-        index = show_bits(s, bits) + code;
-        code = vlc->table[index][0];
-        n = vlc->table[index][1];
-        depth++;
-
-        if (n < 0 && depth < max_depth) {
-            skip_bits(s, bits);
-            bits = -n;
-        }
-    } while (n < 0 && depth < max_depth);
-
-    skip_bits(s, n);
-    return code;
-}
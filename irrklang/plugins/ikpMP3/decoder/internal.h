@@ -53,15 +53,93 @@ typedef signed __int64 int64_t;
 #endif
 #include <assert.h>
 
+#if defined(_MSC_VER)
+#    define MPA_INLINE static __inline
+#elif defined(__GNUC__)
+#    define MPA_INLINE static __inline__
+#else
+#    define MPA_INLINE static
+#endif
+
 /* bit input */
 
+/* Number of readable bytes a buffer given to init_get_bits() must have
+   after its end. The reader loads 8 bytes at a time and may read ahead
+   of the bits it returns, bits read past the end have no meaning. */
+#define GET_BITS_PADDING 8
+
 typedef struct GetBitContext {
     const uint8_t *buffer;
     int index;
     int size_in_bits;
+    uint64_t cache;     /* the bits from index on, msb first */
+    int cache_bits;     /* valid bits in cache, at least 32 */
 } GetBitContext;
 
-int get_bits_count(const GetBitContext *s);
+void init_get_bits(GetBitContext *s,
+                   const uint8_t *buffer, int buffer_size);
+
+MPA_INLINE uint64_t read_be64(const uint8_t *ptr)
+{
+#if defined(__GNUC__) && defined(__BYTE_ORDER__)
+    uint64_t v;
+    memcpy(&v, ptr, 8);
+#    if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    v = __builtin_bswap64(v);
+#    endif
+    return v;
+#elif defined(_MSC_VER)
+    uint64_t v;
+    memcpy(&v, ptr, 8);
+    return _byteswap_uint64(v);
+#else
+    return ((uint64_t)ptr[0] << 56) | ((uint64_t)ptr[1] << 48) |
+           ((uint64_t)ptr[2] << 40) | ((uint64_t)ptr[3] << 32) |
+           ((uint64_t)ptr[4] << 24) | ((uint64_t)ptr[5] << 16) |
+           ((uint64_t)ptr[6] << 8) | (uint64_t)ptr[7];
+#endif
+}
+
+/* reloads the cache at index with one unaligned load. Past the padding
+   only zeros are returned. */
+MPA_INLINE void refill_bits(GetBitContext *s)
+{
+    int pos = s->index >> 3;
+    if (pos <= (s->size_in_bits + 7) >> 3)
+        s->cache = read_be64(s->buffer + pos) << (s->index & 7);
+    else
+        s->cache = 0;
+    s->cache_bits = 64 - (s->index & 7);
+}
+
+/* the next n bits, 0 <= n <= 32 */
+MPA_INLINE unsigned int show_bits(const GetBitContext *s, int n)
+{
+    assert(n >= 0 && n <= 32);
+    return (unsigned int)((s->cache >> 1) >> (63 - n));
+}
+
+MPA_INLINE void skip_bits(GetBitContext *s, int n)
+{
+    s->index += n;
+    s->cache_bits -= n;
+    if (s->cache_bits < 32)
+        refill_bits(s);
+    else
+        s->cache <<= n;
+}
+
+MPA_INLINE unsigned int get_bits(GetBitContext *s, int n)
+{
+    unsigned int result = show_bits(s, n);
+    skip_bits(s, n);
+    return result;
+}
+
+MPA_INLINE int get_bits_count(const GetBitContext *s)
+{
+    return s->index;
+}
 
 #define VLC_TYPE int16_t
 
@@ -71,16 +149,31 @@ typedef struct VLC {
     int table_size, table_allocated;
 } VLC;
 
-unsigned int get_bits(GetBitContext *s, int n);
-unsigned int show_bits(const GetBitContext *s, int n);
-void skip_bits(GetBitContext *s, int n);
-void init_get_bits(GetBitContext *s,
-                   const uint8_t *buffer, int buffer_size);
-
 int init_vlc(VLC *vlc, int nb_bits, int nb_codes,
              const void *bits, int bits_wrap, int bits_size,
              const void *codes, int codes_wrap, int codes_size);
 void free_vlc(VLC *vlc);
-int get_vlc(GetBitContext *s, const VLC *vlc);
+
+MPA_INLINE int get_vlc(GetBitContext *s, const VLC *vlc)
+{
+    int code = 0;
+    int depth = 0, max_depth = 3;
+    int n, index, bits = vlc->bits;
+    
+    do {
+        index = show_bits(s, bits) + code;
+        code = vlc->table[index][0];
+        n = vlc->table[index][1];
+        depth++;
+
+        if (n < 0 && depth < max_depth) {
+            skip_bits(s, bits);
+            bits = -n;
+        }
+    } while (n < 0 && depth < max_depth);
+
+    skip_bits(s, n);
+    return code;
+}
 
 #endif /* INTERNAL_H */
@@ -28,26 +28,59 @@
 #pragma warning(disable : 4244)
 #endif
 
+#ifdef MPAUDEC_PROFILE
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+/* time spent in each stage, summed over all decoder instances */
+static MPAuDecProfile profile;
+
+static unsigned long long profile_clock(void)
+{
+#ifdef _WIN32
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER now;
+    if (!freq.QuadPart)
+        QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    return (unsigned long long)(now.QuadPart * (1e9 / freq.QuadPart));
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#endif
+}
+
+#define PROFILE_START(t) unsigned long long t = profile_clock()
+#define PROFILE_STOP(stage, t) (profile.ns[stage] += profile_clock() - (t))
+#else
+#define PROFILE_START(t)
+#define PROFILE_STOP(stage, t)
+#endif
+
 /*
  * TODO:
  *  - in low precision mode, use more 16 bit multiplies in synth filter
  *  - test lsf / mpeg25 extensively.
  */
-
-/* define USE_HIGHPRECISION to have a bit exact (but slower) mpeg
-   audio decoder */
-#define USE_HIGHPRECISION
-
-#ifdef USE_HIGHPRECISION
+/* Layer 3 and the synthesis filter are compiled several times with
+   different arithmetic, see mpaudec_template.h. Layers 1 and 2 always
+   use the bit exact 23 bit fixed point code below. */
 #define FRAC_BITS   23   /* fractional bits for sb_samples and dct */
-#define WFRAC_BITS  16   /* fractional bits for window */
-#else
-#define FRAC_BITS   15   /* fractional bits for sb_samples and dct */
-#define WFRAC_BITS  14   /* fractional bits for window */
-#endif
 
 #define FRAC_ONE    (1 << FRAC_BITS)
 
+/* x86 SIMD versions of the 23 bit kernels. They are compiled with per
+   function target attributes and selected at runtime by
+   mpaudec_set_simd(), so no special compiler flags are needed. */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
 #define MULL(a,b) (((int64_t)(a) * (int64_t)(b)) >> FRAC_BITS)
 #define MUL64(a,b) ((int64_t)(a) * (int64_t)(b))
 #define FIX(a)   ((int)((a) * FRAC_ONE))
@@ -55,19 +88,15 @@
 #define FIXR(a)   ((int)((a) * FRAC_ONE + 0.5))
 #define FRAC_RND(a) (((a) + (FRAC_ONE/2)) >> FRAC_BITS)
 
-#if FRAC_BITS <= 15
-typedef int16_t MPA_INT;
-#else
-typedef int32_t MPA_INT;
-#endif
-
 /****************/
 
 #define HEADER_SIZE 4
 #define BACKSTEP_SIZE 512
 
+struct MPAKernels;
+
 typedef struct MPADecodeContext {
-    uint8_t inbuf1[2][MPA_MAX_CODED_FRAME_SIZE + BACKSTEP_SIZE];        /* input buffer */
+    uint8_t inbuf1[2][MPA_MAX_CODED_FRAME_SIZE + BACKSTEP_SIZE + GET_BITS_PADDING]; /* input buffer */
     int inbuf_index;
     uint8_t *inbuf_ptr, *inbuf;
     int frame_size;
@@ -85,10 +114,26 @@ typedef struct MPADecodeContext {
     int mode;
     int mode_ext;
     int lsf;
-    MPA_INT synth_buf[MPA_MAX_CHANNELS][512 * 2];
+    /* kernels the state below belongs to, one member of each union is
+       in use at a time */
+    const struct MPAKernels *kernels;
+    union {
+        int16_t fixed15[MPA_MAX_CHANNELS][512 * 2];
+        int32_t fixed23[MPA_MAX_CHANNELS][512 * 2];
+        float float32[MPA_MAX_CHANNELS][512 * 2];
+    } synth_buf;
     int synth_buf_offset[MPA_MAX_CHANNELS];
-    int32_t sb_samples[MPA_MAX_CHANNELS][36][SBLIMIT];
-    int32_t mdct_buf[MPA_MAX_CHANNELS][SBLIMIT * 18]; /* previous samples, for layer 3 MDCT */
+    union {
+        int32_t fixed15[MPA_MAX_CHANNELS][36][SBLIMIT];
+        int32_t fixed23[MPA_MAX_CHANNELS][36][SBLIMIT];
+        float float32[MPA_MAX_CHANNELS][36][SBLIMIT];
+    } sb_samples;
+    union { /* previous samples, for layer 3 MDCT,
+               sample i of band j at i * SBLIMIT + j */
+        int32_t fixed15[MPA_MAX_CHANNELS][SBLIMIT * 18];
+        int32_t fixed23[MPA_MAX_CHANNELS][SBLIMIT * 18];
+        float float32[MPA_MAX_CHANNELS][SBLIMIT * 18];
+    } mdct_buf;
 #ifdef DEBUG
     int frame_count;
 #endif
@@ -111,9 +156,26 @@ typedef struct GranuleDef {
     int preflag;
     int short_start, long_end; /* long/short band indexes */
     uint8_t scale_factors[40];
-    int32_t sb_hybrid[SBLIMIT * 18]; /* 576 samples */
+    union { /* 576 samples */
+        int32_t fixed15[SBLIMIT * 18];
+        int32_t fixed23[SBLIMIT * 18];
+        float float32[SBLIMIT * 18];
+    } sb_hybrid;
 } GranuleDef;
 
+/* layer 3 and synthesis code of one arithmetic, one instance of
+   mpaudec_template.h */
+typedef struct MPAKernels {
+    void (*init_tables)(void);
+    int (*huffman_decode)(MPADecodeContext *s, GranuleDef *g,
+                          int16_t *exponents, int end_pos);
+    void (*compute_stereo)(MPADecodeContext *s, GranuleDef *g0, GranuleDef *g1);
+    void (*reorder_block)(MPADecodeContext *s, GranuleDef *g);
+    void (*compute_antialias)(MPADecodeContext *s, GranuleDef *g);
+    void (*compute_imdct)(MPADecodeContext *s, GranuleDef *g, int ch, int gr);
+    void (*synthesize)(MPADecodeContext *s, int16_t *samples, int nb_frames);
+} MPAKernels;
+
 #define MODE_EXT_MS_STEREO 2
 #define MODE_EXT_I_STEREO  1
 
@@ -132,19 +194,20 @@ static uint8_t *huff_code_table[16];
 static VLC huff_quad_vlc[2];
 /* computed from band_size_long */
 static uint16_t band_index_long[9][23];
-/* XXX: free when all decoders are closed */
-#define TABLE_4_3_SIZE (8191 + 16)
-static int8_t  table_4_3_exp[TABLE_4_3_SIZE];
-#if FRAC_BITS <= 15
-static uint16_t table_4_3_value[TABLE_4_3_SIZE];
-#else
-static uint32_t table_4_3_value[TABLE_4_3_SIZE];
-#endif
-/* intensity stereo coef table */
-static int32_t is_table[2][16];
-static int32_t is_table_lsf[2][2][16];
-static int32_t csa_table[8][2];
-static int32_t mdct_win[8][36];
+
+/* big values pairs decoded with a single lookup of the next HUFF_PAIR_BITS
+   bits, see init_huff_pairs(). An entry holds the pair and the number of
+   bits it uses. With HUFF_PAIR_SIGNS set both values are below 15 and
+   their sign bits are included in the length and in the entry, otherwise
+   only the code is resolved. 0 means the code is longer than the window. */
+#define HUFF_PAIR_BITS 10
+#define HUFF_PAIR_SIGNS  0x2000
+#define HUFF_PAIR_SIGN_X 0x4000
+#define HUFF_PAIR_SIGN_Y 0x8000
+#define HUFF_PAIR_X(e)   (((e) >> 4) & 15)
+#define HUFF_PAIR_Y(e)   ((e) & 15)
+#define HUFF_PAIR_LEN(e) (((e) >> 8) & 31)
+static uint16_t *huff_pair_table[16];
 
 /* lower 2 bits: modulo 3, higher bits: shift */
 static uint16_t scale_factor_modshift[64];
@@ -161,16 +224,8 @@ static int32_t scale_factor_mult2[3][3] = {
     SCALE_GEN(4.0 / 9.0), /* 9 steps */
 };
 
-/* 2^(n/4) */
-static uint32_t scale_factor_mult3[4] = {
-    FIXR(1.0),
-    FIXR(1.18920711500272106671),
-    FIXR(1.41421356237309504880),
-    FIXR(1.68179283050742908605),
-};
+static int simd_level = -1; /* not chosen yet */
 
-static MPA_INT window[512];
-    
 /* layer 1 unscaling */
 /* n = number of bits of the mantissa minus 1 */
 static int l1_unscale(int n, int mant, int scale_factor)
@@ -202,853 +257,72 @@ static int l2_unscale_group(int steps, int mant, int scale_factor)
     return val;
 }
 
-/* compute value^(4/3) * 2^(exponent/4). It normalized to FRAC_BITS */
-static int l3_unscale(int value, int exponent)
-{
-#if FRAC_BITS <= 15    
-    unsigned int m;
-#else
-    uint64_t m;
-#endif
-    int e;
-
-    e = table_4_3_exp[value];
-    e += (exponent >> 2);
-    e = FRAC_BITS - e;
-#if FRAC_BITS <= 15    
-    if (e > 31)
-        e = 31;
-#endif
-    m = table_4_3_value[value];
-#if FRAC_BITS <= 15    
-    m = (m * scale_factor_mult3[exponent & 3]);
-    m = (m + (1 << (e-1))) >> e;
-    return m;
-#else
-    m = MUL64(m, scale_factor_mult3[exponent & 3]);
-    m = (m + ((uint64_t)(1) << (e-1))) >> e;
-    return (int)m;
-#endif
-}
-
-/* all integer n^(4/3) computation code */
-#define DEV_ORDER 13
-
-#define POW_FRAC_BITS 24
-#define POW_FRAC_ONE    (1 << POW_FRAC_BITS)
-#define POW_FIX(a)   ((int)((a) * POW_FRAC_ONE))
-#define POW_MULL(a,b) (((int64_t)(a) * (int64_t)(b)) >> POW_FRAC_BITS)
-
-static int dev_4_3_coefs[DEV_ORDER];
-
-static int pow_mult3[3] = {
-    POW_FIX(1.0),
-    POW_FIX(1.25992104989487316476),
-    POW_FIX(1.58740105196819947474),
-};
-
-static void int_pow_init(void)
-{
-    int i, a;
-
-    a = POW_FIX(1.0);
-    for(i=0;i<DEV_ORDER;i++) {
-        a = POW_MULL(a, POW_FIX(4.0 / 3.0) - i * POW_FIX(1.0)) / (i + 1);
-        dev_4_3_coefs[i] = a;
-    }
-}
-
-/* return the mantissa and the binary exponent */
-static int int_pow(int i, int *exp_ptr)
-{
-    int e, er, eq, j;
-    int a, a1;
-    
-    /* renormalize */
-    a = i;
-    e = POW_FRAC_BITS;
-    while (a < (1 << (POW_FRAC_BITS - 1))) {
-        a = a << 1;
-        e--;
-    }
-    a -= (1 << POW_FRAC_BITS);
-    a1 = 0;
-    for(j = DEV_ORDER - 1; j >= 0; j--)
-        a1 = POW_MULL(a, dev_4_3_coefs[j] + a1);
-    a = (1 << POW_FRAC_BITS) + a1;
-    /* exponent compute (exact) */
-    e = e * 4;
-    er = e % 3;
-    eq = e / 3;
-    a = POW_MULL(a, pow_mult3[er]);
-    while (a >= 2 * POW_FRAC_ONE) {
-        a = a >> 1;
-        eq++;
-    }
-    /* convert to float */
-    while (a < POW_FRAC_ONE) {
-        a = a << 1;
-        eq--;
-    }
-    /* now POW_FRAC_ONE <= a < 2 * POW_FRAC_ONE */
-#if POW_FRAC_BITS > FRAC_BITS
-    a = (a + (1 << (POW_FRAC_BITS - FRAC_BITS - 1))) >> (POW_FRAC_BITS - FRAC_BITS);
-    /* correct overflow */
-    if (a >= 2 * (1 << FRAC_BITS)) {
-        a = a >> 1;
-        eq++;
-    }
-#endif
-    *exp_ptr = eq;
-    return a;
-}
-
-int mpaudec_init(MPAuDecContext * mpctx)
+static void init_huff_pairs(int table)
 {
-    MPADecodeContext *s;
-    static int init=0;
-    int i, j, k;
-    assert(mpctx != NULL);
-    memset(mpctx, 0, sizeof(MPAuDecContext));
-    mpctx->priv_data = calloc(1, sizeof(MPADecodeContext));
-    if (mpctx->priv_data == NULL)
-        return -1;
-    s = mpctx->priv_data;
-
-    if (!init && !mpctx->parse_only) {
-        /* scale factors table for layer 1/2 */
-        for(i=0;i<64;i++) {
-            int shift, mod;
-            /* 1.0 (i = 3) is normalized to 2 ^ FRAC_BITS */
-            shift = (i / 3);
-            mod = i % 3;
-            scale_factor_modshift[i] = mod | (shift << 2);
-        }
-
-        /* scale factor multiply for layer 1 */
-        for(i=0;i<15;i++) {
-            int n, norm;
-            n = i + 2;
-            norm = (((int64_t)(1) << n) * FRAC_ONE) / ((1 << n) - 1);
-            scale_factor_mult[i][0] = MULL(FIXR(1.0 * 2.0), norm);
-            scale_factor_mult[i][1] = MULL(FIXR(0.7937005259 * 2.0), norm);
-            scale_factor_mult[i][2] = MULL(FIXR(0.6299605249 * 2.0), norm);
-#ifdef DEBUG
-            printf("%d: norm=%x s=%x %x %x\n",
-                   i, norm, 
-                   scale_factor_mult[i][0],
-                   scale_factor_mult[i][1],
-                   scale_factor_mult[i][2]);
-#endif
-        }
-        
-        /* window */
-        /* max = 18760, max sum over all 16 coefs : 44736 */
-        for(i=0;i<257;i++) {
-            int v;
-            v = mpa_enwindow[i];
-#if WFRAC_BITS < 16
-            v = (v + (1 << (16 - WFRAC_BITS - 1))) >> (16 - WFRAC_BITS);
-#endif
-            window[i] = v;
-            if ((i & 63) != 0)
-                v = -v;
-            if (i != 0)
-                window[512 - i] = v;
-        }
-        
-        /* huffman decode tables */
-        huff_code_table[0] = NULL;
-        for(i=1;i<16;i++) {
-            const HuffTable *h = &mpa_huff_tables[i];
-            int xsize, x, y;
-            unsigned int n;
-            uint8_t *code_table;
-
-            xsize = h->xsize;
-            n = xsize * xsize;
-            /* XXX: fail test */
-            init_vlc(&huff_vlc[i], 8, n, 
-                     h->bits, 1, 1, h->codes, 2, 2);
-            
-            code_table = calloc(n, 1);
-            j = 0;
-            for(x=0;x<xsize;x++) {
-                for(y=0;y<xsize;y++)
-                    code_table[j++] = (x << 4) | y;
-            }
-            huff_code_table[i] = code_table;
-        }
-        for(i=0;i<2;i++) {
-            init_vlc(&huff_quad_vlc[i], i == 0 ? 7 : 4, 16, 
-                     mpa_quad_bits[i], 1, 1, mpa_quad_codes[i], 1, 1);
-        }
-
-        for(i=0;i<9;i++) {
-            k = 0;
-            for(j=0;j<22;j++) {
-                band_index_long[i][j] = k;
-                k += band_size_long[i][j];
-            }
-            band_index_long[i][22] = k;
-        }
-
-        /* compute n ^ (4/3) and store it in mantissa/exp format */
-        int_pow_init();
-        for(i=1;i<TABLE_4_3_SIZE;i++) {
-            int e, m;
-            m = int_pow(i, &e);
-            /* normalized to FRAC_BITS */
-            table_4_3_value[i] = m;
-            table_4_3_exp[i] = e;
-        }
-        
-        for(i=0;i<7;i++) {
-            float f;
-            int v;
-            if (i != 6) {
-                f = tan((double)i * M_PI / 12.0);
-                v = FIXR(f / (1.0 + f));
+    const HuffTable *h = &mpa_huff_tables[table];
+    uint16_t *pairs;
+    int i, k, n, nb_signs, x, y, first, count;
+    uint16_t e;
+
+    pairs = calloc(1 << HUFF_PAIR_BITS, sizeof(uint16_t));
+    for(i=0;i<h->xsize * h->xsize;i++) {
+        n = h->bits[i];
+        if (n == 0 || n > HUFF_PAIR_BITS)
+            continue;
+        x = i / h->xsize;
+        y = i % h->xsize;
+        nb_signs = (x != 0) + (y != 0);
+        first = h->codes[i] << (HUFF_PAIR_BITS - n);
+        count = 1 << (HUFF_PAIR_BITS - n);
+        for(k=0;k<count;k++) {
+            e = (x << 4) | y;
+            if (x < 15 && y < 15 && n + nb_signs <= HUFF_PAIR_BITS) {
+                /* the sign bits follow the code, x first */
+                int signs = k >> (HUFF_PAIR_BITS - n - nb_signs);
+                e |= HUFF_PAIR_SIGNS | ((n + nb_signs) << 8);
+                if (y && (signs & 1))
+                    e |= HUFF_PAIR_SIGN_Y;
+                if (x && (signs >> (y != 0)) & 1)
+                    e |= HUFF_PAIR_SIGN_X;
             } else {
-                v = FIXR(1.0);
-            }
-            is_table[0][i] = v;
-            is_table[1][6 - i] = v;
-        }
-        /* invalid values */
-        for(i=7;i<16;i++)
-            is_table[0][i] = is_table[1][i] = 0.0;
-
-        for(i=0;i<16;i++) {
-            double f;
-            int e, k;
-
-            for(j=0;j<2;j++) {
-                e = -(j + 1) * ((i + 1) >> 1);
-                f = pow(2.0, e / 4.0);
-                k = i & 1;
-                is_table_lsf[j][k ^ 1][i] = FIXR(f);
-                is_table_lsf[j][k][i] = FIXR(1.0);
-#ifdef DEBUG
-                printf("is_table_lsf %d %d: %x %x\n", 
-                       i, j, is_table_lsf[j][0][i], is_table_lsf[j][1][i]);
-#endif
-            }
-        }
-
-        for(i=0;i<8;i++) {
-            float ci, cs, ca;
-            ci = ci_table[i];
-            cs = 1.0 / sqrt(1.0 + ci * ci);
-            ca = cs * ci;
-            csa_table[i][0] = FIX(cs);
-            csa_table[i][1] = FIX(ca);
-        }
-
-        /* compute mdct windows */
-        for(i=0;i<36;i++) {
-            int v;
-            v = FIXR(sin(M_PI * (i + 0.5) / 36.0));
-            mdct_win[0][i] = v;
-            mdct_win[1][i] = v;
-            mdct_win[3][i] = v;
-        }
-        for(i=0;i<6;i++) {
-            mdct_win[1][18 + i] = FIXR(1.0);
-            mdct_win[1][24 + i] = FIXR(sin(M_PI * ((i + 6) + 0.5) / 12.0));
-            mdct_win[1][30 + i] = FIXR(0.0);
-
-            mdct_win[3][i] = FIXR(0.0);
-            mdct_win[3][6 + i] = FIXR(sin(M_PI * (i + 0.5) / 12.0));
-            mdct_win[3][12 + i] = FIXR(1.0);
-        }
-
-        for(i=0;i<12;i++)
-            mdct_win[2][i] = FIXR(sin(M_PI * (i + 0.5) / 12.0));
-        
-        /* NOTE: we do frequency inversion adter the MDCT by changing
-           the sign of the right window coefs */
-        for(j=0;j<4;j++) {
-            for(i=0;i<36;i+=2) {
-                mdct_win[j + 4][i] = mdct_win[j][i];
-                mdct_win[j + 4][i + 1] = -mdct_win[j][i + 1];
+                e |= n << 8;
             }
+            pairs[first + k] = e;
         }
-
-#if defined(DEBUG)
-        for(j=0;j<8;j++) {
-            printf("win%d=\n", j);
-            for(i=0;i<36;i++)
-                printf("%f, ", (double)mdct_win[j][i] / FRAC_ONE);
-            printf("\n");
-        }
-#endif
-        init = 1;
     }
-
-    s->inbuf_index = 0;
-    s->inbuf = &s->inbuf1[s->inbuf_index][BACKSTEP_SIZE];
-    s->inbuf_ptr = s->inbuf;
-#ifdef DEBUG
-    s->frame_count = 0;
-#endif
-    return 0;
+    huff_pair_table[table] = pairs;
 }
 
-/* tab[i][j] = 1.0 / (2.0 * cos(pi*(2*k+1) / 2^(6 - j))) */
-
-/* cos(i*pi/64) */
-
-#define COS0_0  FIXR(0.50060299823519630134)
-#define COS0_1  FIXR(0.50547095989754365998)
-#define COS0_2  FIXR(0.51544730992262454697)
-#define COS0_3  FIXR(0.53104259108978417447)
-#define COS0_4  FIXR(0.55310389603444452782)
-#define COS0_5  FIXR(0.58293496820613387367)
-#define COS0_6  FIXR(0.62250412303566481615)
-#define COS0_7  FIXR(0.67480834145500574602)
-#define COS0_8  FIXR(0.74453627100229844977)
-#define COS0_9  FIXR(0.83934964541552703873)
-#define COS0_10 FIXR(0.97256823786196069369)
-#define COS0_11 FIXR(1.16943993343288495515)
-#define COS0_12 FIXR(1.48416461631416627724)
-#define COS0_13 FIXR(2.05778100995341155085)
-#define COS0_14 FIXR(3.40760841846871878570)
-#define COS0_15 FIXR(10.19000812354805681150)
-
-#define COS1_0 FIXR(0.50241928618815570551)
-#define COS1_1 FIXR(0.52249861493968888062)
-#define COS1_2 FIXR(0.56694403481635770368)
-#define COS1_3 FIXR(0.64682178335999012954)
-#define COS1_4 FIXR(0.78815462345125022473)
-#define COS1_5 FIXR(1.06067768599034747134)
-#define COS1_6 FIXR(1.72244709823833392782)
-#define COS1_7 FIXR(5.10114861868916385802)
-
-#define COS2_0 FIXR(0.50979557910415916894)
-#define COS2_1 FIXR(0.60134488693504528054)
-#define COS2_2 FIXR(0.89997622313641570463)
-#define COS2_3 FIXR(2.56291544774150617881)
-
-#define COS3_0 FIXR(0.54119610014619698439)
-#define COS3_1 FIXR(1.30656296487637652785)
-
-#define COS4_0 FIXR(0.70710678118654752439)
-
-/* butterfly operator */
-#define BF(a, b, c)\
-{\
-    tmp0 = tab[a] + tab[b];\
-    tmp1 = tab[a] - tab[b];\
-    tab[a] = tmp0;\
-    tab[b] = MULL(tmp1, c);\
-}
-
-#define BF1(a, b, c, d)\
-{\
-    BF(a, b, COS4_0);\
-    BF(c, d, -COS4_0);\
-    tab[c] += tab[d];\
-}
-
-#define BF2(a, b, c, d)\
-{\
-    BF(a, b, COS4_0);\
-    BF(c, d, -COS4_0);\
-    tab[c] += tab[d];\
-    tab[a] += tab[c];\
-    tab[c] += tab[b];\
-    tab[b] += tab[d];\
-}
-
-#define ADD(a, b) tab[a] += tab[b]
-
-/* DCT32 without 1/sqrt(2) coef zero scaling. */
-static void dct32(int32_t *out, int32_t *tab)
+/* tables of layers 1 and 2 */
+static void l12_init_tables(void)
 {
-    int tmp0, tmp1;
-
-    /* pass 1 */
-    BF(0, 31, COS0_0);
-    BF(1, 30, COS0_1);
-    BF(2, 29, COS0_2);
-    BF(3, 28, COS0_3);
-    BF(4, 27, COS0_4);
-    BF(5, 26, COS0_5);
-    BF(6, 25, COS0_6);
-    BF(7, 24, COS0_7);
-    BF(8, 23, COS0_8);
-    BF(9, 22, COS0_9);
-    BF(10, 21, COS0_10);
-    BF(11, 20, COS0_11);
-    BF(12, 19, COS0_12);
-    BF(13, 18, COS0_13);
-    BF(14, 17, COS0_14);
-    BF(15, 16, COS0_15);
-
-    /* pass 2 */
-    BF(0, 15, COS1_0);
-    BF(1, 14, COS1_1);
-    BF(2, 13, COS1_2);
-    BF(3, 12, COS1_3);
-    BF(4, 11, COS1_4);
-    BF(5, 10, COS1_5);
-    BF(6,  9, COS1_6);
-    BF(7,  8, COS1_7);
-    
-    BF(16, 31, -COS1_0);
-    BF(17, 30, -COS1_1);
-    BF(18, 29, -COS1_2);
-    BF(19, 28, -COS1_3);
-    BF(20, 27, -COS1_4);
-    BF(21, 26, -COS1_5);
-    BF(22, 25, -COS1_6);
-    BF(23, 24, -COS1_7);
-    
-    /* pass 3 */
-    BF(0, 7, COS2_0);
-    BF(1, 6, COS2_1);
-    BF(2, 5, COS2_2);
-    BF(3, 4, COS2_3);
-    
-    BF(8, 15, -COS2_0);
-    BF(9, 14, -COS2_1);
-    BF(10, 13, -COS2_2);
-    BF(11, 12, -COS2_3);
-    
-    BF(16, 23, COS2_0);
-    BF(17, 22, COS2_1);
-    BF(18, 21, COS2_2);
-    BF(19, 20, COS2_3);
-    
-    BF(24, 31, -COS2_0);
-    BF(25, 30, -COS2_1);
-    BF(26, 29, -COS2_2);
-    BF(27, 28, -COS2_3);
-
-    /* pass 4 */
-    BF(0, 3, COS3_0);
-    BF(1, 2, COS3_1);
-    
-    BF(4, 7, -COS3_0);
-    BF(5, 6, -COS3_1);
-    
-    BF(8, 11, COS3_0);
-    BF(9, 10, COS3_1);
-    
-    BF(12, 15, -COS3_0);
-    BF(13, 14, -COS3_1);
-    
-    BF(16, 19, COS3_0);
-    BF(17, 18, COS3_1);
-    
-    BF(20, 23, -COS3_0);
-    BF(21, 22, -COS3_1);
-    
-    BF(24, 27, COS3_0);
-    BF(25, 26, COS3_1);
-    
-    BF(28, 31, -COS3_0);
-    BF(29, 30, -COS3_1);
-    
-    /* pass 5 */
-    BF1(0, 1, 2, 3);
-    BF2(4, 5, 6, 7);
-    BF1(8, 9, 10, 11);
-    BF2(12, 13, 14, 15);
-    BF1(16, 17, 18, 19);
-    BF2(20, 21, 22, 23);
-    BF1(24, 25, 26, 27);
-    BF2(28, 29, 30, 31);
-    
-    /* pass 6 */
-    
-    ADD( 8, 12);
-    ADD(12, 10);
-    ADD(10, 14);
-    ADD(14,  9);
-    ADD( 9, 13);
-    ADD(13, 11);
-    ADD(11, 15);
-
-    out[ 0] = tab[0];
-    out[16] = tab[1];
-    out[ 8] = tab[2];
-    out[24] = tab[3];
-    out[ 4] = tab[4];
-    out[20] = tab[5];
-    out[12] = tab[6];
-    out[28] = tab[7];
-    out[ 2] = tab[8];
-    out[18] = tab[9];
-    out[10] = tab[10];
-    out[26] = tab[11];
-    out[ 6] = tab[12];
-    out[22] = tab[13];
-    out[14] = tab[14];
-    out[30] = tab[15];
-    
-    ADD(24, 28);
-    ADD(28, 26);
-    ADD(26, 30);
-    ADD(30, 25);
-    ADD(25, 29);
-    ADD(29, 27);
-    ADD(27, 31);
-
-    out[ 1] = tab[16] + tab[24];
-    out[17] = tab[17] + tab[25];
-    out[ 9] = tab[18] + tab[26];
-    out[25] = tab[19] + tab[27];
-    out[ 5] = tab[20] + tab[28];
-    out[21] = tab[21] + tab[29];
-    out[13] = tab[22] + tab[30];
-    out[29] = tab[23] + tab[31];
-    out[ 3] = tab[24] + tab[20];
-    out[19] = tab[25] + tab[21];
-    out[11] = tab[26] + tab[22];
-    out[27] = tab[27] + tab[23];
-    out[ 7] = tab[28] + tab[18];
-    out[23] = tab[29] + tab[19];
-    out[15] = tab[30] + tab[17];
-    out[31] = tab[31];
-}
-
-#define OUT_SHIFT (WFRAC_BITS + FRAC_BITS - 15)
-
-#if FRAC_BITS <= 15
-
-static int round_sample(int sum)
-{
-    int sum1;
-    sum1 = (sum + (1 << (OUT_SHIFT - 1))) >> OUT_SHIFT;
-    if (sum1 < -32768)
-        sum1 = -32768;
-    else if (sum1 > 32767)
-        sum1 = 32767;
-    return sum1;
-}
-
-/* signed 16x16 -> 32 multiply add accumulate */
-#define MACS(rt, ra, rb) rt += (ra) * (rb)
-
-/* signed 16x16 -> 32 multiply */
-#define MULS(ra, rb) ((ra) * (rb))
-
-#else
-
-static int round_sample(int64_t sum) 
-{
-    int sum1;
-    sum1 = (int)((sum + ((int64_t)(1) << (OUT_SHIFT - 1))) >> OUT_SHIFT);
-    if (sum1 < -32768)
-        sum1 = -32768;
-    else if (sum1 > 32767)
-        sum1 = 32767;
-    return sum1;
-}
-
-#define MULS(ra, rb) MUL64(ra, rb)
-
-#endif
-
-#define SUM8(sum, op, w, p) \
-{                                               \
-    sum op MULS((w)[0 * 64], p[0 * 64]);\
-    sum op MULS((w)[1 * 64], p[1 * 64]);\
-    sum op MULS((w)[2 * 64], p[2 * 64]);\
-    sum op MULS((w)[3 * 64], p[3 * 64]);\
-    sum op MULS((w)[4 * 64], p[4 * 64]);\
-    sum op MULS((w)[5 * 64], p[5 * 64]);\
-    sum op MULS((w)[6 * 64], p[6 * 64]);\
-    sum op MULS((w)[7 * 64], p[7 * 64]);\
-}
-
-#define SUM8P2(sum1, op1, sum2, op2, w1, w2, p) \
-{                                               \
-    int tmp;\
-    tmp = p[0 * 64];\
-    sum1 op1 MULS((w1)[0 * 64], tmp);\
-    sum2 op2 MULS((w2)[0 * 64], tmp);\
-    tmp = p[1 * 64];\
-    sum1 op1 MULS((w1)[1 * 64], tmp);\
-    sum2 op2 MULS((w2)[1 * 64], tmp);\
-    tmp = p[2 * 64];\
-    sum1 op1 MULS((w1)[2 * 64], tmp);\
-    sum2 op2 MULS((w2)[2 * 64], tmp);\
-    tmp = p[3 * 64];\
-    sum1 op1 MULS((w1)[3 * 64], tmp);\
-    sum2 op2 MULS((w2)[3 * 64], tmp);\
-    tmp = p[4 * 64];\
-    sum1 op1 MULS((w1)[4 * 64], tmp);\
-    sum2 op2 MULS((w2)[4 * 64], tmp);\
-    tmp = p[5 * 64];\
-    sum1 op1 MULS((w1)[5 * 64], tmp);\
-    sum2 op2 MULS((w2)[5 * 64], tmp);\
-    tmp = p[6 * 64];\
-    sum1 op1 MULS((w1)[6 * 64], tmp);\
-    sum2 op2 MULS((w2)[6 * 64], tmp);\
-    tmp = p[7 * 64];\
-    sum1 op1 MULS((w1)[7 * 64], tmp);\
-    sum2 op2 MULS((w2)[7 * 64], tmp);\
-}
-
-
-/* 32 sub band synthesis filter. Input: 32 sub band samples, Output:
-   32 samples. */
-/* XXX: optimize by avoiding ring buffer usage */
-static void synth_filter(MPADecodeContext *s1,
-                         int ch, int16_t *samples, int incr, 
-                         int32_t sb_samples[SBLIMIT])
-{
-    int32_t tmp[32];
-    MPA_INT *synth_buf;
-    const MPA_INT *w, *w2, *p;
-    int j, offset, v;
-    int16_t *samples2;
-#if FRAC_BITS <= 15
-    int32_t sum, sum2;
-#else
-    int64_t sum, sum2;
-#endif
-    
-    dct32(tmp, sb_samples);
-    
-    offset = s1->synth_buf_offset[ch];
-    synth_buf = s1->synth_buf[ch] + offset;
-
-    for(j=0;j<32;j++) {
-        v = tmp[j];
-#if FRAC_BITS <= 15
-        /* NOTE: can cause a loss in precision if very high amplitude
-           sound */
-        if (v > 32767)
-            v = 32767;
-        else if (v < -32768)
-            v = -32768;
-#endif
-        synth_buf[j] = v;
-    }
-    /* copy to avoid wrap */
-    memcpy(synth_buf + 512, synth_buf, 32 * sizeof(MPA_INT));
-
-    samples2 = samples + 31 * incr;
-    w = window;
-    w2 = window + 31;
-
-    sum = 0;
-    p = synth_buf + 16;
-    SUM8(sum, +=, w, p);
-    p = synth_buf + 48;
-    SUM8(sum, -=, w + 32, p);
-    *samples = round_sample(sum);
-    samples += incr;
-    w++;
-
-    /* we calculate two samples at the same time to avoid one memory
-       access per two sample */
-    for(j=1;j<16;j++) {
-        sum = 0;
-        sum2 = 0;
-        p = synth_buf + 16 + j;
-        SUM8P2(sum, +=, sum2, -=, w, w2, p);
-        p = synth_buf + 48 - j;
-        SUM8P2(sum, -=, sum2, -=, w + 32, w2 + 32, p);
-
-        *samples = round_sample(sum);
-        samples += incr;
-        *samples2 = round_sample(sum2);
-        samples2 -= incr;
-        w++;
-        w2--;
+    int i;
+
+    /* scale factors table for layer 1/2 */
+    for(i=0;i<64;i++) {
+        int shift, mod;
+        /* 1.0 (i = 3) is normalized to 2 ^ FRAC_BITS */
+        shift = (i / 3);
+        mod = i % 3;
+        scale_factor_modshift[i] = mod | (shift << 2);
     }
-    
-    p = synth_buf + 32;
-    sum = 0;
-    SUM8(sum, -=, w + 32, p);
-    *samples = round_sample(sum);
-
-    offset = (offset - 32) & 511;
-    s1->synth_buf_offset[ch] = offset;
-}
-
-/* cos(pi*i/24) */
-#define C1  FIXR(0.99144486137381041114)
-#define C3  FIXR(0.92387953251128675612)
-#define C5  FIXR(0.79335334029123516458)
-#define C7  FIXR(0.60876142900872063941)
-#define C9  FIXR(0.38268343236508977173)
-#define C11 FIXR(0.13052619222005159154)
-
-/* 12 points IMDCT. We compute it "by hand" by factorizing obvious
-   cases. */
-static void imdct12(int *out, int *in)
-{
-    int tmp;
-    int64_t in1_3, in1_9, in4_3, in4_9;
-
-    in1_3 = MUL64(in[1], C3);
-    in1_9 = MUL64(in[1], C9);
-    in4_3 = MUL64(in[4], C3);
-    in4_9 = MUL64(in[4], C9);
-    
-    tmp = FRAC_RND(MUL64(in[0], C7) - in1_3 - MUL64(in[2], C11) + 
-                   MUL64(in[3], C1) - in4_9 - MUL64(in[5], C5));
-    out[0] = tmp;
-    out[5] = -tmp;
-    tmp = FRAC_RND(MUL64(in[0] - in[3], C9) - in1_3 + 
-                   MUL64(in[2] + in[5], C3) - in4_9);
-    out[1] = tmp;
-    out[4] = -tmp;
-    tmp = FRAC_RND(MUL64(in[0], C11) - in1_9 + MUL64(in[2], C7) -
-                   MUL64(in[3], C5) + in4_3 - MUL64(in[5], C1));
-    out[2] = tmp;
-    out[3] = -tmp;
-    tmp = FRAC_RND(MUL64(-in[0], C5) + in1_9 + MUL64(in[2], C1) + 
-                   MUL64(in[3], C11) - in4_3 - MUL64(in[5], C7));
-    out[6] = tmp;
-    out[11] = tmp;
-    tmp = FRAC_RND(MUL64(-in[0] + in[3], C3) - in1_9 + 
-                   MUL64(in[2] + in[5], C9) + in4_3);
-    out[7] = tmp;
-    out[10] = tmp;
-    tmp = FRAC_RND(-MUL64(in[0], C1) - in1_3 - MUL64(in[2], C5) -
-                   MUL64(in[3], C7) - in4_9 - MUL64(in[5], C11));
-    out[8] = tmp;
-    out[9] = tmp;
-}
-
-#undef C1
-#undef C3
-#undef C5
-#undef C7
-#undef C9
-#undef C11
-
-/* cos(pi*i/18) */
-#define C1 FIXR(0.98480775301220805936)
-#define C2 FIXR(0.93969262078590838405)
-#define C3 FIXR(0.86602540378443864676)
-#define C4 FIXR(0.76604444311897803520)
-#define C5 FIXR(0.64278760968653932632)
-#define C6 FIXR(0.5)
-#define C7 FIXR(0.34202014332566873304)
-#define C8 FIXR(0.17364817766693034885)
-
-/* 0.5 / cos(pi*(2*i+1)/36) */
-static const int icos36[9] = {
-    FIXR(0.50190991877167369479),
-    FIXR(0.51763809020504152469),
-    FIXR(0.55168895948124587824),
-    FIXR(0.61038729438072803416),
-    FIXR(0.70710678118654752439),
-    FIXR(0.87172339781054900991),
-    FIXR(1.18310079157624925896),
-    FIXR(1.93185165257813657349),
-    FIXR(5.73685662283492756461),
-};
 
-static const int icos72[18] = {
-    /* 0.5 / cos(pi*(2*i+19)/72) */
-    FIXR(0.74009361646113053152),
-    FIXR(0.82133981585229078570),
-    FIXR(0.93057949835178895673),
-    FIXR(1.08284028510010010928),
-    FIXR(1.30656296487637652785),
-    FIXR(1.66275476171152078719),
-    FIXR(2.31011315767264929558),
-    FIXR(3.83064878777019433457),
-    FIXR(11.46279281302667383546),
-
-    /* 0.5 / cos(pi*(2*(i + 18) +19)/72) */
-    FIXR(-0.67817085245462840086),
-    FIXR(-0.63023620700513223342),
-    FIXR(-0.59284452371708034528),
-    FIXR(-0.56369097343317117734),
-    FIXR(-0.54119610014619698439),
-    FIXR(-0.52426456257040533932),
-    FIXR(-0.51213975715725461845),
-    FIXR(-0.50431448029007636036),
-    FIXR(-0.50047634258165998492),
-};
-
-/* using Lee like decomposition followed by hand coded 9 points DCT */
-static void imdct36(int *out, int *in)
-{
-    int i, j, t0, t1, t2, t3, s0, s1, s2, s3;
-    int tmp[18], *tmp1, *in1;
-    int64_t in3_3, in6_6;
-
-    for(i=17;i>=1;i--)
-        in[i] += in[i-1];
-    for(i=17;i>=3;i-=2)
-        in[i] += in[i-2];
-
-    for(j=0;j<2;j++) {
-        tmp1 = tmp + j;
-        in1 = in + j;
-
-        in3_3 = MUL64(in1[2*3], C3);
-        in6_6 = MUL64(in1[2*6], C6);
-
-        tmp1[0] = FRAC_RND(MUL64(in1[2*1], C1) + in3_3 + 
-                           MUL64(in1[2*5], C5) + MUL64(in1[2*7], C7));
-        tmp1[2] = in1[2*0] + FRAC_RND(MUL64(in1[2*2], C2) + 
-                                      MUL64(in1[2*4], C4) + in6_6 + 
-                                      MUL64(in1[2*8], C8));
-        tmp1[4] = FRAC_RND(MUL64(in1[2*1] - in1[2*5] - in1[2*7], C3));
-        tmp1[6] = FRAC_RND(MUL64(in1[2*2] - in1[2*4] - in1[2*8], C6)) - 
-            in1[2*6] + in1[2*0];
-        tmp1[8] = FRAC_RND(MUL64(in1[2*1], C5) - in3_3 - 
-                           MUL64(in1[2*5], C7) + MUL64(in1[2*7], C1));
-        tmp1[10] = in1[2*0] + FRAC_RND(MUL64(-in1[2*2], C8) - 
-                                       MUL64(in1[2*4], C2) + in6_6 + 
-                                       MUL64(in1[2*8], C4));
-        tmp1[12] = FRAC_RND(MUL64(in1[2*1], C7) - in3_3 + 
-                            MUL64(in1[2*5], C1) - 
-                            MUL64(in1[2*7], C5));
-        tmp1[14] = in1[2*0] + FRAC_RND(MUL64(-in1[2*2], C4) + 
-                                       MUL64(in1[2*4], C8) + in6_6 - 
-                                       MUL64(in1[2*8], C2));
-        tmp1[16] = in1[2*0] - in1[2*2] + in1[2*4] - in1[2*6] + in1[2*8];
-    }
-
-    i = 0;
-    for(j=0;j<4;j++) {
-        t0 = tmp[i];
-        t1 = tmp[i + 2];
-        s0 = t1 + t0;
-        s2 = t1 - t0;
-
-        t2 = tmp[i + 1];
-        t3 = tmp[i + 3];
-        s1 = MULL(t3 + t2, icos36[j]);
-        s3 = MULL(t3 - t2, icos36[8 - j]);
-        
-        t0 = MULL(s0 + s1, icos72[9 + 8 - j]);
-        t1 = MULL(s0 - s1, icos72[8 - j]);
-        out[18 + 9 + j] = t0;
-        out[18 + 8 - j] = t0;
-        out[9 + j] = -t1;
-        out[8 - j] = t1;
-        
-        t0 = MULL(s2 + s3, icos72[9+j]);
-        t1 = MULL(s2 - s3, icos72[j]);
-        out[18 + 9 + (8 - j)] = t0;
-        out[18 + j] = t0;
-        out[9 + (8 - j)] = -t1;
-        out[j] = t1;
-        i += 4;
+    /* scale factor multiply for layer 1 */
+    for(i=0;i<15;i++) {
+        int n, norm;
+        n = i + 2;
+        norm = (((int64_t)(1) << n) * FRAC_ONE) / ((1 << n) - 1);
+        scale_factor_mult[i][0] = MULL(FIXR(1.0 * 2.0), norm);
+        scale_factor_mult[i][1] = MULL(FIXR(0.7937005259 * 2.0), norm);
+        scale_factor_mult[i][2] = MULL(FIXR(0.6299605249 * 2.0), norm);
+#ifdef DEBUG
+        printf("%d: norm=%x s=%x %x %x\n",
+               i, norm, 
+               scale_factor_mult[i][0],
+               scale_factor_mult[i][1],
+               scale_factor_mult[i][2]);
+#endif
     }
-
-    s0 = tmp[16];
-    s1 = MULL(tmp[17], icos36[4]);
-    t0 = MULL(s0 + s1, icos72[9 + 4]);
-    t1 = MULL(s0 - s1, icos72[4]);
-    out[18 + 9 + 4] = t0;
-    out[18 + 8 - 4] = t0;
-    out[9 + 4] = -t1;
-    out[8 - 4] = t1;
 }
 
 /* fast header check for resync */
@@ -1169,6 +443,69 @@ static int decode_header(MPADecodeContext *s, uint32_t header)
     return 0;
 }
 
+int mpaudec_parse_header(MPAuDecHeader *h, const uint8_t *buf)
+{
+    uint32_t header;
+    int lsf, mpeg25, padding, bitrate_index, frame_size;
+
+    header = (buf[0] << 24) | (buf[1] << 16) | (buf[2] << 8) | buf[3];
+    if (check_header(header) < 0)
+        return -1;
+
+    if (header & (1<<20)) {
+        lsf = (header & (1<<19)) ? 0 : 1;
+        mpeg25 = 0;
+    } else {
+        lsf = 1;
+        mpeg25 = 1;
+    }
+    h->layer = 4 - ((header >> 17) & 3);
+    h->sample_rate = mpa_freq_tab[(header >> 10) & 3] >> (lsf + mpeg25);
+    h->channels = ((header >> 6) & 3) == MPA_MONO ? 1 : 2;
+
+    switch(h->layer) {
+    case 1:
+        h->frame_size = 384;
+        break;
+    case 2:
+        h->frame_size = 1152;
+        break;
+    default:
+    case 3:
+        h->frame_size = lsf ? 576 : 1152;
+        break;
+    }
+
+    bitrate_index = (header >> 12) & 0xf;
+    if (bitrate_index == 0) {
+        h->bit_rate = 0;
+        h->coded_frame_size = 0;
+        return 1;
+    }
+
+    /* same as decode_header() */
+    padding = (header >> 9) & 1;
+    frame_size = mpa_bitrate_tab[lsf][h->layer - 1][bitrate_index];
+    h->bit_rate = frame_size * 1000;
+    switch(h->layer) {
+    case 1:
+        frame_size = (frame_size * 12000) / h->sample_rate;
+        frame_size = (frame_size + padding) * 4;
+        break;
+    case 2:
+        frame_size = (frame_size * 144000) / h->sample_rate;
+        frame_size += padding;
+        break;
+    default:
+    case 3:
+        frame_size = (frame_size * 144000) / (h->sample_rate << lsf);
+        frame_size += padding;
+        break;
+    }
+    h->coded_frame_size = frame_size;
+    return 0;
+}
+
 /* return the number of decoded frames */
 static int mp_decode_layer1(MPADecodeContext *s)
 {
@@ -1216,7 +553,7 @@ static int mp_decode_layer1(MPADecodeContext *s)
                 } else {
                     v = 0;
                 }
-                s->sb_samples[ch][j][i] = v;
+                s->sb_samples.fixed23[ch][j][i] = v;
             }
         }
         for(i=bound;i<SBLIMIT;i++) {
@@ -1224,12 +561,12 @@ static int mp_decode_layer1(MPADecodeContext *s)
             if (n) {
                 mant = get_bits(&s->gb, n + 1);
                 v = l1_unscale(n, mant, scale_factors[0][i]);
-                s->sb_samples[0][j][i] = v;
+                s->sb_samples.fixed23[0][j][i] = v;
                 v = l1_unscale(n, mant, scale_factors[1][i]);
-                s->sb_samples[1][j][i] = v;
+                s->sb_samples.fixed23[1][j][i] = v;
             } else {
-                s->sb_samples[0][j][i] = 0;
-                s->sb_samples[1][j][i] = 0;
+                s->sb_samples.fixed23[0][j][i] = 0;
+                s->sb_samples.fixed23[1][j][i] = 0;
             }
         }
     }
@@ -1279,6 +616,10 @@ static int mp_decode_layer2(MPADecodeContext *s)
     else
         bound = sblimit;
 
+    /* the low rate tables have fewer subbands than a joint stereo bound */
+    if (bound > sblimit)
+        bound = sblimit;
+
 #ifdef DEBUG
     printf("bound=%d sblimit=%d\n", bound, sblimit);
 #endif
@@ -1379,25 +720,25 @@ static int mp_decode_layer2(MPADecodeContext *s)
                             /* 3 values at the same time */
                             v = get_bits(&s->gb, -bits);
                             steps = quant_steps[qindex];
-                            s->sb_samples[ch][k * 12 + l + 0][i] = 
+                            s->sb_samples.fixed23[ch][k * 12 + l + 0][i] = 
                                 l2_unscale_group(steps, v % steps, scale);
                             v = v / steps;
-                            s->sb_samples[ch][k * 12 + l + 1][i] = 
+                            s->sb_samples.fixed23[ch][k * 12 + l + 1][i] = 
                                 l2_unscale_group(steps, v % steps, scale);
                             v = v / steps;
-                            s->sb_samples[ch][k * 12 + l + 2][i] = 
+                            s->sb_samples.fixed23[ch][k * 12 + l + 2][i] = 
                                 l2_unscale_group(steps, v, scale);
                         } else {
                             for(m=0;m<3;m++) {
                                 v = get_bits(&s->gb, bits);
                                 v = l1_unscale(bits - 1, v, scale);
-                                s->sb_samples[ch][k * 12 + l + m][i] = v;
+                                s->sb_samples.fixed23[ch][k * 12 + l + m][i] = v;
                             }
                         }
                     } else {
-                        s->sb_samples[ch][k * 12 + l + 0][i] = 0;
-                        s->sb_samples[ch][k * 12 + l + 1][i] = 0;
-                        s->sb_samples[ch][k * 12 + l + 2][i] = 0;
+                        s->sb_samples.fixed23[ch][k * 12 + l + 0][i] = 0;
+                        s->sb_samples.fixed23[ch][k * 12 + l + 1][i] = 0;
+                        s->sb_samples.fixed23[ch][k * 12 + l + 2][i] = 0;
                     }
                 }
                 /* next subband in alloc table */
@@ -1419,36 +760,36 @@ static int mp_decode_layer2(MPADecodeContext *s)
                         steps = quant_steps[qindex];
                         mant = v % steps;
                         v = v / steps;
-                        s->sb_samples[0][k * 12 + l + 0][i] = 
+                        s->sb_samples.fixed23[0][k * 12 + l + 0][i] = 
                             l2_unscale_group(steps, mant, scale0);
-                        s->sb_samples[1][k * 12 + l + 0][i] = 
+                        s->sb_samples.fixed23[1][k * 12 + l + 0][i] = 
                             l2_unscale_group(steps, mant, scale1);
                         mant = v % steps;
                         v = v / steps;
-                        s->sb_samples[0][k * 12 + l + 1][i] = 
+                        s->sb_samples.fixed23[0][k * 12 + l + 1][i] = 
                             l2_unscale_group(steps, mant, scale0);
-                        s->sb_samples[1][k * 12 + l + 1][i] = 
+                        s->sb_samples.fixed23[1][k * 12 + l + 1][i] = 
                             l2_unscale_group(steps, mant, scale1);
-                        s->sb_samples[0][k * 12 + l + 2][i] = 
+                        s->sb_samples.fixed23[0][k * 12 + l + 2][i] = 
                             l2_unscale_group(steps, v, scale0);
-                        s->sb_samples[1][k * 12 + l + 2][i] = 
+                        s->sb_samples.fixed23[1][k * 12 + l + 2][i] = 
                             l2_unscale_group(steps, v, scale1);
                     } else {
                         for(m=0;m<3;m++) {
                             mant = get_bits(&s->gb, bits);
-                            s->sb_samples[0][k * 12 + l + m][i] = 
+                            s->sb_samples.fixed23[0][k * 12 + l + m][i] = 
                                 l1_unscale(bits - 1, mant, scale0);
-                            s->sb_samples[1][k * 12 + l + m][i] = 
+                            s->sb_samples.fixed23[1][k * 12 + l + m][i] = 
                                 l1_unscale(bits - 1, mant, scale1);
                         }
                     }
                 } else {
-                    s->sb_samples[0][k * 12 + l + 0][i] = 0;
-                    s->sb_samples[0][k * 12 + l + 1][i] = 0;
-                    s->sb_samples[0][k * 12 + l + 2][i] = 0;
-                    s->sb_samples[1][k * 12 + l + 0][i] = 0;
-                    s->sb_samples[1][k * 12 + l + 1][i] = 0;
-                    s->sb_samples[1][k * 12 + l + 2][i] = 0;
+                    s->sb_samples.fixed23[0][k * 12 + l + 0][i] = 0;
+                    s->sb_samples.fixed23[0][k * 12 + l + 1][i] = 0;
+                    s->sb_samples.fixed23[0][k * 12 + l + 2][i] = 0;
+                    s->sb_samples.fixed23[1][k * 12 + l + 0][i] = 0;
+                    s->sb_samples.fixed23[1][k * 12 + l + 1][i] = 0;
+                    s->sb_samples.fixed23[1][k * 12 + l + 2][i] = 0;
                 }
                 /* next subband in alloc table */
                 j += 1 << bit_alloc_bits; 
@@ -1456,9 +797,9 @@ static int mp_decode_layer2(MPADecodeContext *s)
             /* fill remaining samples to zero */
             for(i=sblimit;i<SBLIMIT;i++) {
                 for(ch=0;ch<s->nb_channels;ch++) {
-                    s->sb_samples[ch][k * 12 + l + 0][i] = 0;
-                    s->sb_samples[ch][k * 12 + l + 1][i] = 0;
-                    s->sb_samples[ch][k * 12 + l + 2][i] = 0;
+                    s->sb_samples.fixed23[ch][k * 12 + l + 0][i] = 0;
+                    s->sb_samples.fixed23[ch][k * 12 + l + 1][i] = 0;
+                    s->sb_samples.fixed23[ch][k * 12 + l + 2][i] = 0;
                 }
             }
         }
@@ -1556,407 +897,159 @@ static int get_bitsz(GetBitContext *s, int n)
         return get_bits(s, n);
 }
 
-static int huffman_decode(MPADecodeContext *s, GranuleDef *g,
-                          int16_t *exponents, int end_pos)
+/* the layer 3 kernels, all macros above are redefined by the template */
+#undef FRAC_BITS
+#undef FRAC_ONE
+#undef MULL
+#undef MUL64
+#undef FIX
+#undef FIXR
+#undef FRAC_RND
+
+#define MPA_PREC fixed23
+#define MPA_FRAC_BITS 23
+#include "mpaudec_template.h"
+
+#define MPA_PREC fixed15
+#define MPA_FRAC_BITS 15
+#include "mpaudec_template.h"
+
+#define MPA_PREC float32
+#define MPA_FLOAT
+#include "mpaudec_template.h"
+
+/* puts the per stream state into the state of a new decoder */
+static void reset_context(MPADecodeContext *s)
 {
-    int s_index;
-    int linbits, code, x, y, l, v, i, j, k, pos;
-    GetBitContext last_gb;
-    VLC *vlc;
-    uint8_t *code_table;
-
-    /* low frequencies (called big values) */
-    s_index = 0;
-    for(i=0;i<3;i++) {
-        j = g->region_size[i];
-        if (j == 0)
-            continue;
-        /* select vlc table */
-        k = g->table_select[i];
-        l = mpa_huff_data[k][0];
-        linbits = mpa_huff_data[k][1];
-        vlc = &huff_vlc[l];
-        code_table = huff_code_table[l];
-
-        /* read huffcode and compute each couple */
-        for(;j>0;j--) {
-            if (get_bits_count(&s->gb) >= end_pos)
-                break;
-            if (code_table) {
-                code = get_vlc(&s->gb, vlc);
-                if (code < 0)
-                    return -1;
-                y = code_table[code];
-                x = y >> 4;
-                y = y & 0x0f;
-            } else {
-                x = 0;
-                y = 0;
-            }
-#ifdef DEBUG
-            printf("region=%d n=%d x=%d y=%d exp=%d\n", 
-                   i, g->region_size[i] - j, x, y, exponents[s_index]);
-#endif
-            if (x) {
-                if (x == 15)
-                    x += get_bitsz(&s->gb, linbits);
-                v = l3_unscale(x, exponents[s_index]);
-                if (get_bits(&s->gb, 1))
-                    v = -v;
-            } else {
-                v = 0;
-            }
-            g->sb_hybrid[s_index++] = v;
-            if (y) {
-                if (y == 15)
-                    y += get_bitsz(&s->gb, linbits);
-                v = l3_unscale(y, exponents[s_index]);
-                if (get_bits(&s->gb, 1))
-                    v = -v;
-            } else {
-                v = 0;
-            }
-            g->sb_hybrid[s_index++] = v;
-        }
-    }
-            
-    /* high frequencies */
-    vlc = &huff_quad_vlc[g->count1table_select];
-    last_gb.buffer = NULL;
-    while (s_index <= 572) {
-        pos = get_bits_count(&s->gb);
-        if (pos >= end_pos) {
-            if (pos > end_pos && last_gb.buffer != NULL) {
-                /* some encoders generate an incorrect size for this
-                   part. We must go back into the data */
-                s_index -= 4;
-                s->gb = last_gb;
-            }
-            break;
-        }
-        last_gb= s->gb;
-
-        code = get_vlc(&s->gb, vlc);
-#ifdef DEBUG
-        printf("t=%d code=%d\n", g->count1table_select, code);
-#endif
-        if (code < 0)
-            return -1;
-        for(i=0;i<4;i++) {
-            if (code & (8 >> i)) {
-                /* non zero value. Could use a hand coded function for
-                   'one' value */
-                v = l3_unscale(1, exponents[s_index]);
-                if(get_bits(&s->gb, 1))
-                    v = -v;
-            } else {
-                v = 0;
-            }
-            g->sb_hybrid[s_index++] = v;
-        }
-    }
-    while (s_index < 576)
-        g->sb_hybrid[s_index++] = 0;
-    return 0;
+    memset(s, 0, sizeof(MPADecodeContext));
+    s->kernels = &kernels_fixed23;
+    s->inbuf_index = 0;
+    s->inbuf = &s->inbuf1[s->inbuf_index][BACKSTEP_SIZE];
+    s->inbuf_ptr = s->inbuf;
 }
 
-/* Reorder short blocks from bitstream order to interleaved order. It
-   would be faster to do it in parsing, but the code would be far more
-   complicated */
-static void reorder_block(MPADecodeContext *s, GranuleDef *g)
+int mpaudec_init(MPAuDecContext * mpctx)
 {
-    int i, j, k, len;
-    int32_t *ptr, *dst, *ptr1;
-    int32_t tmp[576];
-
-    if (g->block_type != 2)
-        return;
-
-    if (g->switch_point) {
-        if (s->sample_rate_index != 8) {
-            ptr = g->sb_hybrid + 36;
-        } else {
-            ptr = g->sb_hybrid + 48;
-        }
-    } else {
-        ptr = g->sb_hybrid;
-    }
-    
-    for(i=g->short_start;i<13;i++) {
-        len = band_size_short[s->sample_rate_index][i];
-        ptr1 = ptr;
-        for(k=0;k<3;k++) {
-            dst = tmp + k;
-            for(j=len;j>0;j--) {
-                *dst = *ptr++;
-                dst += 3;
-            }
-        }
-        memcpy(ptr1, tmp, len * 3 * sizeof(int32_t));
-    }
-}
+    MPADecodeContext *s;
+    static int init=0;
+    int i, j, k;
+    assert(mpctx != NULL);
+    memset(mpctx, 0, sizeof(MPAuDecContext));
+    mpctx->priv_data = calloc(1, sizeof(MPADecodeContext));
+    if (mpctx->priv_data == NULL)
+        return -1;
+    s = mpctx->priv_data;
 
-#define ISQRT2 FIXR(0.70710678118654752440)
+    if (!init && !mpctx->parse_only) {
+        l12_init_tables();
+        
+        /* huffman decode tables */
+        huff_code_table[0] = NULL;
+        for(i=1;i<16;i++) {
+            const HuffTable *h = &mpa_huff_tables[i];
+            int xsize, x, y;
+            unsigned int n;
+            uint8_t *code_table;
 
-static void compute_stereo(MPADecodeContext *s,
-                           GranuleDef *g0, GranuleDef *g1)
-{
-    int i, j, k, l;
-    int32_t v1, v2;
-    int sf_max, tmp0, tmp1, sf, len, non_zero_found;
-    int32_t (*is_tab)[16];
-    int32_t *tab0, *tab1;
-    int non_zero_found_short[3];
-
-    /* intensity stereo */
-    if (s->mode_ext & MODE_EXT_I_STEREO) {
-        if (!s->lsf) {
-            is_tab = is_table;
-            sf_max = 7;
-        } else {
-            is_tab = is_table_lsf[g1->scalefac_compress & 1];
-            sf_max = 16;
-        }
+            xsize = h->xsize;
+            n = xsize * xsize;
+            /* XXX: fail test */
+            init_vlc(&huff_vlc[i], 8, n, 
+                     h->bits, 1, 1, h->codes, 2, 2);
             
-        tab0 = g0->sb_hybrid + 576;
-        tab1 = g1->sb_hybrid + 576;
-
-        non_zero_found_short[0] = 0;
-        non_zero_found_short[1] = 0;
-        non_zero_found_short[2] = 0;
-        k = (13 - g1->short_start) * 3 + g1->long_end - 3;
-        for(i = 12;i >= g1->short_start;i--) {
-            /* for last band, use previous scale factor */
-            if (i != 11)
-                k -= 3;
-            len = band_size_short[s->sample_rate_index][i];
-            for(l=2;l>=0;l--) {
-                tab0 -= len;
-                tab1 -= len;
-                if (!non_zero_found_short[l]) {
-                    /* test if non zero band. if so, stop doing i-stereo */
-                    for(j=0;j<len;j++) {
-                        if (tab1[j] != 0) {
-                            non_zero_found_short[l] = 1;
-                            goto found1;
-                        }
-                    }
-                    sf = g1->scale_factors[k + l];
-                    if (sf >= sf_max)
-                        goto found1;
-
-                    v1 = is_tab[0][sf];
-                    v2 = is_tab[1][sf];
-                    for(j=0;j<len;j++) {
-                        tmp0 = tab0[j];
-                        tab0[j] = MULL(tmp0, v1);
-                        tab1[j] = MULL(tmp0, v2);
-                    }
-                } else {
-                found1:
-                    if (s->mode_ext & MODE_EXT_MS_STEREO) {
-                        /* lower part of the spectrum : do ms stereo
-                           if enabled */
-                        for(j=0;j<len;j++) {
-                            tmp0 = tab0[j];
-                            tmp1 = tab1[j];
-                            tab0[j] = MULL(tmp0 + tmp1, ISQRT2);
-                            tab1[j] = MULL(tmp0 - tmp1, ISQRT2);
-                        }
-                    }
-                }
+            code_table = calloc(n, 1);
+            j = 0;
+            for(x=0;x<xsize;x++) {
+                for(y=0;y<xsize;y++)
+                    code_table[j++] = (x << 4) | y;
             }
+            huff_code_table[i] = code_table;
+            init_huff_pairs(i);
+        }
+        for(i=0;i<2;i++) {
+            init_vlc(&huff_quad_vlc[i], i == 0 ? 7 : 4, 16, 
+                     mpa_quad_bits[i], 1, 1, mpa_quad_codes[i], 1, 1);
         }
 
-        non_zero_found = non_zero_found_short[0] | 
-            non_zero_found_short[1] | 
-            non_zero_found_short[2];
-
-        for(i = g1->long_end - 1;i >= 0;i--) {
-            len = band_size_long[s->sample_rate_index][i];
-            tab0 -= len;
-            tab1 -= len;
-            /* test if non zero band. if so, stop doing i-stereo */
-            if (!non_zero_found) {
-                for(j=0;j<len;j++) {
-                    if (tab1[j] != 0) {
-                        non_zero_found = 1;
-                        goto found2;
-                    }
-                }
-                /* for last band, use previous scale factor */
-                k = (i == 21) ? 20 : i;
-                sf = g1->scale_factors[k];
-                if (sf >= sf_max)
-                    goto found2;
-                v1 = is_tab[0][sf];
-                v2 = is_tab[1][sf];
-                for(j=0;j<len;j++) {
-                    tmp0 = tab0[j];
-                    tab0[j] = MULL(tmp0, v1);
-                    tab1[j] = MULL(tmp0, v2);
-                }
-            } else {
-            found2:
-                if (s->mode_ext & MODE_EXT_MS_STEREO) {
-                    /* lower part of the spectrum : do ms stereo
-                       if enabled */
-                    for(j=0;j<len;j++) {
-                        tmp0 = tab0[j];
-                        tmp1 = tab1[j];
-                        tab0[j] = MULL(tmp0 + tmp1, ISQRT2);
-                        tab1[j] = MULL(tmp0 - tmp1, ISQRT2);
-                    }
-                }
+        for(i=0;i<9;i++) {
+            k = 0;
+            for(j=0;j<22;j++) {
+                band_index_long[i][j] = k;
+                k += band_size_long[i][j];
             }
+            band_index_long[i][22] = k;
         }
-    } else if (s->mode_ext & MODE_EXT_MS_STEREO) {
-        /* ms stereo ONLY */
-        /* NOTE: the 1/sqrt(2) normalization factor is included in the
-           global gain */
-        tab0 = g0->sb_hybrid;
-        tab1 = g1->sb_hybrid;
-        for(i=0;i<576;i++) {
-            tmp0 = tab0[i];
-            tmp1 = tab1[i];
-            tab0[i] = tmp0 + tmp1;
-            tab1[i] = tmp0 - tmp1;
-        }
+
+        kernels_fixed23.init_tables();
+        kernels_fixed15.init_tables();
+        kernels_float32.init_tables();
+
+        if (simd_level < 0)
+            mpaudec_set_simd(MPAUDEC_SIMD_AVX2);
+        init = 1;
     }
+
+    reset_context(s);
+    return 0;
 }
 
-static void compute_antialias(MPADecodeContext *s,
-                              GranuleDef *g)
+void mpaudec_reset(MPAuDecContext *mpctx)
 {
-    int32_t *ptr, *p0, *p1, *csa;
-    int n, tmp0, tmp1, i, j;
-
-    /* we antialias only "long" bands */
-    if (g->block_type == 2) {
-        if (!g->switch_point)
-            return;
-        /* XXX: check this for 8000Hz case */
-        n = 1;
-    } else {
-        n = SBLIMIT - 1;
-    }
-    
-    ptr = g->sb_hybrid + 18;
-    for(i = n;i > 0;i--) {
-        p0 = ptr - 1;
-        p1 = ptr;
-        csa = &csa_table[0][0];
-        for(j=0;j<8;j++) {
-            tmp0 = *p0;
-            tmp1 = *p1;
-            *p0 = FRAC_RND(MUL64(tmp0, csa[0]) - MUL64(tmp1, csa[1]));
-            *p1 = FRAC_RND(MUL64(tmp0, csa[1]) + MUL64(tmp1, csa[0]));
-            p0--;
-            p1++;
-            csa += 2;
-        }
-        ptr += 18;
-    }
+    assert(mpctx != NULL);
+    assert(mpctx->priv_data != NULL);
+    reset_context(mpctx->priv_data);
 }
 
-static void compute_imdct(MPADecodeContext *s,
-                          GranuleDef *g, 
-                          int32_t *sb_samples,
-                          int32_t *mdct_buf)
+void mpaudec_copy_state(MPAuDecContext *dst, const MPAuDecContext *src)
 {
-    int32_t *ptr, *win, *win1, *buf, *buf2, *out_ptr, *ptr1;
-    int32_t in[6];
-    int32_t out[36];
-    int32_t out2[12];
-    int i, j, k, mdct_long_end, v, sblimit;
-
-    /* find last non zero block */
-    ptr = g->sb_hybrid + 576;
-    ptr1 = g->sb_hybrid + 2 * 18;
-    while (ptr >= ptr1) {
-        ptr -= 6;
-        v = ptr[0] | ptr[1] | ptr[2] | ptr[3] | ptr[4] | ptr[5];
-        if (v != 0)
-            break;
-    }
-    sblimit = ((ptr - g->sb_hybrid) / 18) + 1;
-
-    if (g->block_type == 2) {
-        /* XXX: check for 8000 Hz */
-        if (g->switch_point)
-            mdct_long_end = 2;
-        else
-            mdct_long_end = 0;
-    } else {
-        mdct_long_end = sblimit;
-    }
+    MPADecodeContext *d, *s;
+    void *priv_data;
+    assert(dst != NULL && src != NULL);
+    assert(dst->priv_data != NULL && src->priv_data != NULL);
+    d = dst->priv_data;
+    s = src->priv_data;
+    memcpy(d, s, sizeof(MPADecodeContext));
+    /* the input pointers point into the context's own buffers. gb is set
+       up again for every frame, so its pointer may stay stale. */
+    d->inbuf = d->inbuf1[0] + (s->inbuf - s->inbuf1[0]);
+    d->inbuf_ptr = d->inbuf1[0] + (s->inbuf_ptr - s->inbuf1[0]);
+    priv_data = dst->priv_data;
+    *dst = *src;
+    dst->priv_data = priv_data;
+}
 
-    buf = mdct_buf;
-    ptr = g->sb_hybrid;
-    for(j=0;j<mdct_long_end;j++) {
-        imdct36(out, ptr);
-        /* apply window & overlap with previous buffer */
-        out_ptr = sb_samples + j;
-        /* select window */
-        if (g->switch_point && j < 2)
-            win1 = mdct_win[0];
-        else
-            win1 = mdct_win[g->block_type];
-        /* select frequency inversion */
-        win = win1 + ((4 * 36) & -(j & 1));
-        for(i=0;i<18;i++) {
-            *out_ptr = MULL(out[i], win[i]) + buf[i];
-            buf[i] = MULL(out[i + 18], win[i + 18]);
-            out_ptr += SBLIMIT;
-        }
-        ptr += 18;
-        buf += 18;
-    }
-    for(j=mdct_long_end;j<sblimit;j++) {
-        for(i=0;i<6;i++) {
-            out[i] = 0;
-            out[6 + i] = 0;
-            out[30+i] = 0;
-        }
-        /* select frequency inversion */
-        win = mdct_win[2] + ((4 * 36) & -(j & 1));
-        buf2 = out + 6;
-        for(k=0;k<3;k++) {
-            /* reorder input for short mdct */
-            ptr1 = ptr + k;
-            for(i=0;i<6;i++) {
-                in[i] = *ptr1;
-                ptr1 += 3;
-            }
-            imdct12(out2, in);
-            /* apply 12 point window and do small overlap */
-            for(i=0;i<6;i++) {
-                buf2[i] = MULL(out2[i], win[i]) + buf2[i];
-                buf2[i + 6] = MULL(out2[i + 6], win[i + 6]);
-            }
-            buf2 += 6;
-        }
-        /* overlap */
-        out_ptr = sb_samples + j;
-        for(i=0;i<18;i++) {
-            *out_ptr = out[i] + buf[i];
-            buf[i] = out[i + 18];
-            out_ptr += SBLIMIT;
-        }
-        ptr += 18;
-        buf += 18;
-    }
-    /* zero bands */
-    for(j=sblimit;j<SBLIMIT;j++) {
-        /* overlap */
-        out_ptr = sb_samples + j;
-        for(i=0;i<18;i++) {
-            *out_ptr = buf[i];
-            buf[i] = 0;
-            out_ptr += SBLIMIT;
-        }
-        buf += 18;
+int mpaudec_set_simd(int level)
+{
+    int supported = MPAUDEC_SIMD_NONE;
+#ifdef HAVE_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.1"))
+        supported = MPAUDEC_SIMD_SSE41;
+    if (__builtin_cpu_supports("avx2"))
+        supported = MPAUDEC_SIMD_AVX2;
+#endif
+    if (level > supported)
+        level = supported;
+    if (level < MPAUDEC_SIMD_NONE)
+        level = MPAUDEC_SIMD_NONE;
+
+    /* only the 23 bit kernels have SIMD versions */
+    kernels_fixed23.compute_antialias = compute_antialias_fixed23;
+    kernels_fixed23.compute_imdct = compute_imdct_fixed23;
+#ifdef HAVE_X86_SIMD
+    dct32_func = dct32_fixed23;
+    synth_window_func = NULL;
+    if (level >= MPAUDEC_SIMD_SSE41) {
+        dct32_func = dct32_sse41;
+        synth_window_func = synth_window_sse41;
+        kernels_fixed23.compute_antialias = compute_antialias_sse41;
+        kernels_fixed23.compute_imdct = compute_imdct_sse41;
     }
+    if (level >= MPAUDEC_SIMD_AVX2)
+        synth_window_func = synth_window_avx2;
+#endif
+    simd_level = level;
+    return level;
 }
 
 /* main layer3 decoding function */
@@ -2218,12 +1311,22 @@ static int mp_decode_layer3(MPADecodeContext *s)
 #endif
             }
 
-            exponents_from_scale_factors(s, g, exponents);
+            {
+                PROFILE_START(t);
+                exponents_from_scale_factors(s, g, exponents);
+                PROFILE_STOP(MPAUDEC_STAGE_DEQUANT, t);
+            }
 
             /* read Huffman coded residue */
-            if (huffman_decode(s, g, exponents,
-                               bits_pos + g->part2_3_length) < 0)
-                return -1;
+            {
+                int rv;
+                PROFILE_START(t);
+                rv = s->kernels->huffman_decode(s, g, exponents,
+                                                bits_pos + g->part2_3_length);
+                PROFILE_STOP(MPAUDEC_STAGE_HUFFMAN, t);
+                if (rv < 0)
+                    return -1;
+            }
 
             /* skip extension bits */
             bits_left = g->part2_3_length - (get_bits_count(&s->gb) - bits_pos);
@@ -2241,25 +1344,53 @@ static int mp_decode_layer3(MPADecodeContext *s)
                 skip_bits(&s->gb, bits_left);
         } /* ch */
 
-        if (s->nb_channels == 2)
-            compute_stereo(s, &granules[0][gr], &granules[1][gr]);
+        if (s->nb_channels == 2) {
+            PROFILE_START(t);
+            s->kernels->compute_stereo(s, &granules[0][gr], &granules[1][gr]);
+            PROFILE_STOP(MPAUDEC_STAGE_STEREO, t);
+        }
 
         for(ch=0;ch<s->nb_channels;ch++) {
+            PROFILE_START(t);
             g = &granules[ch][gr];
 
-            reorder_block(s, g);
-            compute_antialias(s, g);
-            compute_imdct(s, g, &s->sb_samples[ch][18 * gr][0], s->mdct_buf[ch]); 
+            s->kernels->reorder_block(s, g);
+            s->kernels->compute_antialias(s, g);
+            s->kernels->compute_imdct(s, g, ch, gr);
+            PROFILE_STOP(MPAUDEC_STAGE_IMDCT, t);
         }
     } /* gr */
     return nb_granules * 18;
 }
 
+/* chooses the kernels for the frame. Layers 1 and 2 are always decoded
+   with 23 bits. The filterbank state is only meaningful to the kernels
+   which wrote it, so it is cleared when they change. */
+static void select_kernels(MPADecodeContext *s, int precision)
+{
+    const MPAKernels *k = &kernels_fixed23;
+
+    if (s->layer == 3) {
+        if (precision == MPAUDEC_PRECISION_FIXED15)
+            k = &kernels_fixed15;
+        else if (precision == MPAUDEC_PRECISION_FLOAT)
+            k = &kernels_float32;
+    }
+    if (k != s->kernels) {
+        memset(&s->synth_buf, 0, sizeof(s->synth_buf));
+        memset(s->synth_buf_offset, 0, sizeof(s->synth_buf_offset));
+        memset(&s->mdct_buf, 0, sizeof(s->mdct_buf));
+        s->kernels = k;
+    }
+}
+
 static int mp_decode_frame(MPADecodeContext *s, 
                            int16_t *samples)
 {
-    int i, nb_frames, ch;
-    int16_t *samples_ptr;
+    int nb_frames;
+#if defined(DEBUG)
+    int i, ch;
+#endif
 
     init_get_bits(&s->gb, s->inbuf + HEADER_SIZE, 
                   (s->inbuf_ptr - s->inbuf - HEADER_SIZE)*8);
@@ -2273,11 +1404,16 @@ static int mp_decode_frame(MPADecodeContext *s,
 #endif
     switch(s->layer) {
     case 1:
-        nb_frames = mp_decode_layer1(s);
-        break;
-    case 2:
-        nb_frames = mp_decode_layer2(s);
+    case 2: {
+        /* layers 1 and 2 read and dequantize the samples in one pass */
+        PROFILE_START(t);
+        if (s->layer == 1)
+            nb_frames = mp_decode_layer1(s);
+        else
+            nb_frames = mp_decode_layer2(s);
+        PROFILE_STOP(MPAUDEC_STAGE_DEQUANT, t);
         break;
+    }
     case 3:
     default:
         nb_frames = mp_decode_layer3(s);
@@ -2289,19 +1425,16 @@ static int mp_decode_frame(MPADecodeContext *s,
             int j;
             printf("%d-%d:", i, ch);
             for(j=0;j<SBLIMIT;j++)
-                printf(" %0.6f", (double)s->sb_samples[ch][i][j] / FRAC_ONE);
+                printf(" %0.6f", (double)s->sb_samples.fixed23[ch][i][j] / (1 << 23));
             printf("\n");
         }
     }
 #endif
     /* apply the synthesis filter */
-    for(ch=0;ch<s->nb_channels;ch++) {
-        samples_ptr = samples + ch;
-        for(i=0;i<nb_frames;i++) {
-            synth_filter(s, ch, samples_ptr, s->nb_channels,
-                         s->sb_samples[ch][i]);
-            samples_ptr += 32 * s->nb_channels;
-        }
+    {
+    PROFILE_START(t);
+    s->kernels->synthesize(s, samples, nb_frames);
+    PROFILE_STOP(MPAUDEC_STAGE_SYNTH, t);
     }
 #ifdef DEBUG
     s->frame_count++;        
@@ -2317,6 +1450,7 @@ int mpaudec_decode_frame(MPAuDecContext * mpctx,
     const uint8_t *buf_ptr = buf;
     int out_size = 0;
     int16_t *out_samples = data;
+    PROFILE_START(total);
     assert(mpctx != NULL);
     assert(mpctx->priv_data != NULL);
     s = mpctx->priv_data;
@@ -2452,7 +1586,11 @@ int mpaudec_decode_frame(MPAuDecContext * mpctx,
                 *(uint8_t **)data = s->inbuf;
                 out_size = s->inbuf_ptr - s->inbuf;
             } else {
+                select_kernels(s, mpctx->precision);
                 out_size = mp_decode_frame(s, out_samples);
+#ifdef MPAUDEC_PROFILE
+                profile.frames++;
+#endif
             }
             if (free_format_next_header != 0) {
                 s->inbuf[0] = free_format_next_header >> 24;
@@ -2466,9 +1604,34 @@ int mpaudec_decode_frame(MPAuDecContext * mpctx,
         }
     }
     *data_size = out_size;
+    PROFILE_STOP(MPAUDEC_STAGE_HEADER, total);
     return buf_ptr - buf;
 }
 
+int mpaudec_get_profile(MPAuDecProfile *p)
+{
+#ifdef MPAUDEC_PROFILE
+    int i;
+    *p = profile;
+    /* the header stage was timed around everything, leave only the rest */
+    for(i=0;i<MPAUDEC_STAGE_COUNT;i++) {
+        if (i != MPAUDEC_STAGE_HEADER)
+            p->ns[MPAUDEC_STAGE_HEADER] -= p->ns[i];
+    }
+    return 1;
+#else
+    memset(p, 0, sizeof(*p));
+    return 0;
+#endif
+}
+
+void mpaudec_reset_profile(void)
+{
+#ifdef MPAUDEC_PROFILE
+    memset(&profile, 0, sizeof(profile));
+#endif
+}
+
 void mpaudec_clear(MPAuDecContext *mpctx)
 {
     assert(mpctx != NULL);
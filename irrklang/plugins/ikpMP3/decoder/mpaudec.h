@@ -9,6 +9,8 @@ extern "C" {
 
 /* in bytes */
 #define MPAUDEC_MAX_AUDIO_FRAME_SIZE 4608
+/* in samples per channel */
+#define MPAUDEC_MAX_FRAME_SAMPLES 1152
 
 typedef struct MPAuDecContext {
     int bit_rate;
@@ -19,14 +21,82 @@ typedef struct MPAuDecContext {
     void *priv_data;
     int parse_only;
     int coded_frame_size;
+    int precision;  /* MPAUDEC_PRECISION_*, may be changed after mpaudec_init() */
 } MPAuDecContext;
 
+typedef struct MPAuDecHeader {
+    int layer;
+    int sample_rate;
+    int channels;
+    int bit_rate;
+    int frame_size;       /* in samples per channel */
+    int coded_frame_size; /* in bytes, 0 for free format */
+} MPAuDecHeader;
+
 int mpaudec_init(MPAuDecContext *mpctx);
 int mpaudec_decode_frame(MPAuDecContext * mpctx,
                          void *data, int *data_size,
                          const unsigned char * buf, int buf_size);
 void mpaudec_clear(MPAuDecContext *mpctx);
 
+/* Puts the decoder back into the state mpaudec_init() left it in, without
+   allocating anything. The fields of MPAuDecContext are kept. */
+void mpaudec_reset(MPAuDecContext *mpctx);
+
+/* Copies the whole state of the decoder src, including the fields of
+   MPAuDecContext, into dst. Both must have been set up by mpaudec_init().
+   Doesn't allocate, so a stream can return to a saved state cheaply. */
+void mpaudec_copy_state(MPAuDecContext *dst, const MPAuDecContext *src);
+
+/* Parses the 4 byte frame header at buf without touching any decoder
+   state. Returns 0 if it is valid, 1 if it is valid but free format
+   (coded_frame_size is then unknown) and -1 if it is no frame header. */
+int mpaudec_parse_header(MPAuDecHeader *h, const unsigned char *buf);
+
+/* SIMD code paths of the decoder. By default the best one the CPU supports
+   is used, all of them produce the same output. */
+#define MPAUDEC_SIMD_NONE  0
+#define MPAUDEC_SIMD_SSE41 1
+#define MPAUDEC_SIMD_AVX2  2
+
+/* Arithmetic used for layer 3 and the synthesis filter. FIXED23 is bit
+   exact and the default. FIXED15 uses 15 fractional bits and 16 bit
+   synthesis buffers, FLOAT uses single precision floats, neither is bit
+   exact. SIMD code paths only exist for FIXED23, so on x86 it is also the
+   fastest one. Layers 1 and 2 are always decoded with FIXED23. */
+#define MPAUDEC_PRECISION_FIXED23 0
+#define MPAUDEC_PRECISION_FIXED15 1
+#define MPAUDEC_PRECISION_FLOAT   2
+
+/* Uses at most the given SIMD level, e.g. MPAUDEC_SIMD_NONE to run the
+   scalar reference code. Returns the level actually used. */
+int mpaudec_set_simd(int level);
+
+/* Decoding stages timed when the decoder is compiled with MPAUDEC_PROFILE.
+   Layer 3 requantizes every value right after reading its Huffman code, so
+   that work is part of MPAUDEC_STAGE_HUFFMAN and MPAUDEC_STAGE_DEQUANT only
+   covers turning scale factors into exponents. For layers 1 and 2 the whole
+   subband decode counts as MPAUDEC_STAGE_DEQUANT. MPAUDEC_STAGE_IMDCT
+   includes the short block reordering and the alias reduction. */
+#define MPAUDEC_STAGE_HEADER  0 /* frame sync, header, side info, buffering */
+#define MPAUDEC_STAGE_HUFFMAN 1
+#define MPAUDEC_STAGE_DEQUANT 2
+#define MPAUDEC_STAGE_STEREO  3
+#define MPAUDEC_STAGE_IMDCT   4
+#define MPAUDEC_STAGE_SYNTH   5
+#define MPAUDEC_STAGE_COUNT   6
+
+typedef struct MPAuDecProfile {
+    unsigned long long ns[MPAUDEC_STAGE_COUNT]; /* nanoseconds per stage */
+    unsigned long long frames;                  /* mp3 frames decoded */
+} MPAuDecProfile;
+
+/* Reads the stage times summed over all decoders since the last
+   mpaudec_reset_profile(). Returns 0 and zeroes *p if the decoder was
+   compiled without MPAUDEC_PROFILE. Not thread safe. */
+int mpaudec_get_profile(MPAuDecProfile *p);
+void mpaudec_reset_profile(void);
+
 #ifdef __cplusplus
 }
 #endif
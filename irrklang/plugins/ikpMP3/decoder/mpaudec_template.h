@@ -0,0 +1,2077 @@
+/*
+ * Precision dependent kernels of the MPEG audio decoder.
+ *
+ * This file is included by mpaudec.c once per arithmetic back end, like a
+ * template which is instantiated several times. Before every inclusion the
+ * includer defines
+ *
+ *   MPA_PREC       suffix of the instance: fixed15, fixed23 or float32
+ *   MPA_FRAC_BITS  fractional bits of the fixed point samples, 15 or 23
+ *   MPA_FLOAT      instead of MPA_FRAC_BITS, to compute with floats
+ *
+ * The code below is written with plain names. Every static table and
+ * function gets the suffix appended by the name macros, so each instance
+ * has its own copy and is only reached through its kernel table, e.g.
+ * kernels_fixed23. All macros defined here are undefined at the end.
+ */
+
+#define MPA_NAME3(name, prec) name##_##prec
+#define MPA_NAME2(name, prec) MPA_NAME3(name, prec)
+#define MPA_NAME(name) MPA_NAME2(name, MPA_PREC)
+
+#define table_4_3_exp       MPA_NAME(table_4_3_exp)
+#define table_4_3_value     MPA_NAME(table_4_3_value)
+#define is_table            MPA_NAME(is_table)
+#define is_table_lsf        MPA_NAME(is_table_lsf)
+#define csa_table           MPA_NAME(csa_table)
+#define mdct_win            MPA_NAME(mdct_win)
+#define scale_factor_mult3  MPA_NAME(scale_factor_mult3)
+#define window              MPA_NAME(window)
+#define dev_4_3_coefs       MPA_NAME(dev_4_3_coefs)
+#define pow_mult3           MPA_NAME(pow_mult3)
+#define int_pow_init        MPA_NAME(int_pow_init)
+#define int_pow             MPA_NAME(int_pow)
+#define l3_unscale          MPA_NAME(l3_unscale)
+#define init_tables         MPA_NAME(init_tables)
+#define dct32_final         MPA_NAME(dct32_final)
+#define dct32               MPA_NAME(dct32)
+#define round_sample        MPA_NAME(round_sample)
+#define synth_filter        MPA_NAME(synth_filter)
+#define synthesize          MPA_NAME(synthesize)
+#define imdct12             MPA_NAME(imdct12)
+#define icos36              MPA_NAME(icos36)
+#define icos72              MPA_NAME(icos72)
+#define imdct36             MPA_NAME(imdct36)
+#define huffman_decode      MPA_NAME(huffman_decode)
+#define reorder_block       MPA_NAME(reorder_block)
+#define compute_stereo      MPA_NAME(compute_stereo)
+#define compute_antialias   MPA_NAME(compute_antialias)
+#define imdct_limits        MPA_NAME(imdct_limits)
+#define imdct_long_bands    MPA_NAME(imdct_long_bands)
+#define imdct_short_bands   MPA_NAME(imdct_short_bands)
+#define imdct_zero_bands    MPA_NAME(imdct_zero_bands)
+#define compute_imdct       MPA_NAME(compute_imdct)
+#define kernel_table        MPA_NAME(kernels)
+
+#ifdef MPA_FLOAT
+
+#define INTFLOAT float  /* subband and spectral samples */
+#define MPA_INT  float  /* synthesis window and buffer */
+#define MPA_ACC  float  /* result of MUL64() */
+
+#define MULL(a,b) ((a) * (b))
+#define MUL64(a,b) ((a) * (b))
+#define FIX(a)   ((float)(a))
+#define FIXR(a)  ((float)(a))
+#define FRAC_RND(a) (a)
+
+#else
+
+#define FRAC_BITS   MPA_FRAC_BITS   /* fractional bits for sb_samples and dct */
+#if FRAC_BITS <= 15
+#define WFRAC_BITS  14   /* fractional bits for window */
+#else
+#define WFRAC_BITS  16
+#endif
+
+#define FRAC_ONE    (1 << FRAC_BITS)
+
+#define INTFLOAT int32_t
+#if FRAC_BITS <= 15
+#define MPA_INT int16_t
+#else
+#define MPA_INT int32_t
+#endif
+#define MPA_ACC int64_t
+
+#define MULL(a,b) (((int64_t)(a) * (int64_t)(b)) >> FRAC_BITS)
+#define MUL64(a,b) ((int64_t)(a) * (int64_t)(b))
+#define FIX(a)   ((int)((a) * FRAC_ONE))
+/* WARNING: only correct for posititive numbers */
+#define FIXR(a)   ((int)((a) * FRAC_ONE + 0.5))
+#define FRAC_RND(a) (((a) + (FRAC_ONE/2)) >> FRAC_BITS)
+
+/* the x86 SIMD code paths are bit exact versions of the 23 bit kernels */
+#if FRAC_BITS == 23 && defined(HAVE_X86_SIMD)
+#define USE_X86_SIMD
+#endif
+
+#endif /* MPA_FLOAT */
+
+#define TABLE_4_3_SIZE (8191 + 16)
+#ifdef MPA_FLOAT
+/* n^(4/3) */
+static float table_4_3_value[TABLE_4_3_SIZE];
+/* 2^(e/4) for e = -512..511, layer 3 exponents stay well inside */
+static float table_4_3_exp[1024];
+#else
+static int8_t  table_4_3_exp[TABLE_4_3_SIZE];
+#if FRAC_BITS <= 15
+static uint16_t table_4_3_value[TABLE_4_3_SIZE];
+#else
+static uint32_t table_4_3_value[TABLE_4_3_SIZE];
+#endif
+#endif
+/* intensity stereo coef table */
+static INTFLOAT is_table[2][16];
+static INTFLOAT is_table_lsf[2][2][16];
+static INTFLOAT csa_table[8][2];
+static INTFLOAT mdct_win[8][36];
+
+#ifndef MPA_FLOAT
+/* 2^(n/4) */
+static uint32_t scale_factor_mult3[4] = {
+    FIXR(1.0),
+    FIXR(1.18920711500272106671),
+    FIXR(1.41421356237309504880),
+    FIXR(1.68179283050742908605),
+};
+#endif
+
+static MPA_INT window[512];
+
+#ifdef USE_X86_SIMD
+/* synthesis filter code paths, chosen by mpaudec_set_simd() */
+static void dct32(int32_t *out, int32_t *tab);
+static void (*dct32_func)(int32_t *out, int32_t *tab) = dct32;
+static void (*synth_window_func)(const MPA_INT *synth_buf, int64_t *sums) = NULL;
+
+/* mdct_win[i] and mdct_win[i + 4] interleaved for 4 subbands starting at
+   an even one */
+static int32_t mdct_win4[4][36][4];
+#endif
+
+#ifdef MPA_FLOAT
+
+/* compute value^(4/3) * 2^(exponent/4) */
+static float l3_unscale(int value, int exponent)
+{
+    return table_4_3_value[value] * table_4_3_exp[exponent + 512];
+}
+
+#else
+
+/* compute value^(4/3) * 2^(exponent/4). It normalized to FRAC_BITS */
+static int l3_unscale(int value, int exponent)
+{
+#if FRAC_BITS <= 15    
+    unsigned int m;
+#else
+    uint64_t m;
+#endif
+    int e;
+
+    e = table_4_3_exp[value];
+    e += (exponent >> 2);
+    e = FRAC_BITS - e;
+#if FRAC_BITS <= 15    
+    if (e > 31)
+        e = 31;
+#endif
+    m = table_4_3_value[value];
+#if FRAC_BITS <= 15    
+    m = (m * scale_factor_mult3[exponent & 3]);
+    m = (m + (1 << (e-1))) >> e;
+    return m;
+#else
+    m = MUL64(m, scale_factor_mult3[exponent & 3]);
+    m = (m + ((uint64_t)(1) << (e-1))) >> e;
+    return (int)m;
+#endif
+}
+
+/* all integer n^(4/3) computation code */
+#define DEV_ORDER 13
+
+#define POW_FRAC_BITS 24
+#define POW_FRAC_ONE    (1 << POW_FRAC_BITS)
+#define POW_FIX(a)   ((int)((a) * POW_FRAC_ONE))
+#define POW_MULL(a,b) (((int64_t)(a) * (int64_t)(b)) >> POW_FRAC_BITS)
+
+static int dev_4_3_coefs[DEV_ORDER];
+
+static int pow_mult3[3] = {
+    POW_FIX(1.0),
+    POW_FIX(1.25992104989487316476),
+    POW_FIX(1.58740105196819947474),
+};
+
+static void int_pow_init(void)
+{
+    int i, a;
+
+    a = POW_FIX(1.0);
+    for(i=0;i<DEV_ORDER;i++) {
+        a = POW_MULL(a, POW_FIX(4.0 / 3.0) - i * POW_FIX(1.0)) / (i + 1);
+        dev_4_3_coefs[i] = a;
+    }
+}
+
+/* return the mantissa and the binary exponent */
+static int int_pow(int i, int *exp_ptr)
+{
+    int e, er, eq, j;
+    int a, a1;
+    
+    /* renormalize */
+    a = i;
+    e = POW_FRAC_BITS;
+    while (a < (1 << (POW_FRAC_BITS - 1))) {
+        a = a << 1;
+        e--;
+    }
+    a -= (1 << POW_FRAC_BITS);
+    a1 = 0;
+    for(j = DEV_ORDER - 1; j >= 0; j--)
+        a1 = POW_MULL(a, dev_4_3_coefs[j] + a1);
+    a = (1 << POW_FRAC_BITS) + a1;
+    /* exponent compute (exact) */
+    e = e * 4;
+    er = e % 3;
+    eq = e / 3;
+    a = POW_MULL(a, pow_mult3[er]);
+    while (a >= 2 * POW_FRAC_ONE) {
+        a = a >> 1;
+        eq++;
+    }
+    /* convert to float */
+    while (a < POW_FRAC_ONE) {
+        a = a << 1;
+        eq--;
+    }
+    /* now POW_FRAC_ONE <= a < 2 * POW_FRAC_ONE */
+#if POW_FRAC_BITS > FRAC_BITS
+    a = (a + (1 << (POW_FRAC_BITS - FRAC_BITS - 1))) >> (POW_FRAC_BITS - FRAC_BITS);
+    /* correct overflow */
+    if (a >= 2 * (1 << FRAC_BITS)) {
+        a = a >> 1;
+        eq++;
+    }
+#endif
+    *exp_ptr = eq;
+    return a;
+}
+
+#endif /* MPA_FLOAT */
+
+/* fills the tables of this instance, called once by mpaudec_init() */
+static void init_tables(void)
+{
+    int i, j;
+
+    /* window */
+    /* max = 18760, max sum over all 16 coefs : 44736 */
+    for(i=0;i<257;i++) {
+#ifdef MPA_FLOAT
+        float v;
+        v = mpa_enwindow[i] / 65536.0f;
+#else
+        int v;
+        v = mpa_enwindow[i];
+#if WFRAC_BITS < 16
+        v = (v + (1 << (16 - WFRAC_BITS - 1))) >> (16 - WFRAC_BITS);
+#endif
+#endif
+        window[i] = v;
+        if ((i & 63) != 0)
+            v = -v;
+        if (i != 0)
+            window[512 - i] = v;
+    }
+
+#ifdef MPA_FLOAT
+    for(i=1;i<TABLE_4_3_SIZE;i++)
+        table_4_3_value[i] = pow(i, 4.0 / 3.0);
+    for(i=0;i<1024;i++)
+        table_4_3_exp[i] = pow(2.0, (i - 512) / 4.0);
+#else
+    /* compute n ^ (4/3) and store it in mantissa/exp format */
+    int_pow_init();
+    for(i=1;i<TABLE_4_3_SIZE;i++) {
+        int e, m;
+        m = int_pow(i, &e);
+        /* normalized to FRAC_BITS */
+        table_4_3_value[i] = m;
+        table_4_3_exp[i] = e;
+    }
+#endif
+    
+    for(i=0;i<7;i++) {
+        float f;
+        INTFLOAT v;
+        if (i != 6) {
+            f = tan((double)i * M_PI / 12.0);
+            v = FIXR(f / (1.0 + f));
+        } else {
+            v = FIXR(1.0);
+        }
+        is_table[0][i] = v;
+        is_table[1][6 - i] = v;
+    }
+    /* invalid values */
+    for(i=7;i<16;i++)
+        is_table[0][i] = is_table[1][i] = 0.0;
+
+    for(i=0;i<16;i++) {
+        double f;
+        int e, k;
+
+        for(j=0;j<2;j++) {
+            e = -(j + 1) * ((i + 1) >> 1);
+            f = pow(2.0, e / 4.0);
+            k = i & 1;
+            is_table_lsf[j][k ^ 1][i] = FIXR(f);
+            is_table_lsf[j][k][i] = FIXR(1.0);
+        }
+    }
+
+    for(i=0;i<8;i++) {
+        float ci, cs, ca;
+        ci = ci_table[i];
+        cs = 1.0 / sqrt(1.0 + ci * ci);
+        ca = cs * ci;
+        csa_table[i][0] = FIX(cs);
+        csa_table[i][1] = FIX(ca);
+    }
+
+    /* compute mdct windows */
+    for(i=0;i<36;i++) {
+        INTFLOAT v;
+        v = FIXR(sin(M_PI * (i + 0.5) / 36.0));
+        mdct_win[0][i] = v;
+        mdct_win[1][i] = v;
+        mdct_win[3][i] = v;
+    }
+    for(i=0;i<6;i++) {
+        mdct_win[1][18 + i] = FIXR(1.0);
+        mdct_win[1][24 + i] = FIXR(sin(M_PI * ((i + 6) + 0.5) / 12.0));
+        mdct_win[1][30 + i] = FIXR(0.0);
+
+        mdct_win[3][i] = FIXR(0.0);
+        mdct_win[3][6 + i] = FIXR(sin(M_PI * (i + 0.5) / 12.0));
+        mdct_win[3][12 + i] = FIXR(1.0);
+    }
+
+    for(i=0;i<12;i++)
+        mdct_win[2][i] = FIXR(sin(M_PI * (i + 0.5) / 12.0));
+    
+    /* NOTE: we do frequency inversion adter the MDCT by changing
+       the sign of the right window coefs */
+    for(j=0;j<4;j++) {
+        for(i=0;i<36;i+=2) {
+            mdct_win[j + 4][i] = mdct_win[j][i];
+            mdct_win[j + 4][i + 1] = -mdct_win[j][i + 1];
+        }
+    }
+#ifdef USE_X86_SIMD
+    for(j=0;j<4;j++) {
+        for(i=0;i<36;i++) {
+            mdct_win4[j][i][0] = mdct_win4[j][i][2] = mdct_win[j][i];
+            mdct_win4[j][i][1] = mdct_win4[j][i][3] = mdct_win[j + 4][i];
+        }
+    }
+#endif
+}
+
+/* tab[i][j] = 1.0 / (2.0 * cos(pi*(2*k+1) / 2^(6 - j))) */
+
+/* cos(i*pi/64) */
+
+#define COS0_0  FIXR(0.50060299823519630134)
+#define COS0_1  FIXR(0.50547095989754365998)
+#define COS0_2  FIXR(0.51544730992262454697)
+#define COS0_3  FIXR(0.53104259108978417447)
+#define COS0_4  FIXR(0.55310389603444452782)
+#define COS0_5  FIXR(0.58293496820613387367)
+#define COS0_6  FIXR(0.62250412303566481615)
+#define COS0_7  FIXR(0.67480834145500574602)
+#define COS0_8  FIXR(0.74453627100229844977)
+#define COS0_9  FIXR(0.83934964541552703873)
+#define COS0_10 FIXR(0.97256823786196069369)
+#define COS0_11 FIXR(1.16943993343288495515)
+#define COS0_12 FIXR(1.48416461631416627724)
+#define COS0_13 FIXR(2.05778100995341155085)
+#define COS0_14 FIXR(3.40760841846871878570)
+#define COS0_15 FIXR(10.19000812354805681150)
+
+#define COS1_0 FIXR(0.50241928618815570551)
+#define COS1_1 FIXR(0.52249861493968888062)
+#define COS1_2 FIXR(0.56694403481635770368)
+#define COS1_3 FIXR(0.64682178335999012954)
+#define COS1_4 FIXR(0.78815462345125022473)
+#define COS1_5 FIXR(1.06067768599034747134)
+#define COS1_6 FIXR(1.72244709823833392782)
+#define COS1_7 FIXR(5.10114861868916385802)
+
+#define COS2_0 FIXR(0.50979557910415916894)
+#define COS2_1 FIXR(0.60134488693504528054)
+#define COS2_2 FIXR(0.89997622313641570463)
+#define COS2_3 FIXR(2.56291544774150617881)
+
+#define COS3_0 FIXR(0.54119610014619698439)
+#define COS3_1 FIXR(1.30656296487637652785)
+
+#define COS4_0 FIXR(0.70710678118654752439)
+
+/* butterfly operator */
+#define BF(a, b, c)\
+{\
+    tmp0 = tab[a] + tab[b];\
+    tmp1 = tab[a] - tab[b];\
+    tab[a] = tmp0;\
+    tab[b] = MULL(tmp1, c);\
+}
+
+#define BF1(a, b, c, d)\
+{\
+    BF(a, b, COS4_0);\
+    BF(c, d, -COS4_0);\
+    tab[c] += tab[d];\
+}
+
+#define BF2(a, b, c, d)\
+{\
+    BF(a, b, COS4_0);\
+    BF(c, d, -COS4_0);\
+    tab[c] += tab[d];\
+    tab[a] += tab[c];\
+    tab[c] += tab[b];\
+    tab[b] += tab[d];\
+}
+
+#define ADD(a, b) tab[a] += tab[b]
+
+/* last two DCT32 passes and output reordering */
+static void dct32_final(INTFLOAT *out, INTFLOAT *tab)
+{
+    INTFLOAT tmp0, tmp1;
+
+    /* pass 5 */
+    BF1(0, 1, 2, 3);
+    BF2(4, 5, 6, 7);
+    BF1(8, 9, 10, 11);
+    BF2(12, 13, 14, 15);
+    BF1(16, 17, 18, 19);
+    BF2(20, 21, 22, 23);
+    BF1(24, 25, 26, 27);
+    BF2(28, 29, 30, 31);
+    
+    /* pass 6 */
+    
+    ADD( 8, 12);
+    ADD(12, 10);
+    ADD(10, 14);
+    ADD(14,  9);
+    ADD( 9, 13);
+    ADD(13, 11);
+    ADD(11, 15);
+
+    out[ 0] = tab[0];
+    out[16] = tab[1];
+    out[ 8] = tab[2];
+    out[24] = tab[3];
+    out[ 4] = tab[4];
+    out[20] = tab[5];
+    out[12] = tab[6];
+    out[28] = tab[7];
+    out[ 2] = tab[8];
+    out[18] = tab[9];
+    out[10] = tab[10];
+    out[26] = tab[11];
+    out[ 6] = tab[12];
+    out[22] = tab[13];
+    out[14] = tab[14];
+    out[30] = tab[15];
+    
+    ADD(24, 28);
+    ADD(28, 26);
+    ADD(26, 30);
+    ADD(30, 25);
+    ADD(25, 29);
+    ADD(29, 27);
+    ADD(27, 31);
+
+    out[ 1] = tab[16] + tab[24];
+    out[17] = tab[17] + tab[25];
+    out[ 9] = tab[18] + tab[26];
+    out[25] = tab[19] + tab[27];
+    out[ 5] = tab[20] + tab[28];
+    out[21] = tab[21] + tab[29];
+    out[13] = tab[22] + tab[30];
+    out[29] = tab[23] + tab[31];
+    out[ 3] = tab[24] + tab[20];
+    out[19] = tab[25] + tab[21];
+    out[11] = tab[26] + tab[22];
+    out[27] = tab[27] + tab[23];
+    out[ 7] = tab[28] + tab[18];
+    out[23] = tab[29] + tab[19];
+    out[15] = tab[30] + tab[17];
+    out[31] = tab[31];
+}
+
+/* DCT32 without 1/sqrt(2) coef zero scaling. */
+static void dct32(INTFLOAT *out, INTFLOAT *tab)
+{
+    INTFLOAT tmp0, tmp1;
+
+    /* pass 1 */
+    BF(0, 31, COS0_0);
+    BF(1, 30, COS0_1);
+    BF(2, 29, COS0_2);
+    BF(3, 28, COS0_3);
+    BF(4, 27, COS0_4);
+    BF(5, 26, COS0_5);
+    BF(6, 25, COS0_6);
+    BF(7, 24, COS0_7);
+    BF(8, 23, COS0_8);
+    BF(9, 22, COS0_9);
+    BF(10, 21, COS0_10);
+    BF(11, 20, COS0_11);
+    BF(12, 19, COS0_12);
+    BF(13, 18, COS0_13);
+    BF(14, 17, COS0_14);
+    BF(15, 16, COS0_15);
+
+    /* pass 2 */
+    BF(0, 15, COS1_0);
+    BF(1, 14, COS1_1);
+    BF(2, 13, COS1_2);
+    BF(3, 12, COS1_3);
+    BF(4, 11, COS1_4);
+    BF(5, 10, COS1_5);
+    BF(6,  9, COS1_6);
+    BF(7,  8, COS1_7);
+    
+    BF(16, 31, -COS1_0);
+    BF(17, 30, -COS1_1);
+    BF(18, 29, -COS1_2);
+    BF(19, 28, -COS1_3);
+    BF(20, 27, -COS1_4);
+    BF(21, 26, -COS1_5);
+    BF(22, 25, -COS1_6);
+    BF(23, 24, -COS1_7);
+    
+    /* pass 3 */
+    BF(0, 7, COS2_0);
+    BF(1, 6, COS2_1);
+    BF(2, 5, COS2_2);
+    BF(3, 4, COS2_3);
+    
+    BF(8, 15, -COS2_0);
+    BF(9, 14, -COS2_1);
+    BF(10, 13, -COS2_2);
+    BF(11, 12, -COS2_3);
+    
+    BF(16, 23, COS2_0);
+    BF(17, 22, COS2_1);
+    BF(18, 21, COS2_2);
+    BF(19, 20, COS2_3);
+    
+    BF(24, 31, -COS2_0);
+    BF(25, 30, -COS2_1);
+    BF(26, 29, -COS2_2);
+    BF(27, 28, -COS2_3);
+
+    /* pass 4 */
+    BF(0, 3, COS3_0);
+    BF(1, 2, COS3_1);
+    
+    BF(4, 7, -COS3_0);
+    BF(5, 6, -COS3_1);
+    
+    BF(8, 11, COS3_0);
+    BF(9, 10, COS3_1);
+    
+    BF(12, 15, -COS3_0);
+    BF(13, 14, -COS3_1);
+    
+    BF(16, 19, COS3_0);
+    BF(17, 18, COS3_1);
+    
+    BF(20, 23, -COS3_0);
+    BF(21, 22, -COS3_1);
+    
+    BF(24, 27, COS3_0);
+    BF(25, 26, COS3_1);
+    
+    BF(28, 31, -COS3_0);
+    BF(29, 30, -COS3_1);
+    
+    dct32_final(out, tab);
+}
+
+#if defined(MPA_FLOAT)
+
+static int round_sample(float sum)
+{
+    int sum1;
+    sum *= 32768.0f;
+    if (sum <= -32768.0f)
+        return -32768;
+    if (sum >= 32767.0f)
+        return 32767;
+    sum1 = (int)(sum + (sum < 0 ? -0.5f : 0.5f));
+    return sum1;
+}
+
+#define MULS(ra, rb) ((ra) * (rb))
+
+#elif FRAC_BITS <= 15
+
+#define OUT_SHIFT (WFRAC_BITS + FRAC_BITS - 15)
+
+static int round_sample(int sum)
+{
+    int sum1;
+    sum1 = (sum + (1 << (OUT_SHIFT - 1))) >> OUT_SHIFT;
+    if (sum1 < -32768)
+        sum1 = -32768;
+    else if (sum1 > 32767)
+        sum1 = 32767;
+    return sum1;
+}
+
+/* signed 16x16 -> 32 multiply add accumulate */
+#define MACS(rt, ra, rb) rt += (ra) * (rb)
+
+/* signed 16x16 -> 32 multiply */
+#define MULS(ra, rb) ((ra) * (rb))
+
+#else
+
+#define OUT_SHIFT (WFRAC_BITS + FRAC_BITS - 15)
+
+static int round_sample(int64_t sum) 
+{
+    int sum1;
+    sum1 = (int)((sum + ((int64_t)(1) << (OUT_SHIFT - 1))) >> OUT_SHIFT);
+    if (sum1 < -32768)
+        sum1 = -32768;
+    else if (sum1 > 32767)
+        sum1 = 32767;
+    return sum1;
+}
+
+#define MULS(ra, rb) MUL64(ra, rb)
+
+#endif
+
+#define SUM8(sum, op, w, p) \
+{                                               \
+    sum op MULS((w)[0 * 64], p[0 * 64]);\
+    sum op MULS((w)[1 * 64], p[1 * 64]);\
+    sum op MULS((w)[2 * 64], p[2 * 64]);\
+    sum op MULS((w)[3 * 64], p[3 * 64]);\
+    sum op MULS((w)[4 * 64], p[4 * 64]);\
+    sum op MULS((w)[5 * 64], p[5 * 64]);\
+    sum op MULS((w)[6 * 64], p[6 * 64]);\
+    sum op MULS((w)[7 * 64], p[7 * 64]);\
+}
+
+#define SUM8P2(sum1, op1, sum2, op2, w1, w2, p) \
+{                                               \
+    MPA_INT tmp;\
+    tmp = p[0 * 64];\
+    sum1 op1 MULS((w1)[0 * 64], tmp);\
+    sum2 op2 MULS((w2)[0 * 64], tmp);\
+    tmp = p[1 * 64];\
+    sum1 op1 MULS((w1)[1 * 64], tmp);\
+    sum2 op2 MULS((w2)[1 * 64], tmp);\
+    tmp = p[2 * 64];\
+    sum1 op1 MULS((w1)[2 * 64], tmp);\
+    sum2 op2 MULS((w2)[2 * 64], tmp);\
+    tmp = p[3 * 64];\
+    sum1 op1 MULS((w1)[3 * 64], tmp);\
+    sum2 op2 MULS((w2)[3 * 64], tmp);\
+    tmp = p[4 * 64];\
+    sum1 op1 MULS((w1)[4 * 64], tmp);\
+    sum2 op2 MULS((w2)[4 * 64], tmp);\
+    tmp = p[5 * 64];\
+    sum1 op1 MULS((w1)[5 * 64], tmp);\
+    sum2 op2 MULS((w2)[5 * 64], tmp);\
+    tmp = p[6 * 64];\
+    sum1 op1 MULS((w1)[6 * 64], tmp);\
+    sum2 op2 MULS((w2)[6 * 64], tmp);\
+    tmp = p[7 * 64];\
+    sum1 op1 MULS((w1)[7 * 64], tmp);\
+    sum2 op2 MULS((w2)[7 * 64], tmp);\
+}
+
+
+/* 32 sub band synthesis filter. Input: 32 sub band samples, Output:
+   32 samples. */
+/* XXX: optimize by avoiding ring buffer usage */
+static void synth_filter(MPADecodeContext *s1,
+                         int ch, int16_t *samples, int incr, 
+                         INTFLOAT sb_samples[SBLIMIT])
+{
+    INTFLOAT tmp[32];
+    MPA_INT *synth_buf;
+    const MPA_INT *w, *w2, *p;
+    int j, offset;
+    INTFLOAT v;
+    int16_t *samples2;
+#if defined(MPA_FLOAT)
+    float sum, sum2;
+#elif FRAC_BITS <= 15
+    int32_t sum, sum2;
+#else
+    int64_t sum, sum2;
+#endif
+    
+#ifdef USE_X86_SIMD
+    dct32_func(tmp, sb_samples);
+#else
+    dct32(tmp, sb_samples);
+#endif
+    
+    offset = s1->synth_buf_offset[ch];
+    synth_buf = s1->synth_buf.MPA_PREC[ch] + offset;
+
+    for(j=0;j<32;j++) {
+        v = tmp[j];
+#if !defined(MPA_FLOAT) && FRAC_BITS <= 15
+        /* NOTE: can cause a loss in precision if very high amplitude
+           sound */
+        if (v > 32767)
+            v = 32767;
+        else if (v < -32768)
+            v = -32768;
+#endif
+        synth_buf[j] = v;
+    }
+    /* copy to avoid wrap */
+    memcpy(synth_buf + 512, synth_buf, 32 * sizeof(MPA_INT));
+
+#ifdef USE_X86_SIMD
+    if (synth_window_func) {
+        int64_t sums[32];
+        synth_window_func(synth_buf, sums);
+        sum = 0;
+        p = synth_buf + 32;
+        SUM8(sum, -=, window + 48, p);
+        sums[16] = sum;
+        for(j=0;j<32;j++) {
+            *samples = round_sample(sums[j]);
+            samples += incr;
+        }
+        offset = (offset - 32) & 511;
+        s1->synth_buf_offset[ch] = offset;
+        return;
+    }
+#endif
+
+    samples2 = samples + 31 * incr;
+    w = window;
+    w2 = window + 31;
+
+    sum = 0;
+    p = synth_buf + 16;
+    SUM8(sum, +=, w, p);
+    p = synth_buf + 48;
+    SUM8(sum, -=, w + 32, p);
+    *samples = round_sample(sum);
+    samples += incr;
+    w++;
+
+    /* we calculate two samples at the same time to avoid one memory
+       access per two sample */
+    for(j=1;j<16;j++) {
+        sum = 0;
+        sum2 = 0;
+        p = synth_buf + 16 + j;
+        SUM8P2(sum, +=, sum2, -=, w, w2, p);
+        p = synth_buf + 48 - j;
+        SUM8P2(sum, -=, sum2, -=, w + 32, w2 + 32, p);
+
+        *samples = round_sample(sum);
+        samples += incr;
+        *samples2 = round_sample(sum2);
+        samples2 -= incr;
+        w++;
+        w2--;
+    }
+    
+    p = synth_buf + 32;
+    sum = 0;
+    SUM8(sum, -=, w + 32, p);
+    *samples = round_sample(sum);
+
+    offset = (offset - 32) & 511;
+    s1->synth_buf_offset[ch] = offset;
+}
+
+#ifdef USE_X86_SIMD
+
+/* The SIMD code does the same integer operations as the scalar code, only
+   in a different order. Additions of the 64 bit products wrap the same way
+   in any order, so the output is bit exact. */
+
+static const int32_t dct32_cos0[16] = {
+    COS0_0, COS0_1, COS0_2, COS0_3, COS0_4, COS0_5, COS0_6, COS0_7,
+    COS0_8, COS0_9, COS0_10, COS0_11, COS0_12, COS0_13, COS0_14, COS0_15,
+};
+static const int32_t dct32_cos1[2][8] = {
+    { COS1_0, COS1_1, COS1_2, COS1_3, COS1_4, COS1_5, COS1_6, COS1_7 },
+    { -COS1_0, -COS1_1, -COS1_2, -COS1_3, -COS1_4, -COS1_5, -COS1_6, -COS1_7 },
+};
+static const int32_t dct32_cos2[2][4] = {
+    { COS2_0, COS2_1, COS2_2, COS2_3 },
+    { -COS2_0, -COS2_1, -COS2_2, -COS2_3 },
+};
+static const int32_t dct32_cos3[4] = { COS3_0, COS3_1, -COS3_0, -COS3_1 };
+
+#define REVERSE4 _MM_SHUFFLE(0, 1, 2, 3)
+
+/* MULL() on 4 lanes */
+__attribute__((target("sse4.1")))
+static __m128i mull_sse41(__m128i a, __m128i b)
+{
+    __m128i even, odd;
+    even = _mm_mul_epi32(a, b);
+    odd = _mm_mul_epi32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    /* the low 32 bits of the shifted product are the same for a logical
+       and an arithmetic shift */
+    even = _mm_srli_epi64(even, FRAC_BITS);
+    odd = _mm_slli_epi64(_mm_srli_epi64(odd, FRAC_BITS), 32);
+    return _mm_blend_epi16(even, odd, 0xcc);
+}
+
+/* 64 bit intermediate values of 4 lanes, the products of the even and the
+   odd lanes are kept in separate registers */
+typedef struct V64 {
+    __m128i even, odd;
+} V64;
+
+/* MUL64() on 4 lanes */
+__attribute__((target("sse4.1")))
+static V64 v64_mul(__m128i a, __m128i b)
+{
+    V64 r;
+    r.even = _mm_mul_epi32(a, b);
+    r.odd = _mm_mul_epi32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return r;
+}
+
+__attribute__((target("sse4.1")))
+static V64 v64_add(V64 a, V64 b)
+{
+    a.even = _mm_add_epi64(a.even, b.even);
+    a.odd = _mm_add_epi64(a.odd, b.odd);
+    return a;
+}
+
+__attribute__((target("sse4.1")))
+static V64 v64_sub(V64 a, V64 b)
+{
+    a.even = _mm_sub_epi64(a.even, b.even);
+    a.odd = _mm_sub_epi64(a.odd, b.odd);
+    return a;
+}
+
+/* FRAC_RND() on 4 lanes */
+__attribute__((target("sse4.1")))
+static __m128i v64_rnd(V64 a)
+{
+    const __m128i half = _mm_set1_epi64x(FRAC_ONE / 2);
+    a.even = _mm_srli_epi64(_mm_add_epi64(a.even, half), FRAC_BITS);
+    a.odd = _mm_srli_epi64(_mm_add_epi64(a.odd, half), FRAC_BITS);
+    return _mm_blend_epi16(a.even, _mm_slli_epi64(a.odd, 32), 0xcc);
+}
+
+#define MUL64C(a, c) v64_mul(a, _mm_set1_epi32(c))
+#define NEG(a) _mm_sub_epi32(_mm_setzero_si128(), a)
+
+/* BF(i, n - 1 - i, cos[i]) for i < n / 2 on the n values at tab, n >= 8 */
+__attribute__((target("sse4.1")))
+static void bf_group_sse41(int32_t *tab, int n, const int32_t *cos)
+{
+    int i;
+    __m128i a, b;
+    for(i=0;i<n/2;i+=4) {
+        a = _mm_loadu_si128((__m128i *)(tab + i));
+        b = _mm_loadu_si128((__m128i *)(tab + n - 4 - i));
+        b = _mm_shuffle_epi32(b, REVERSE4);
+        _mm_storeu_si128((__m128i *)(tab + i), _mm_add_epi32(a, b));
+        b = mull_sse41(_mm_sub_epi32(a, b),
+                       _mm_loadu_si128((const __m128i *)(cos + i)));
+        _mm_storeu_si128((__m128i *)(tab + n - 4 - i),
+                         _mm_shuffle_epi32(b, REVERSE4));
+    }
+}
+
+__attribute__((target("sse4.1")))
+static void dct32_sse41(int32_t *out, int32_t *tab)
+{
+    int i;
+    __m128i v, u, a, b, cos3;
+
+    /* pass 1 to 3 */
+    bf_group_sse41(tab, 32, dct32_cos0);
+    bf_group_sse41(tab, 16, dct32_cos1[0]);
+    bf_group_sse41(tab + 16, 16, dct32_cos1[1]);
+    for(i=0;i<32;i+=16) {
+        bf_group_sse41(tab + i, 8, dct32_cos2[0]);
+        bf_group_sse41(tab + i + 8, 8, dct32_cos2[1]);
+    }
+
+    /* pass 4, two groups of 4 at a time */
+    cos3 = _mm_loadu_si128((const __m128i *)dct32_cos3);
+    for(i=0;i<32;i+=8) {
+        v = _mm_loadu_si128((__m128i *)(tab + i));
+        u = _mm_loadu_si128((__m128i *)(tab + i + 4));
+        a = _mm_unpacklo_epi64(v, u);
+        b = _mm_unpacklo_epi64(_mm_shuffle_epi32(v, REVERSE4),
+                               _mm_shuffle_epi32(u, REVERSE4));
+        v = _mm_add_epi32(a, b);
+        u = mull_sse41(_mm_sub_epi32(a, b), cos3);
+        u = _mm_shuffle_epi32(u, _MM_SHUFFLE(2, 3, 0, 1));
+        _mm_storeu_si128((__m128i *)(tab + i), _mm_unpacklo_epi64(v, u));
+        _mm_storeu_si128((__m128i *)(tab + i + 4), _mm_unpackhi_epi64(v, u));
+    }
+
+    dct32_final(out, tab);
+}
+
+/* Windowing of the synthesis filter, computes the 32 sums before
+   rounding. Output i < 16 is the sum over the 8 taps of
+   window[i] * p[16 + i] - window[32 + i] * p[48 - i], output i > 16 is
+   -window[i] * p[48 - i] - window[32 + i] * p[16 + i]. Output 16 is not
+   computed here. */
+__attribute__((target("sse4.1")))
+static void synth_window_sse41(const MPA_INT *synth_buf, int64_t *sums)
+{
+    int i, k;
+    int64_t even[2], odd[2];
+    __m128i s1e, s1o, s2e, s2o, w1, w2, p1, p2;
+
+    for(i=0;i<32;i+=4) {
+        const MPA_INT *w = window + i;
+        const MPA_INT *q1 = i < 16 ? synth_buf + 16 + i : synth_buf + 45 - i;
+        const MPA_INT *q2 = i < 16 ? synth_buf + 45 - i : synth_buf + 16 + i;
+        s1e = s1o = s2e = s2o = _mm_setzero_si128();
+        for(k=0;k<8;k++) {
+            w1 = _mm_loadu_si128((const __m128i *)(w + k * 64));
+            w2 = _mm_loadu_si128((const __m128i *)(w + 32 + k * 64));
+            p1 = _mm_loadu_si128((const __m128i *)(q1 + k * 64));
+            p2 = _mm_loadu_si128((const __m128i *)(q2 + k * 64));
+            if (i < 16)
+                p2 = _mm_shuffle_epi32(p2, REVERSE4);
+            else
+                p1 = _mm_shuffle_epi32(p1, REVERSE4);
+            s1e = _mm_add_epi64(s1e, _mm_mul_epi32(w1, p1));
+            s1o = _mm_add_epi64(s1o, _mm_mul_epi32(_mm_srli_epi64(w1, 32),
+                                                   _mm_srli_epi64(p1, 32)));
+            s2e = _mm_add_epi64(s2e, _mm_mul_epi32(w2, p2));
+            s2o = _mm_add_epi64(s2o, _mm_mul_epi32(_mm_srli_epi64(w2, 32),
+                                                   _mm_srli_epi64(p2, 32)));
+        }
+        if (i >= 16) {
+            s1e = _mm_sub_epi64(_mm_setzero_si128(), s1e);
+            s1o = _mm_sub_epi64(_mm_setzero_si128(), s1o);
+        }
+        _mm_storeu_si128((__m128i *)even, _mm_sub_epi64(s1e, s2e));
+        _mm_storeu_si128((__m128i *)odd, _mm_sub_epi64(s1o, s2o));
+        sums[i] = even[0];
+        sums[i + 1] = odd[0];
+        sums[i + 2] = even[1];
+        sums[i + 3] = odd[1];
+    }
+}
+
+/* same as synth_window_sse41(), 8 outputs at a time */
+__attribute__((target("avx2")))
+static void synth_window_avx2(const MPA_INT *synth_buf, int64_t *sums)
+{
+    int i, k;
+    int64_t even[4], odd[4];
+    __m256i s1e, s1o, s2e, s2o, w1, w2, p1, p2;
+    const __m256i reverse = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+
+    for(i=0;i<32;i+=8) {
+        const MPA_INT *w = window + i;
+        const MPA_INT *q1 = i < 16 ? synth_buf + 16 + i : synth_buf + 41 - i;
+        const MPA_INT *q2 = i < 16 ? synth_buf + 41 - i : synth_buf + 16 + i;
+        s1e = s1o = s2e = s2o = _mm256_setzero_si256();
+        for(k=0;k<8;k++) {
+            w1 = _mm256_loadu_si256((const __m256i *)(w + k * 64));
+            w2 = _mm256_loadu_si256((const __m256i *)(w + 32 + k * 64));
+            p1 = _mm256_loadu_si256((const __m256i *)(q1 + k * 64));
+            p2 = _mm256_loadu_si256((const __m256i *)(q2 + k * 64));
+            if (i < 16)
+                p2 = _mm256_permutevar8x32_epi32(p2, reverse);
+            else
+                p1 = _mm256_permutevar8x32_epi32(p1, reverse);
+            s1e = _mm256_add_epi64(s1e, _mm256_mul_epi32(w1, p1));
+            s1o = _mm256_add_epi64(s1o, _mm256_mul_epi32(_mm256_srli_epi64(w1, 32),
+                                                         _mm256_srli_epi64(p1, 32)));
+            s2e = _mm256_add_epi64(s2e, _mm256_mul_epi32(w2, p2));
+            s2o = _mm256_add_epi64(s2o, _mm256_mul_epi32(_mm256_srli_epi64(w2, 32),
+                                                         _mm256_srli_epi64(p2, 32)));
+        }
+        if (i >= 16) {
+            s1e = _mm256_sub_epi64(_mm256_setzero_si256(), s1e);
+            s1o = _mm256_sub_epi64(_mm256_setzero_si256(), s1o);
+        }
+        _mm256_storeu_si256((__m256i *)even, _mm256_sub_epi64(s1e, s2e));
+        _mm256_storeu_si256((__m256i *)odd, _mm256_sub_epi64(s1o, s2o));
+        for(k=0;k<4;k++) {
+            sums[i + 2 * k] = even[k];
+            sums[i + 2 * k + 1] = odd[k];
+        }
+    }
+}
+
+#endif /* USE_X86_SIMD */
+
+/* cos(pi*i/24) */
+#define C1  FIXR(0.99144486137381041114)
+#define C3  FIXR(0.92387953251128675612)
+#define C5  FIXR(0.79335334029123516458)
+#define C7  FIXR(0.60876142900872063941)
+#define C9  FIXR(0.38268343236508977173)
+#define C11 FIXR(0.13052619222005159154)
+
+/* 12 points IMDCT. We compute it "by hand" by factorizing obvious
+   cases. */
+static void imdct12(INTFLOAT *out, INTFLOAT *in)
+{
+    INTFLOAT tmp;
+    MPA_ACC in1_3, in1_9, in4_3, in4_9;
+
+    in1_3 = MUL64(in[1], C3);
+    in1_9 = MUL64(in[1], C9);
+    in4_3 = MUL64(in[4], C3);
+    in4_9 = MUL64(in[4], C9);
+    
+    tmp = FRAC_RND(MUL64(in[0], C7) - in1_3 - MUL64(in[2], C11) + 
+                   MUL64(in[3], C1) - in4_9 - MUL64(in[5], C5));
+    out[0] = tmp;
+    out[5] = -tmp;
+    tmp = FRAC_RND(MUL64(in[0] - in[3], C9) - in1_3 + 
+                   MUL64(in[2] + in[5], C3) - in4_9);
+    out[1] = tmp;
+    out[4] = -tmp;
+    tmp = FRAC_RND(MUL64(in[0], C11) - in1_9 + MUL64(in[2], C7) -
+                   MUL64(in[3], C5) + in4_3 - MUL64(in[5], C1));
+    out[2] = tmp;
+    out[3] = -tmp;
+    tmp = FRAC_RND(MUL64(-in[0], C5) + in1_9 + MUL64(in[2], C1) + 
+                   MUL64(in[3], C11) - in4_3 - MUL64(in[5], C7));
+    out[6] = tmp;
+    out[11] = tmp;
+    tmp = FRAC_RND(MUL64(-in[0] + in[3], C3) - in1_9 + 
+                   MUL64(in[2] + in[5], C9) + in4_3);
+    out[7] = tmp;
+    out[10] = tmp;
+    tmp = FRAC_RND(-MUL64(in[0], C1) - in1_3 - MUL64(in[2], C5) -
+                   MUL64(in[3], C7) - in4_9 - MUL64(in[5], C11));
+    out[8] = tmp;
+    out[9] = tmp;
+}
+
+#ifdef USE_X86_SIMD
+/* imdct12() on 4 subbands, one per lane */
+__attribute__((target("sse4.1")))
+static void imdct12_sse41(__m128i *out, const __m128i *in)
+{
+    __m128i tmp;
+    V64 in1_3, in1_9, in4_3, in4_9, zero;
+
+    in1_3 = MUL64C(in[1], C3);
+    in1_9 = MUL64C(in[1], C9);
+    in4_3 = MUL64C(in[4], C3);
+    in4_9 = MUL64C(in[4], C9);
+    zero.even = zero.odd = _mm_setzero_si128();
+
+    tmp = v64_rnd(v64_sub(v64_sub(v64_add(v64_sub(v64_sub(
+              MUL64C(in[0], C7), in1_3), MUL64C(in[2], C11)),
+              MUL64C(in[3], C1)), in4_9), MUL64C(in[5], C5)));
+    out[0] = tmp;
+    out[5] = NEG(tmp);
+    tmp = v64_rnd(v64_sub(v64_add(v64_sub(
+              MUL64C(_mm_sub_epi32(in[0], in[3]), C9), in1_3),
+              MUL64C(_mm_add_epi32(in[2], in[5]), C3)), in4_9));
+    out[1] = tmp;
+    out[4] = NEG(tmp);
+    tmp = v64_rnd(v64_sub(v64_add(v64_sub(v64_add(v64_sub(
+              MUL64C(in[0], C11), in1_9), MUL64C(in[2], C7)),
+              MUL64C(in[3], C5)), in4_3), MUL64C(in[5], C1)));
+    out[2] = tmp;
+    out[3] = NEG(tmp);
+    tmp = v64_rnd(v64_sub(v64_sub(v64_add(v64_add(v64_add(
+              MUL64C(NEG(in[0]), C5), in1_9), MUL64C(in[2], C1)),
+              MUL64C(in[3], C11)), in4_3), MUL64C(in[5], C7)));
+    out[6] = tmp;
+    out[11] = tmp;
+    tmp = v64_rnd(v64_add(v64_add(v64_sub(
+              MUL64C(_mm_add_epi32(NEG(in[0]), in[3]), C3), in1_9),
+              MUL64C(_mm_add_epi32(in[2], in[5]), C9)), in4_3));
+    out[7] = tmp;
+    out[10] = tmp;
+    tmp = v64_rnd(v64_sub(v64_sub(v64_sub(v64_sub(v64_sub(v64_sub(
+              zero, MUL64C(in[0], C1)), in1_3), MUL64C(in[2], C5)),
+              MUL64C(in[3], C7)), in4_9), MUL64C(in[5], C11)));
+    out[8] = tmp;
+    out[9] = tmp;
+}
+#endif
+
+#undef C1
+#undef C3
+#undef C5
+#undef C7
+#undef C9
+#undef C11
+
+/* cos(pi*i/18) */
+#define C1 FIXR(0.98480775301220805936)
+#define C2 FIXR(0.93969262078590838405)
+#define C3 FIXR(0.86602540378443864676)
+#define C4 FIXR(0.76604444311897803520)
+#define C5 FIXR(0.64278760968653932632)
+#define C6 FIXR(0.5)
+#define C7 FIXR(0.34202014332566873304)
+#define C8 FIXR(0.17364817766693034885)
+
+/* 0.5 / cos(pi*(2*i+1)/36) */
+static const INTFLOAT icos36[9] = {
+    FIXR(0.50190991877167369479),
+    FIXR(0.51763809020504152469),
+    FIXR(0.55168895948124587824),
+    FIXR(0.61038729438072803416),
+    FIXR(0.70710678118654752439),
+    FIXR(0.87172339781054900991),
+    FIXR(1.18310079157624925896),
+    FIXR(1.93185165257813657349),
+    FIXR(5.73685662283492756461),
+};
+
+static const INTFLOAT icos72[18] = {
+    /* 0.5 / cos(pi*(2*i+19)/72) */
+    FIXR(0.74009361646113053152),
+    FIXR(0.82133981585229078570),
+    FIXR(0.93057949835178895673),
+    FIXR(1.08284028510010010928),
+    FIXR(1.30656296487637652785),
+    FIXR(1.66275476171152078719),
+    FIXR(2.31011315767264929558),
+    FIXR(3.83064878777019433457),
+    FIXR(11.46279281302667383546),
+
+    /* 0.5 / cos(pi*(2*(i + 18) +19)/72) */
+    FIXR(-0.67817085245462840086),
+    FIXR(-0.63023620700513223342),
+    FIXR(-0.59284452371708034528),
+    FIXR(-0.56369097343317117734),
+    FIXR(-0.54119610014619698439),
+    FIXR(-0.52426456257040533932),
+    FIXR(-0.51213975715725461845),
+    FIXR(-0.50431448029007636036),
+    FIXR(-0.50047634258165998492),
+};
+
+/* using Lee like decomposition followed by hand coded 9 points DCT */
+static void imdct36(INTFLOAT *out, INTFLOAT *in)
+{
+    int i, j;
+    INTFLOAT t0, t1, t2, t3, s0, s1, s2, s3;
+    INTFLOAT tmp[18], *tmp1, *in1;
+    MPA_ACC in3_3, in6_6;
+
+    for(i=17;i>=1;i--)
+        in[i] += in[i-1];
+    for(i=17;i>=3;i-=2)
+        in[i] += in[i-2];
+
+    for(j=0;j<2;j++) {
+        tmp1 = tmp + j;
+        in1 = in + j;
+
+        in3_3 = MUL64(in1[2*3], C3);
+        in6_6 = MUL64(in1[2*6], C6);
+
+        tmp1[0] = FRAC_RND(MUL64(in1[2*1], C1) + in3_3 + 
+                           MUL64(in1[2*5], C5) + MUL64(in1[2*7], C7));
+        tmp1[2] = in1[2*0] + FRAC_RND(MUL64(in1[2*2], C2) + 
+                                      MUL64(in1[2*4], C4) + in6_6 + 
+                                      MUL64(in1[2*8], C8));
+        tmp1[4] = FRAC_RND(MUL64(in1[2*1] - in1[2*5] - in1[2*7], C3));
+        tmp1[6] = FRAC_RND(MUL64(in1[2*2] - in1[2*4] - in1[2*8], C6)) - 
+            in1[2*6] + in1[2*0];
+        tmp1[8] = FRAC_RND(MUL64(in1[2*1], C5) - in3_3 - 
+                           MUL64(in1[2*5], C7) + MUL64(in1[2*7], C1));
+        tmp1[10] = in1[2*0] + FRAC_RND(MUL64(-in1[2*2], C8) - 
+                                       MUL64(in1[2*4], C2) + in6_6 + 
+                                       MUL64(in1[2*8], C4));
+        tmp1[12] = FRAC_RND(MUL64(in1[2*1], C7) - in3_3 + 
+                            MUL64(in1[2*5], C1) - 
+                            MUL64(in1[2*7], C5));
+        tmp1[14] = in1[2*0] + FRAC_RND(MUL64(-in1[2*2], C4) + 
+                                       MUL64(in1[2*4], C8) + in6_6 - 
+                                       MUL64(in1[2*8], C2));
+        tmp1[16] = in1[2*0] - in1[2*2] + in1[2*4] - in1[2*6] + in1[2*8];
+    }
+
+    i = 0;
+    for(j=0;j<4;j++) {
+        t0 = tmp[i];
+        t1 = tmp[i + 2];
+        s0 = t1 + t0;
+        s2 = t1 - t0;
+
+        t2 = tmp[i + 1];
+        t3 = tmp[i + 3];
+        s1 = MULL(t3 + t2, icos36[j]);
+        s3 = MULL(t3 - t2, icos36[8 - j]);
+        
+        t0 = MULL(s0 + s1, icos72[9 + 8 - j]);
+        t1 = MULL(s0 - s1, icos72[8 - j]);
+        out[18 + 9 + j] = t0;
+        out[18 + 8 - j] = t0;
+        out[9 + j] = -t1;
+        out[8 - j] = t1;
+        
+        t0 = MULL(s2 + s3, icos72[9+j]);
+        t1 = MULL(s2 - s3, icos72[j]);
+        out[18 + 9 + (8 - j)] = t0;
+        out[18 + j] = t0;
+        out[9 + (8 - j)] = -t1;
+        out[j] = t1;
+        i += 4;
+    }
+
+    s0 = tmp[16];
+    s1 = MULL(tmp[17], icos36[4]);
+    t0 = MULL(s0 + s1, icos72[9 + 4]);
+    t1 = MULL(s0 - s1, icos72[4]);
+    out[18 + 9 + 4] = t0;
+    out[18 + 8 - 4] = t0;
+    out[9 + 4] = -t1;
+    out[8 - 4] = t1;
+}
+
+#ifdef USE_X86_SIMD
+/* imdct36() on 4 subbands, one per lane */
+__attribute__((target("sse4.1")))
+static void imdct36_sse41(__m128i *out, __m128i *in)
+{
+    int i, j;
+    __m128i t0, t1, t2, t3, s0, s1, s2, s3;
+    __m128i tmp[18], *tmp1, *in1;
+    V64 in3_3, in6_6;
+
+    for(i=17;i>=1;i--)
+        in[i] = _mm_add_epi32(in[i], in[i-1]);
+    for(i=17;i>=3;i-=2)
+        in[i] = _mm_add_epi32(in[i], in[i-2]);
+
+    for(j=0;j<2;j++) {
+        tmp1 = tmp + j;
+        in1 = in + j;
+
+        in3_3 = MUL64C(in1[2*3], C3);
+        in6_6 = MUL64C(in1[2*6], C6);
+
+        tmp1[0] = v64_rnd(v64_add(v64_add(v64_add(
+                      MUL64C(in1[2*1], C1), in3_3),
+                      MUL64C(in1[2*5], C5)), MUL64C(in1[2*7], C7)));
+        tmp1[2] = _mm_add_epi32(in1[2*0], v64_rnd(v64_add(v64_add(v64_add(
+                      MUL64C(in1[2*2], C2), MUL64C(in1[2*4], C4)), in6_6),
+                      MUL64C(in1[2*8], C8))));
+        tmp1[4] = v64_rnd(MUL64C(_mm_sub_epi32(_mm_sub_epi32(in1[2*1], in1[2*5]),
+                                               in1[2*7]), C3));
+        tmp1[6] = _mm_add_epi32(_mm_sub_epi32(
+                      v64_rnd(MUL64C(_mm_sub_epi32(_mm_sub_epi32(in1[2*2], in1[2*4]),
+                                                   in1[2*8]), C6)),
+                      in1[2*6]), in1[2*0]);
+        tmp1[8] = v64_rnd(v64_add(v64_sub(v64_sub(
+                      MUL64C(in1[2*1], C5), in3_3),
+                      MUL64C(in1[2*5], C7)), MUL64C(in1[2*7], C1)));
+        tmp1[10] = _mm_add_epi32(in1[2*0], v64_rnd(v64_add(v64_add(v64_sub(
+                       MUL64C(NEG(in1[2*2]), C8), MUL64C(in1[2*4], C2)), in6_6),
+                       MUL64C(in1[2*8], C4))));
+        tmp1[12] = v64_rnd(v64_sub(v64_add(v64_sub(
+                       MUL64C(in1[2*1], C7), in3_3),
+                       MUL64C(in1[2*5], C1)), MUL64C(in1[2*7], C5)));
+        tmp1[14] = _mm_add_epi32(in1[2*0], v64_rnd(v64_sub(v64_add(v64_add(
+                       MUL64C(NEG(in1[2*2]), C4), MUL64C(in1[2*4], C8)), in6_6),
+                       MUL64C(in1[2*8], C2))));
+        tmp1[16] = _mm_add_epi32(_mm_sub_epi32(_mm_add_epi32(_mm_sub_epi32(
+                       in1[2*0], in1[2*2]), in1[2*4]), in1[2*6]), in1[2*8]);
+    }
+
+    i = 0;
+    for(j=0;j<4;j++) {
+        t0 = tmp[i];
+        t1 = tmp[i + 2];
+        s0 = _mm_add_epi32(t1, t0);
+        s2 = _mm_sub_epi32(t1, t0);
+
+        t2 = tmp[i + 1];
+        t3 = tmp[i + 3];
+        s1 = mull_sse41(_mm_add_epi32(t3, t2), _mm_set1_epi32(icos36[j]));
+        s3 = mull_sse41(_mm_sub_epi32(t3, t2), _mm_set1_epi32(icos36[8 - j]));
+
+        t0 = mull_sse41(_mm_add_epi32(s0, s1), _mm_set1_epi32(icos72[9 + 8 - j]));
+        t1 = mull_sse41(_mm_sub_epi32(s0, s1), _mm_set1_epi32(icos72[8 - j]));
+        out[18 + 9 + j] = t0;
+        out[18 + 8 - j] = t0;
+        out[9 + j] = NEG(t1);
+        out[8 - j] = t1;
+
+        t0 = mull_sse41(_mm_add_epi32(s2, s3), _mm_set1_epi32(icos72[9 + j]));
+        t1 = mull_sse41(_mm_sub_epi32(s2, s3), _mm_set1_epi32(icos72[j]));
+        out[18 + 9 + (8 - j)] = t0;
+        out[18 + j] = t0;
+        out[9 + (8 - j)] = NEG(t1);
+        out[j] = t1;
+        i += 4;
+    }
+
+    s0 = tmp[16];
+    s1 = mull_sse41(tmp[17], _mm_set1_epi32(icos36[4]));
+    t0 = mull_sse41(_mm_add_epi32(s0, s1), _mm_set1_epi32(icos72[9 + 4]));
+    t1 = mull_sse41(_mm_sub_epi32(s0, s1), _mm_set1_epi32(icos72[4]));
+    out[18 + 9 + 4] = t0;
+    out[18 + 8 - 4] = t0;
+    out[9 + 4] = NEG(t1);
+    out[8 - 4] = t1;
+}
+#endif
+
+static int huffman_decode(MPADecodeContext *s, GranuleDef *g,
+                          int16_t *exponents, int end_pos)
+{
+    int s_index;
+    int linbits, code, x, y, l, i, j, k, pos, e, pair_limit;
+    INTFLOAT v;
+    GetBitContext last_gb;
+    VLC *vlc;
+    uint8_t *code_table;
+    const uint16_t *pairs;
+
+    /* the last position a whole pair window can be read at */
+    pair_limit = s->gb.size_in_bits - HUFF_PAIR_BITS;
+
+    /* low frequencies (called big values) */
+    s_index = 0;
+    for(i=0;i<3;i++) {
+        j = g->region_size[i];
+        if (j == 0)
+            continue;
+        /* select vlc table */
+        k = g->table_select[i];
+        l = mpa_huff_data[k][0];
+        linbits = mpa_huff_data[k][1];
+        vlc = &huff_vlc[l];
+        code_table = huff_code_table[l];
+        pairs = huff_pair_table[l];
+
+        /* read huffcode and compute each couple */
+        for(;j>0;j--) {
+            pos = get_bits_count(&s->gb);
+            if (pos >= end_pos)
+                break;
+            e = 0;
+            if (code_table) {
+                /* one lookup unless the code is long or the window would
+                   run past the end of the buffer */
+                if (pos <= pair_limit)
+                    e = pairs[show_bits(&s->gb, HUFF_PAIR_BITS)];
+                if (e) {
+                    skip_bits(&s->gb, HUFF_PAIR_LEN(e));
+                    x = HUFF_PAIR_X(e);
+                    y = HUFF_PAIR_Y(e);
+                } else {
+                    code = get_vlc(&s->gb, vlc);
+                    if (code < 0)
+                        return -1;
+                    y = code_table[code];
+                    x = y >> 4;
+                    y = y & 0x0f;
+                }
+            } else {
+                x = 0;
+                y = 0;
+            }
+#ifdef DEBUG
+            printf("region=%d n=%d x=%d y=%d exp=%d\n", 
+                   i, g->region_size[i] - j, x, y, exponents[s_index]);
+#endif
+            if (e & HUFF_PAIR_SIGNS) {
+                /* the sign bits were part of the lookup */
+                v = 0;
+                if (x) {
+                    v = l3_unscale(x, exponents[s_index]);
+                    if (e & HUFF_PAIR_SIGN_X)
+                        v = -v;
+                }
+                g->sb_hybrid.MPA_PREC[s_index++] = v;
+                v = 0;
+                if (y) {
+                    v = l3_unscale(y, exponents[s_index]);
+                    if (e & HUFF_PAIR_SIGN_Y)
+                        v = -v;
+                }
+                g->sb_hybrid.MPA_PREC[s_index++] = v;
+                continue;
+            }
+            if (x) {
+                if (x == 15)
+                    x += get_bitsz(&s->gb, linbits);
+                v = l3_unscale(x, exponents[s_index]);
+                if (get_bits(&s->gb, 1))
+                    v = -v;
+            } else {
+                v = 0;
+            }
+            g->sb_hybrid.MPA_PREC[s_index++] = v;
+            if (y) {
+                if (y == 15)
+                    y += get_bitsz(&s->gb, linbits);
+                v = l3_unscale(y, exponents[s_index]);
+                if (get_bits(&s->gb, 1))
+                    v = -v;
+            } else {
+                v = 0;
+            }
+            g->sb_hybrid.MPA_PREC[s_index++] = v;
+        }
+    }
+            
+    /* high frequencies */
+    vlc = &huff_quad_vlc[g->count1table_select];
+    last_gb.buffer = NULL;
+    while (s_index <= 572) {
+        pos = get_bits_count(&s->gb);
+        if (pos >= end_pos) {
+            if (pos > end_pos && last_gb.buffer != NULL) {
+                /* some encoders generate an incorrect size for this
+                   part. We must go back into the data */
+                s_index -= 4;
+                s->gb = last_gb;
+            }
+            break;
+        }
+        last_gb= s->gb;
+
+        code = get_vlc(&s->gb, vlc);
+#ifdef DEBUG
+        printf("t=%d code=%d\n", g->count1table_select, code);
+#endif
+        if (code < 0)
+            return -1;
+        for(i=0;i<4;i++) {
+            if (code & (8 >> i)) {
+                /* non zero value. Could use a hand coded function for
+                   'one' value */
+                v = l3_unscale(1, exponents[s_index]);
+                if(get_bits(&s->gb, 1))
+                    v = -v;
+            } else {
+                v = 0;
+            }
+            g->sb_hybrid.MPA_PREC[s_index++] = v;
+        }
+    }
+    while (s_index < 576)
+        g->sb_hybrid.MPA_PREC[s_index++] = 0;
+    return 0;
+}
+
+/* Reorder short blocks from bitstream order to interleaved order. It
+   would be faster to do it in parsing, but the code would be far more
+   complicated */
+static void reorder_block(MPADecodeContext *s, GranuleDef *g)
+{
+    int i, j, k, len;
+    INTFLOAT *ptr, *dst, *ptr1;
+    INTFLOAT tmp[576];
+
+    if (g->block_type != 2)
+        return;
+
+    if (g->switch_point) {
+        if (s->sample_rate_index != 8) {
+            ptr = g->sb_hybrid.MPA_PREC + 36;
+        } else {
+            ptr = g->sb_hybrid.MPA_PREC + 48;
+        }
+    } else {
+        ptr = g->sb_hybrid.MPA_PREC;
+    }
+    
+    for(i=g->short_start;i<13;i++) {
+        len = band_size_short[s->sample_rate_index][i];
+        ptr1 = ptr;
+        for(k=0;k<3;k++) {
+            dst = tmp + k;
+            for(j=len;j>0;j--) {
+                *dst = *ptr++;
+                dst += 3;
+            }
+        }
+        memcpy(ptr1, tmp, len * 3 * sizeof(INTFLOAT));
+    }
+}
+
+#define ISQRT2 FIXR(0.70710678118654752440)
+
+static void compute_stereo(MPADecodeContext *s,
+                           GranuleDef *g0, GranuleDef *g1)
+{
+    int i, j, k, l;
+    INTFLOAT v1, v2, tmp0, tmp1;
+    int sf_max, sf, len, non_zero_found;
+    INTFLOAT (*is_tab)[16];
+    INTFLOAT *tab0, *tab1;
+    int non_zero_found_short[3];
+
+    /* intensity stereo */
+    if (s->mode_ext & MODE_EXT_I_STEREO) {
+        if (!s->lsf) {
+            is_tab = is_table;
+            sf_max = 7;
+        } else {
+            is_tab = is_table_lsf[g1->scalefac_compress & 1];
+            sf_max = 16;
+        }
+            
+        tab0 = g0->sb_hybrid.MPA_PREC + 576;
+        tab1 = g1->sb_hybrid.MPA_PREC + 576;
+
+        non_zero_found_short[0] = 0;
+        non_zero_found_short[1] = 0;
+        non_zero_found_short[2] = 0;
+        k = (13 - g1->short_start) * 3 + g1->long_end - 3;
+        for(i = 12;i >= g1->short_start;i--) {
+            /* for last band, use previous scale factor */
+            if (i != 11)
+                k -= 3;
+            len = band_size_short[s->sample_rate_index][i];
+            for(l=2;l>=0;l--) {
+                tab0 -= len;
+                tab1 -= len;
+                if (!non_zero_found_short[l]) {
+                    /* test if non zero band. if so, stop doing i-stereo */
+                    for(j=0;j<len;j++) {
+                        if (tab1[j] != 0) {
+                            non_zero_found_short[l] = 1;
+                            goto found1;
+                        }
+                    }
+                    sf = g1->scale_factors[k + l];
+                    if (sf >= sf_max)
+                        goto found1;
+
+                    v1 = is_tab[0][sf];
+                    v2 = is_tab[1][sf];
+                    for(j=0;j<len;j++) {
+                        tmp0 = tab0[j];
+                        tab0[j] = MULL(tmp0, v1);
+                        tab1[j] = MULL(tmp0, v2);
+                    }
+                } else {
+                found1:
+                    if (s->mode_ext & MODE_EXT_MS_STEREO) {
+                        /* lower part of the spectrum : do ms stereo
+                           if enabled */
+                        for(j=0;j<len;j++) {
+                            tmp0 = tab0[j];
+                            tmp1 = tab1[j];
+                            tab0[j] = MULL(tmp0 + tmp1, ISQRT2);
+                            tab1[j] = MULL(tmp0 - tmp1, ISQRT2);
+                        }
+                    }
+                }
+            }
+        }
+
+        non_zero_found = non_zero_found_short[0] | 
+            non_zero_found_short[1] | 
+            non_zero_found_short[2];
+
+        for(i = g1->long_end - 1;i >= 0;i--) {
+            len = band_size_long[s->sample_rate_index][i];
+            tab0 -= len;
+            tab1 -= len;
+            /* test if non zero band. if so, stop doing i-stereo */
+            if (!non_zero_found) {
+                for(j=0;j<len;j++) {
+                    if (tab1[j] != 0) {
+                        non_zero_found = 1;
+                        goto found2;
+                    }
+                }
+                /* for last band, use previous scale factor */
+                k = (i == 21) ? 20 : i;
+                sf = g1->scale_factors[k];
+                if (sf >= sf_max)
+                    goto found2;
+                v1 = is_tab[0][sf];
+                v2 = is_tab[1][sf];
+                for(j=0;j<len;j++) {
+                    tmp0 = tab0[j];
+                    tab0[j] = MULL(tmp0, v1);
+                    tab1[j] = MULL(tmp0, v2);
+                }
+            } else {
+            found2:
+                if (s->mode_ext & MODE_EXT_MS_STEREO) {
+                    /* lower part of the spectrum : do ms stereo
+                       if enabled */
+                    for(j=0;j<len;j++) {
+                        tmp0 = tab0[j];
+                        tmp1 = tab1[j];
+                        tab0[j] = MULL(tmp0 + tmp1, ISQRT2);
+                        tab1[j] = MULL(tmp0 - tmp1, ISQRT2);
+                    }
+                }
+            }
+        }
+    } else if (s->mode_ext & MODE_EXT_MS_STEREO) {
+        /* ms stereo ONLY */
+        /* NOTE: the 1/sqrt(2) normalization factor is included in the
+           global gain */
+        tab0 = g0->sb_hybrid.MPA_PREC;
+        tab1 = g1->sb_hybrid.MPA_PREC;
+        for(i=0;i<576;i++) {
+            tmp0 = tab0[i];
+            tmp1 = tab1[i];
+            tab0[i] = tmp0 + tmp1;
+            tab1[i] = tmp0 - tmp1;
+        }
+    }
+}
+
+static void compute_antialias(MPADecodeContext *s,
+                              GranuleDef *g)
+{
+    INTFLOAT *ptr, *p0, *p1, *csa;
+    INTFLOAT tmp0, tmp1;
+    int n, i, j;
+
+    /* we antialias only "long" bands */
+    if (g->block_type == 2) {
+        if (!g->switch_point)
+            return;
+        /* XXX: check this for 8000Hz case */
+        n = 1;
+    } else {
+        n = SBLIMIT - 1;
+    }
+    
+    ptr = g->sb_hybrid.MPA_PREC + 18;
+    for(i = n;i > 0;i--) {
+        p0 = ptr - 1;
+        p1 = ptr;
+        csa = &csa_table[0][0];
+        for(j=0;j<8;j++) {
+            tmp0 = *p0;
+            tmp1 = *p1;
+            *p0 = FRAC_RND(MUL64(tmp0, csa[0]) - MUL64(tmp1, csa[1]));
+            *p1 = FRAC_RND(MUL64(tmp0, csa[1]) + MUL64(tmp1, csa[0]));
+            p0--;
+            p1++;
+            csa += 2;
+        }
+        ptr += 18;
+    }
+}
+
+/* number of bands with non zero samples and of long blocks */
+static void imdct_limits(GranuleDef *g, int *sblimit, int *mdct_long_end)
+{
+    INTFLOAT *ptr, *ptr1;
+#ifndef MPA_FLOAT
+    int v;
+#endif
+
+    /* find last non zero block */
+    ptr = g->sb_hybrid.MPA_PREC + 576;
+    ptr1 = g->sb_hybrid.MPA_PREC + 2 * 18;
+    while (ptr >= ptr1) {
+        ptr -= 6;
+#ifdef MPA_FLOAT
+        if (ptr[0] != 0 || ptr[1] != 0 || ptr[2] != 0 ||
+            ptr[3] != 0 || ptr[4] != 0 || ptr[5] != 0)
+            break;
+#else
+        v = ptr[0] | ptr[1] | ptr[2] | ptr[3] | ptr[4] | ptr[5];
+        if (v != 0)
+            break;
+#endif
+    }
+    *sblimit = ((ptr - g->sb_hybrid.MPA_PREC) / 18) + 1;
+
+    if (g->block_type == 2) {
+        /* XXX: check for 8000 Hz */
+        if (g->switch_point)
+            *mdct_long_end = 2;
+        else
+            *mdct_long_end = 0;
+    } else {
+        *mdct_long_end = *sblimit;
+    }
+}
+
+/* long blocks of bands start to end */
+static void imdct_long_bands(GranuleDef *g, INTFLOAT *sb_samples,
+                             INTFLOAT *mdct_buf, int start, int end)
+{
+    INTFLOAT *ptr, *win, *win1, *buf, *out_ptr;
+    INTFLOAT out[36];
+    int i, j;
+
+    for(j=start;j<end;j++) {
+        ptr = g->sb_hybrid.MPA_PREC + 18 * j;
+        buf = mdct_buf + j;
+        imdct36(out, ptr);
+        /* apply window & overlap with previous buffer */
+        out_ptr = sb_samples + j;
+        /* select window */
+        if (g->switch_point && j < 2)
+            win1 = mdct_win[0];
+        else
+            win1 = mdct_win[g->block_type];
+        /* select frequency inversion */
+        win = win1 + ((4 * 36) & -(j & 1));
+        for(i=0;i<18;i++) {
+            *out_ptr = MULL(out[i], win[i]) + buf[i * SBLIMIT];
+            buf[i * SBLIMIT] = MULL(out[i + 18], win[i + 18]);
+            out_ptr += SBLIMIT;
+        }
+    }
+}
+
+/* short blocks of bands start to end */
+static void imdct_short_bands(GranuleDef *g, INTFLOAT *sb_samples,
+                              INTFLOAT *mdct_buf, int start, int end)
+{
+    INTFLOAT *ptr, *win, *buf, *buf2, *out_ptr, *ptr1;
+    INTFLOAT in[6];
+    INTFLOAT out[36];
+    INTFLOAT out2[12];
+    int i, j, k;
+
+    for(j=start;j<end;j++) {
+        ptr = g->sb_hybrid.MPA_PREC + 18 * j;
+        buf = mdct_buf + j;
+        for(i=0;i<6;i++) {
+            out[i] = 0;
+            out[6 + i] = 0;
+            out[30+i] = 0;
+        }
+        /* select frequency inversion */
+        win = mdct_win[2] + ((4 * 36) & -(j & 1));
+        buf2 = out + 6;
+        for(k=0;k<3;k++) {
+            /* reorder input for short mdct */
+            ptr1 = ptr + k;
+            for(i=0;i<6;i++) {
+                in[i] = *ptr1;
+                ptr1 += 3;
+            }
+            imdct12(out2, in);
+            /* apply 12 point window and do small overlap */
+            for(i=0;i<6;i++) {
+                buf2[i] = MULL(out2[i], win[i]) + buf2[i];
+                buf2[i + 6] = MULL(out2[i + 6], win[i + 6]);
+            }
+            buf2 += 6;
+        }
+        /* overlap */
+        out_ptr = sb_samples + j;
+        for(i=0;i<18;i++) {
+            *out_ptr = out[i] + buf[i * SBLIMIT];
+            buf[i * SBLIMIT] = out[i + 18];
+            out_ptr += SBLIMIT;
+        }
+    }
+}
+
+/* bands start to SBLIMIT, which are all zero */
+static void imdct_zero_bands(INTFLOAT *sb_samples, INTFLOAT *mdct_buf, int start)
+{
+    INTFLOAT *buf, *out_ptr;
+    int i, j;
+
+    for(j=start;j<SBLIMIT;j++) {
+        /* overlap */
+        buf = mdct_buf + j;
+        out_ptr = sb_samples + j;
+        for(i=0;i<18;i++) {
+            *out_ptr = buf[i * SBLIMIT];
+            buf[i * SBLIMIT] = 0;
+            out_ptr += SBLIMIT;
+        }
+    }
+}
+
+static void compute_imdct(MPADecodeContext *s, GranuleDef *g,
+                          int ch, int gr)
+{
+    INTFLOAT *sb_samples = s->sb_samples.MPA_PREC[ch][18 * gr];
+    INTFLOAT *mdct_buf = s->mdct_buf.MPA_PREC[ch];
+    int sblimit, mdct_long_end;
+
+    imdct_limits(g, &sblimit, &mdct_long_end);
+    imdct_long_bands(g, sb_samples, mdct_buf, 0, mdct_long_end);
+    imdct_short_bands(g, sb_samples, mdct_buf, mdct_long_end, sblimit);
+    imdct_zero_bands(sb_samples, mdct_buf, sblimit);
+}
+
+#ifdef USE_X86_SIMD
+
+/* compute_antialias() doing 4 butterflies of a band boundary at a time */
+__attribute__((target("sse4.1")))
+static void compute_antialias_sse41(MPADecodeContext *s,
+                                    GranuleDef *g)
+{
+    int32_t *ptr;
+    int n, i, j;
+    __m128i cs[2], ca[2], p0, p1;
+
+    /* s is only there for the kernel table signature */
+    (void)s;
+
+    /* we antialias only "long" bands */
+    if (g->block_type == 2) {
+        if (!g->switch_point)
+            return;
+        /* XXX: check this for 8000Hz case */
+        n = 1;
+    } else {
+        n = SBLIMIT - 1;
+    }
+
+    for(j=0;j<2;j++) {
+        cs[j] = _mm_setr_epi32(csa_table[4*j][0], csa_table[4*j+1][0],
+                               csa_table[4*j+2][0], csa_table[4*j+3][0]);
+        ca[j] = _mm_setr_epi32(csa_table[4*j][1], csa_table[4*j+1][1],
+                               csa_table[4*j+2][1], csa_table[4*j+3][1]);
+    }
+
+    ptr = g->sb_hybrid.MPA_PREC + 18;
+    for(i = n;i > 0;i--) {
+        for(j=0;j<2;j++) {
+            /* ptr[-1 - k] and ptr[k] for k = 4 * j .. 4 * j + 3 */
+            p0 = _mm_shuffle_epi32(_mm_loadu_si128((__m128i *)(ptr - 4 - 4 * j)), REVERSE4);
+            p1 = _mm_loadu_si128((__m128i *)(ptr + 4 * j));
+            _mm_storeu_si128((__m128i *)(ptr - 4 - 4 * j), _mm_shuffle_epi32(
+                v64_rnd(v64_sub(v64_mul(p0, cs[j]), v64_mul(p1, ca[j]))), REVERSE4));
+            _mm_storeu_si128((__m128i *)(ptr + 4 * j),
+                v64_rnd(v64_add(v64_mul(p0, ca[j]), v64_mul(p1, cs[j]))));
+        }
+        ptr += 18;
+    }
+}
+
+/* gathers sample i of the 4 bands starting at ptr into one register */
+#define GATHER4(ptr, i) \
+    _mm_setr_epi32((ptr)[i], (ptr)[18 + (i)], (ptr)[36 + (i)], (ptr)[54 + (i)])
+
+/* imdct_long_bands() for the 4 bands starting at band j, j must be even */
+__attribute__((target("sse4.1")))
+static void imdct_long_4_sse41(GranuleDef *g, int32_t *sb_samples,
+                               int32_t *mdct_buf, int j)
+{
+    const int32_t *ptr = g->sb_hybrid.MPA_PREC + 18 * j;
+    int32_t (*win)[4] = mdct_win4[g->block_type];
+    __m128i in[18], out[36];
+    int i;
+
+    for(i=0;i<18;i++)
+        in[i] = GATHER4(ptr, i);
+    imdct36_sse41(out, in);
+
+    sb_samples += j;
+    mdct_buf += j;
+    for(i=0;i<18;i++) {
+        _mm_storeu_si128((__m128i *)(sb_samples + i * SBLIMIT), _mm_add_epi32(
+            mull_sse41(out[i], _mm_loadu_si128((__m128i *)win[i])),
+            _mm_loadu_si128((__m128i *)(mdct_buf + i * SBLIMIT))));
+        _mm_storeu_si128((__m128i *)(mdct_buf + i * SBLIMIT),
+            mull_sse41(out[i + 18], _mm_loadu_si128((__m128i *)win[i + 18])));
+    }
+}
+
+/* imdct_short_bands() for the 4 bands starting at band j, j must be even */
+__attribute__((target("sse4.1")))
+static void imdct_short_4_sse41(GranuleDef *g, int32_t *sb_samples,
+                                int32_t *mdct_buf, int j)
+{
+    const int32_t *ptr = g->sb_hybrid.MPA_PREC + 18 * j;
+    int32_t (*win)[4] = mdct_win4[2];
+    __m128i in[6], out[36], out2[12], *buf2;
+    int i, k;
+
+    for(i=0;i<6;i++) {
+        out[i] = _mm_setzero_si128();
+        out[6 + i] = _mm_setzero_si128();
+        out[30 + i] = _mm_setzero_si128();
+    }
+    buf2 = out + 6;
+    for(k=0;k<3;k++) {
+        /* reorder input for short mdct */
+        for(i=0;i<6;i++)
+            in[i] = GATHER4(ptr, k + 3 * i);
+        imdct12_sse41(out2, in);
+        /* apply 12 point window and do small overlap */
+        for(i=0;i<6;i++) {
+            buf2[i] = _mm_add_epi32(
+                mull_sse41(out2[i], _mm_loadu_si128((__m128i *)win[i])), buf2[i]);
+            buf2[i + 6] = mull_sse41(out2[i + 6], _mm_loadu_si128((__m128i *)win[i + 6]));
+        }
+        buf2 += 6;
+    }
+
+    sb_samples += j;
+    mdct_buf += j;
+    for(i=0;i<18;i++) {
+        _mm_storeu_si128((__m128i *)(sb_samples + i * SBLIMIT), _mm_add_epi32(
+            out[i], _mm_loadu_si128((__m128i *)(mdct_buf + i * SBLIMIT))));
+        _mm_storeu_si128((__m128i *)(mdct_buf + i * SBLIMIT), out[i + 18]);
+    }
+}
+
+/* compute_imdct() doing 4 bands at a time. Bands are independent of each
+   other, and all zero bands above sblimit give the same result as
+   imdct_zero_bands() when run through the filterbank, so groups may run
+   past sblimit. */
+static void compute_imdct_sse41(MPADecodeContext *s, GranuleDef *g,
+                                int ch, int gr)
+{
+    int32_t *sb_samples = s->sb_samples.fixed23[ch][18 * gr];
+    int32_t *mdct_buf = s->mdct_buf.fixed23[ch];
+    int sblimit, mdct_long_end, j;
+
+    imdct_limits(g, &sblimit, &mdct_long_end);
+
+    /* the first two bands of a switch point use their own window */
+    j = 0;
+    if (g->switch_point) {
+        j = mdct_long_end < 2 ? mdct_long_end : 2;
+        imdct_long_bands(g, sb_samples, mdct_buf, 0, j);
+    }
+    for(;j<mdct_long_end && j+4<=SBLIMIT;j+=4)
+        imdct_long_4_sse41(g, sb_samples, mdct_buf, j);
+    if (j < mdct_long_end) {
+        imdct_long_bands(g, sb_samples, mdct_buf, j, mdct_long_end);
+        j = mdct_long_end;
+    }
+
+    for(;j<sblimit && j+4<=SBLIMIT;j+=4)
+        imdct_short_4_sse41(g, sb_samples, mdct_buf, j);
+    if (j < sblimit) {
+        imdct_short_bands(g, sb_samples, mdct_buf, j, sblimit);
+        j = sblimit;
+    }
+
+    imdct_zero_bands(sb_samples, mdct_buf, j);
+}
+
+#endif /* USE_X86_SIMD */
+
+/* runs the synthesis filter on nb_frames blocks of 32 subband samples of
+   every channel */
+static void synthesize(MPADecodeContext *s, int16_t *samples, int nb_frames)
+{
+    int16_t *samples_ptr;
+    int ch, i;
+
+    for(ch=0;ch<s->nb_channels;ch++) {
+        samples_ptr = samples + ch;
+        for(i=0;i<nb_frames;i++) {
+            synth_filter(s, ch, samples_ptr, s->nb_channels,
+                         s->sb_samples.MPA_PREC[ch][i]);
+            samples_ptr += 32 * s->nb_channels;
+        }
+    }
+}
+
+static MPAKernels kernel_table = {
+    init_tables,
+    huffman_decode,
+    compute_stereo,
+    reorder_block,
+    compute_antialias,
+    compute_imdct,
+    synthesize,
+};
+
+#undef table_4_3_exp
+#undef table_4_3_value
+#undef is_table
+#undef is_table_lsf
+#undef csa_table
+#undef mdct_win
+#undef scale_factor_mult3
+#undef window
+#undef dev_4_3_coefs
+#undef pow_mult3
+#undef int_pow_init
+#undef int_pow
+#undef l3_unscale
+#undef init_tables
+#undef dct32_final
+#undef dct32
+#undef round_sample
+#undef synth_filter
+#undef synthesize
+#undef imdct12
+#undef icos36
+#undef icos72
+#undef imdct36
+#undef huffman_decode
+#undef reorder_block
+#undef compute_stereo
+#undef compute_antialias
+#undef imdct_limits
+#undef imdct_long_bands
+#undef imdct_short_bands
+#undef imdct_zero_bands
+#undef compute_imdct
+#undef kernel_table
+
+#undef MPA_NAME
+#undef MPA_NAME2
+#undef MPA_NAME3
+
+#undef INTFLOAT
+#undef MPA_INT
+#undef MPA_ACC
+#undef MULL
+#undef MUL64
+#undef FIX
+#undef FIXR
+#undef FRAC_RND
+#undef FRAC_BITS
+#undef WFRAC_BITS
+#undef FRAC_ONE
+#undef OUT_SHIFT
+#undef MULS
+#undef MACS
+#undef TABLE_4_3_SIZE
+#undef DEV_ORDER
+#undef POW_FRAC_BITS
+#undef POW_FRAC_ONE
+#undef POW_FIX
+#undef POW_MULL
+#undef SUM8
+#undef SUM8P2
+#undef ISQRT2
+#undef C1
+#undef C2
+#undef C3
+#undef C4
+#undef C5
+#undef C6
+#undef C7
+#undef C8
+#undef USE_X86_SIMD
+
+#undef MPA_PREC
+#undef MPA_FRAC_BITS
+#undef MPA_FLOAT
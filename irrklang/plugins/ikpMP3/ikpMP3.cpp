@@ -1,8 +1,10 @@
 
 #include <irrKlang.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "CIrrKlangAudioStreamLoaderMP3.h"
+#include "decoder/mpaudec.h"
 
 using namespace irrklang;
 
@@ -30,9 +32,33 @@ void irrKlangPluginInit(ISoundEngine* engine, const char* version)
 		return;
 	}
 
-	// create and register the loader
+	// create and register the loader. Setting IKP_MP3_DECODE_AHEAD=1 moves mp3
+	// decoding off the engine's mixing thread onto a pool of worker threads shared
+	// by all streams.
+	// IKP_MP3_PRECISION=fast or =float selects the 15 bit or the float decoder
+	// instead of the bit exact one, see MPAUDEC_PRECISION_* in decoder/mpaudec.h.
+	// IKP_MP3_MAP_INPUT=1 memory maps mp3 files on disk instead of reading them.
+	// IKP_MP3_OUTPUT_RATE and IKP_MP3_OUTPUT_CHANNELS let the streams convert to the
+	// format of the output device, so the engine doesn't have to while mixing.
 
-	CIrrKlangAudioStreamLoaderMP3* loader = new CIrrKlangAudioStreamLoaderMP3();
+	const char* decodeAhead = getenv("IKP_MP3_DECODE_AHEAD");
+	const bool decodeAheadEnabled = decodeAhead && strcmp(decodeAhead, "0") != 0;
+
+	const char* precisionName = getenv("IKP_MP3_PRECISION");
+	int precision = MPAUDEC_PRECISION_FIXED23;
+	if (precisionName && !strcmp(precisionName, "fast"))
+		precision = MPAUDEC_PRECISION_FIXED15;
+	else if (precisionName && !strcmp(precisionName, "float"))
+		precision = MPAUDEC_PRECISION_FLOAT;
+
+	const char* mapInput = getenv("IKP_MP3_MAP_INPUT");
+	const bool mapInputEnabled = mapInput && strcmp(mapInput, "0") != 0;
+
+	const char* outputRate = getenv("IKP_MP3_OUTPUT_RATE");
+	const char* outputChannels = getenv("IKP_MP3_OUTPUT_CHANNELS");
+
+	CIrrKlangAudioStreamLoaderMP3* loader = new CIrrKlangAudioStreamLoaderMP3(decodeAheadEnabled, precision, mapInputEnabled,
+		outputRate ? atoi(outputRate) : 0, outputChannels ? atoi(outputChannels) : 0);
 	engine->registerAudioStreamLoader(loader);
 	loader->drop();
 
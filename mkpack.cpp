@@ -0,0 +1,24 @@
+// Builds the asset pack loaded by the game at startup
+// Usage: ./mkpack assets.pak blurp.wav lava1.jpg Sample_GL3.vert ...
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "assetpack.h"
+using namespace std;
+
+int main (int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		cout << "Usage: " << argv[0] << " <pack> <files...>" << endl;
+		return EXIT_FAILURE;
+	}
+
+	vector<string> files(argv + 2, argv + argc);
+	if (!writeAssetPack(argv[1], files))
+		return EXIT_FAILURE;
+
+	cout << "Wrote " << files.size() << " assets to " << argv[1] << endl;
+	return EXIT_SUCCESS;
+}
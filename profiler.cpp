@@ -0,0 +1,205 @@
+// Frame profiler
+#include "profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Events this close to being overwritten are skipped when reading another
+// thread's ring, the owner may be writing them right now
+#define PROFILER_READ_MARGIN 1024
+
+atomic<bool> Profiler::Enabled(false);
+
+static mutex ringsmutex;
+static vector<ProfileRing*> rings; // never freed, events outlive their thread
+static thread_local ProfileRing* threadring = 0;
+
+ProfileRing::ProfileRing(const char* name, int id)
+: Name(name), Id(id), Depth(0), Count(0)
+{
+	for (int i = 0; i < PROFILER_MAX_SCOPES; i++)
+	{
+		Scopes[i].name = 0;
+		Scopes[i].count.store(0, memory_order_relaxed);
+	}
+}
+
+// Stats of a name, claims a free slot the first time. 0 once all slots are
+// taken, further names only show up in the trace then.
+PROFILESCOPESTATS* ProfileRing::findScope(const char* name)
+{
+	uintptr_t key = (uintptr_t)name;
+	size_t slot = (size_t)((key >> 3) ^ (key >> 11));
+	for (int i = 0; i < PROFILER_MAX_SCOPES; i++)
+	{
+		PROFILESCOPESTATS& scope = Scopes[(slot + i) & (PROFILER_MAX_SCOPES - 1)];
+		if (scope.name == name)
+			return &scope;
+		if (!scope.name)
+		{
+			scope.name = name;
+			return &scope;
+		}
+	}
+	return 0;
+}
+
+void ProfileRing::add(const char* name, int64_t start, int64_t end, int depth)
+{
+	uint64_t count = Count.load(memory_order_relaxed);
+	PROFILEEVENT& event = Events[count & (PROFILER_RING_SIZE - 1)];
+	event.name = name;
+	event.start = start;
+	event.end = end;
+	event.depth = depth;
+	Count.store(count + 1, memory_order_release);
+
+	PROFILESCOPESTATS* scope = findScope(name);
+	if (scope)
+	{
+		uint32_t samples = scope->count.load(memory_order_relaxed);
+		scope->durations[samples % PROFILER_WINDOW].store(end - start, memory_order_relaxed);
+		scope->count.store(samples + 1, memory_order_release);
+	}
+}
+
+void Profiler::enable(bool enabled)
+{
+	Enabled.store(enabled, memory_order_relaxed);
+}
+
+int64_t Profiler::now()
+{
+	return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+ProfileRing* Profiler::createRing(const char* name)
+{
+	lock_guard<mutex> lock(ringsmutex);
+	ProfileRing* ring = new ProfileRing(name, (int)rings.size() + 1);
+	rings.push_back(ring);
+	return ring;
+}
+
+ProfileRing* Profiler::getThreadRing()
+{
+	if (!threadring)
+		threadring = createRing("thread");
+	return threadring;
+}
+
+void Profiler::nameThread(const char* name)
+{
+	getThreadRing()->Name = name;
+}
+
+// Oldest to newest events of a ring which are safe to read
+static void readring(ProfileRing* ring, vector<PROFILEEVENT>& events)
+{
+	uint64_t count = ring->Count.load(memory_order_acquire);
+	uint64_t first = 0;
+	if (count > PROFILER_RING_SIZE - PROFILER_READ_MARGIN)
+		first = count - (PROFILER_RING_SIZE - PROFILER_READ_MARGIN);
+
+	events.clear();
+	for (uint64_t i = first; i < count; i++)
+		events.push_back(ring->Events[i & (PROFILER_RING_SIZE - 1)]);
+}
+
+bool Profiler::writeTrace(const char* filename)
+{
+	ofstream out(filename);
+	if (!out)
+	{
+		cout << "Error: could not write profile `" << filename << "'" << endl;
+		return false;
+	}
+
+	lock_guard<mutex> lock(ringsmutex);
+	int64_t origin = -1;
+	vector<PROFILEEVENT> events;
+	for (size_t i = 0; i < rings.size(); i++)
+	{
+		readring(rings[i], events);
+		if (!events.empty() && (origin < 0 || events[0].start < origin))
+			origin = events[0].start;
+	}
+
+	out << "{\"traceEvents\":[" << endl;
+	out << fixed << setprecision(3);
+	bool first = true;
+	for (size_t i = 0; i < rings.size(); i++)
+	{
+		ProfileRing* ring = rings[i];
+		out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << ring->Id
+			<< ",\"args\":{\"name\":\"" << ring->Name << "\"}}";
+		first = false;
+
+		readring(ring, events);
+		for (size_t j = 0; j < events.size(); j++)
+		{
+			// timestamps are in microseconds
+			out << ",\n{\"name\":\"" << events[j].name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << ring->Id
+				<< ",\"ts\":" << (events[j].start - origin) / 1000.0
+				<< ",\"dur\":" << (events[j].end - events[j].start) / 1000.0 << "}";
+		}
+	}
+	out << "\n]}" << endl;
+	return true;
+}
+
+void Profiler::printStats()
+{
+	// one entry per scope, a literal used in several files may have several
+	// addresses and then fills several slots
+	map<string, vector<int64_t> > scopes;
+
+	{
+		lock_guard<mutex> lock(ringsmutex);
+		for (size_t i = 0; i < rings.size(); i++)
+		{
+			for (int j = 0; j < PROFILER_MAX_SCOPES; j++)
+			{
+				PROFILESCOPESTATS& scope = rings[i]->Scopes[j];
+				uint32_t samples = scope.count.load(memory_order_acquire);
+				if (samples == 0)
+					continue;
+
+				string name = rings[i]->Name;
+				name += "/";
+				name += scope.name;
+				vector<int64_t>& durations = scopes[name];
+				size_t n = samples < PROFILER_WINDOW ? samples : PROFILER_WINDOW;
+				for (size_t k = 0; k < n; k++)
+					durations.push_back(scope.durations[k].load(memory_order_relaxed));
+			}
+		}
+	}
+
+	cout << "scope                     samples    p50 ms    p95 ms    p99 ms" << endl;
+	// left, fixed and the precision would stick to cout for the rest of the game
+	ios::fmtflags flags = cout.flags();
+	streamsize precision = cout.precision();
+	cout << fixed << setprecision(3);
+	for (map<string, vector<int64_t> >::iterator it = scopes.begin(); it != scopes.end(); ++it)
+	{
+		vector<int64_t>& d = it->second;
+		sort(d.begin(), d.end());
+		size_t n = d.size();
+		cout << left << setw(24) << it->first << right
+			<< setw(9) << n
+			<< setw(10) << d[n * 50 / 100] / 1e6
+			<< setw(10) << d[n * 95 / 100] / 1e6
+			<< setw(10) << d[n * 99 / 100] / 1e6 << endl;
+	}
+	cout.flags(flags);
+	cout.precision(precision);
+}
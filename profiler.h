@@ -0,0 +1,136 @@
+// Frame profiler
+//
+// PROFILE_SCOPE("name") times the rest of the enclosing block; a named
+// ProfileScope can also be ended early with end() to time a phase in the
+// middle of a function. Every thread records into its own ring of the last
+// PROFILER_RING_SIZE events, so recording takes no locks, and while the
+// profiler is disabled a scope costs a single branch. Define
+// PROFILER_DISABLED to compile PROFILE_SCOPE out entirely. Names must be
+// string literals, only the pointer is stored.
+//
+// The rings can be written as Chrome trace JSON, which loads in
+// chrome://tracing and ui.perfetto.dev, and summarised as p50/p95/p99 over the
+// last PROFILER_WINDOW samples of every scope. The windows are kept per
+// thread as events are recorded, so the summary doesn't walk the rings. Both
+// read the other threads' rings without locking, so call them while those
+// threads are quiet or accept that the newest events of a busy thread may be
+// skipped.
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+#include <atomic>
+
+#define PROFILER_RING_SIZE 65536 // events per thread, must be a power of two
+#define PROFILER_WINDOW 300      // samples per scope used for the percentiles
+#define PROFILER_MAX_SCOPES 256  // names per thread with stats, must be a power of two
+
+struct PROFILEEVENT {
+	const char* name;
+	int64_t start; // nanoseconds, see Profiler::now()
+	int64_t end;
+	int depth;     // nesting level within its track
+};
+
+// Durations of the last PROFILER_WINDOW events of one name
+struct PROFILESCOPESTATS {
+	const char* name;
+	std::atomic<uint32_t> count; // events so far, the newest duration is at (count - 1) % PROFILER_WINDOW
+	std::atomic<int64_t> durations[PROFILER_WINDOW]; // atomic only so printStats() may read them any time
+};
+
+// Events of one thread, or of a track which isn't a thread such as the GPU
+class ProfileRing
+{
+public:
+
+	ProfileRing(const char* name, int id);
+
+	void add(const char* name, int64_t start, int64_t end, int depth);
+
+	const char* Name;
+	int Id;
+	int Depth; // open scopes, only touched by the owning thread
+	std::atomic<uint64_t> Count;
+	PROFILEEVENT Events[PROFILER_RING_SIZE];
+	PROFILESCOPESTATS Scopes[PROFILER_MAX_SCOPES]; // open addressed by name pointer
+
+private:
+
+	PROFILESCOPESTATS* findScope(const char* name);
+};
+
+class Profiler
+{
+public:
+
+	static void enable(bool enabled);
+	static bool isEnabled() { return Enabled.load(std::memory_order_relaxed); }
+
+	//! Monotonic time in nanoseconds
+	static int64_t now();
+
+	//! Ring of the calling thread, created on first use
+	static ProfileRing* getThreadRing();
+	//! Names the calling thread's track in the trace, name must stay valid
+	static void nameThread(const char* name);
+
+	//! Adds a track for events which aren't timed on a CPU thread
+	static ProfileRing* createRing(const char* name);
+
+	static bool writeTrace(const char* filename);
+	static void printStats();
+
+private:
+
+	static std::atomic<bool> Enabled;
+};
+
+class ProfileScope
+{
+public:
+
+	ProfileScope(const char* name)
+	: Name(name), Ring(0)
+	{
+		if (Profiler::isEnabled())
+		{
+			Ring = Profiler::getThreadRing();
+			Depth = Ring->Depth++;
+			Start = Profiler::now();
+		}
+	}
+
+	~ProfileScope()
+	{
+		end();
+	}
+
+	void end()
+	{
+		if (Ring)
+		{
+			Ring->add(Name, Start, Profiler::now(), Depth);
+			Ring->Depth--;
+			Ring = 0;
+		}
+	}
+
+private:
+
+	const char* Name;
+	ProfileRing* Ring;
+	int64_t Start;
+	int Depth;
+};
+
+#define PROFILE_CONCAT2(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+#ifdef PROFILER_DISABLED
+#define PROFILE_SCOPE(name)
+#else
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profilescope, __LINE__)(name)
+#endif
+
+#endif
@@ -0,0 +1,228 @@
+// Preloaded sound effects
+#include "soundbank.h"
+#include <iostream>
+#include <string.h>
+
+using namespace std;
+
+struct SOUNDEFFECT {
+	const char* filename;
+	int maxvoices;
+	int priority;      // higher wins when the voice budget is full
+	float mindistance; // distance at which a 3D voice starts to fade
+};
+
+// indexed by SOUND_ID
+static const SOUNDEFFECT effects[SOUND_COUNT] = {
+	{ "blurp.wav", 4, 1, 3.0f },     // SOUND_JUMP
+	{ "bubbling1.wav", 1, 2, 5.0f }, // SOUND_DEATH
+	{ "cash.wav", 4, 0, 2.0f },      // SOUND_COIN
+};
+
+// irrKlang is left handed, the game world is right handed
+static irrklang::vec3df toaudio(const irrklang::vec3df& v)
+{
+	return irrklang::vec3df(v.X, v.Y, -v.Z);
+}
+
+SoundBank::SoundBank()
+: Engine(0), Music(0)
+{
+	memset(Sources, 0, sizeof(Sources));
+	memset(Voices, 0, sizeof(Voices));
+}
+
+SoundBank::~SoundBank()
+{
+	release();
+}
+
+void SoundBank::load(irrklang::ISoundEngine* engine)
+{
+	release();
+	Engine = engine;
+
+	for (int i = 0; i < SOUND_COUNT; i++)
+	{
+		// ESM_NO_STREAMING with preload decodes the whole file right now
+		Sources[i] = Engine->addSoundSourceFromFile(effects[i].filename, irrklang::ESM_NO_STREAMING, true);
+		if (!Sources[i])
+			cout << "Error: could not load sound `" << effects[i].filename << "'" << endl;
+		else
+			Sources[i]->setDefaultMinDistance(effects[i].mindistance);
+
+		Voices[i].maxvoices = getMaxVoices((SOUND_ID)i);
+		Voices[i].next = 0;
+	}
+}
+
+void SoundBank::release()
+{
+	for (int i = 0; i < SOUND_COUNT; i++)
+	{
+		for (int j = 0; j < SOUNDBANK_MAX_VOICES; j++)
+		{
+			if (Voices[i].sounds[j])
+				Voices[i].sounds[j]->drop();
+			Voices[i].sounds[j] = 0;
+		}
+		Sources[i] = 0; // owned by the engine
+	}
+	if (Music)
+		Music->drop();
+	Music = 0;
+	Engine = 0;
+}
+
+int SoundBank::getVoiceCount() const
+{
+	int count = 0;
+	for (int i = 0; i < SOUND_COUNT; i++)
+		for (int j = 0; j < SOUNDBANK_MAX_VOICES; j++)
+			if (Voices[i].sounds[j] && !Voices[i].sounds[j]->isFinished())
+				count++;
+	return count;
+}
+
+int SoundBank::getMaxVoices(SOUND_ID id)
+{
+	int maxvoices = effects[id].maxvoices;
+	return maxvoices < SOUNDBANK_MAX_VOICES ? maxvoices : SOUNDBANK_MAX_VOICES;
+}
+
+int SoundBank::getPriority(SOUND_ID id)
+{
+	return effects[id].priority;
+}
+
+float SoundBank::getDistance(SOUND_ID id, int slot) const
+{
+	if (!Voices[id].is3D[slot])
+		return 0;
+	return (float)Voices[id].sounds[slot]->getPosition().getDistanceFrom(Listener);
+}
+
+void SoundBank::stopVoice(SOUND_ID id, int slot)
+{
+	irrklang::ISound*& sound = Voices[id].sounds[slot];
+	if (!sound->isFinished())
+		sound->stop();
+	sound->drop();
+	sound = 0;
+}
+
+void SoundBank::setListener(const irrklang::vec3df& eye, const irrklang::vec3df& target)
+{
+	if (!Engine)
+		return;
+
+	Listener = toaudio(eye);
+	irrklang::vec3df lookdir = toaudio(target) - Listener;
+	if (lookdir.getLengthSQ() == 0)
+		lookdir.set(0, 0, 1);
+	Engine->setListenerPosition(Listener, lookdir);
+}
+
+void SoundBank::update()
+{
+	for (int i = 0; i < SOUND_COUNT; i++)
+		for (int j = 0; j < SOUNDBANK_MAX_VOICES; j++)
+			if (Voices[i].sounds[j] && !Voices[i].sounds[j]->isFinished() &&
+				getDistance((SOUND_ID)i, j) > SOUNDBANK_MAX_DISTANCE)
+				stopVoice((SOUND_ID)i, j);
+}
+
+void SoundBank::play(SOUND_ID id)
+{
+	start(id, false, irrklang::vec3df());
+}
+
+void SoundBank::play3D(SOUND_ID id, const irrklang::vec3df& pos)
+{
+	start(id, true, toaudio(pos));
+}
+
+void SoundBank::playMusic(const char* filename, bool looped)
+{
+	if (!Engine)
+		return;
+
+	if (Music)
+	{
+		if (!Music->isFinished())
+			Music->stop();
+		Music->drop();
+	}
+	Music = Engine->play2D(filename, looped, false, true);
+	if (!Music)
+		cout << "Error: could not play `" << filename << "'" << endl;
+}
+
+int pickVoiceToReplace(const VOICEINFO* playing, int count, const VOICEINFO& voice)
+{
+	int weakest = -1;
+	for (int i = 0; i < count; i++)
+	{
+		if (weakest < 0 || playing[i].priority < playing[weakest].priority ||
+			(playing[i].priority == playing[weakest].priority && playing[i].distance > playing[weakest].distance))
+			weakest = i;
+	}
+
+	if (weakest < 0 || voice.priority < playing[weakest].priority ||
+		(voice.priority == playing[weakest].priority && voice.distance >= playing[weakest].distance))
+		return -1;
+	return weakest;
+}
+
+void SoundBank::start(SOUND_ID id, bool is3D, const irrklang::vec3df& pos)
+{
+	if (!Sources[id])
+		return;
+
+	// too far away to be heard, don't spend a voice on it
+	float distance = is3D ? (float)pos.getDistanceFrom(Listener) : 0;
+	if (distance > SOUNDBANK_MAX_DISTANCE)
+		return;
+
+	VOICES& voices = Voices[id];
+	if (voices.sounds[voices.next])
+	{
+		// voice cap reached, steal the oldest voice
+		stopVoice(id, voices.next);
+	}
+
+	// over the global budget, replace the weakest voice if this one outranks it
+	VOICEINFO playing[SOUND_COUNT * SOUNDBANK_MAX_VOICES];
+	SOUND_ID playingid[SOUND_COUNT * SOUNDBANK_MAX_VOICES];
+	int playingslot[SOUND_COUNT * SOUNDBANK_MAX_VOICES];
+	int count = 0;
+	for (int i = 0; i < SOUND_COUNT; i++)
+	{
+		for (int j = 0; j < SOUNDBANK_MAX_VOICES; j++)
+		{
+			if (!Voices[i].sounds[j] || Voices[i].sounds[j]->isFinished())
+				continue;
+			playing[count].priority = effects[i].priority;
+			playing[count].distance = getDistance((SOUND_ID)i, j);
+			playingid[count] = (SOUND_ID)i;
+			playingslot[count] = j;
+			count++;
+		}
+	}
+	int active = count + (Music && !Music->isFinished() ? 1 : 0);
+	if (active >= SOUNDBANK_MAX_ACTIVE)
+	{
+		VOICEINFO voice = { effects[id].priority, distance };
+		int weakest = pickVoiceToReplace(playing, count, voice);
+		if (weakest < 0)
+			return;
+		stopVoice(playingid[weakest], playingslot[weakest]);
+	}
+
+	if (is3D)
+		voices.sounds[voices.next] = Engine->play3D(Sources[id], pos, false, false, true);
+	else
+		voices.sounds[voices.next] = Engine->play2D(Sources[id], false, false, true);
+	voices.is3D[voices.next] = is3D;
+	voices.next = (voices.next + 1) % voices.maxvoices;
+}
@@ -0,0 +1,94 @@
+// Preloaded sound effects
+//
+// Every effect is decoded once at startup into an irrKlang ISoundSource, so
+// playing one from gameplay code is an array lookup with no file name
+// resolution, loading or decoding. Each effect has a voice cap: once it is
+// reached the oldest voice of that effect is stopped to make room.
+//
+// Effects can also be played in 3D at a world position. The listener follows
+// the camera through setListener(), 3D voices further away than
+// SOUNDBANK_MAX_DISTANCE are never started (and are stopped by update() once
+// the listener moves away from them), and no more than SOUNDBANK_MAX_ACTIVE
+// voices are mixed at once: a new voice only replaces the lowest priority,
+// most distant playing voice if it outranks it. Music played through the bank
+// takes one voice of the budget and is never replaced. The budget is below
+// the sum of the voice caps, so it does fill up.
+
+#ifndef SOUNDBANK_H
+#define SOUNDBANK_H
+
+#include <irrKlang.h>
+
+#define SOUNDBANK_MAX_VOICES 8
+#define SOUNDBANK_MAX_ACTIVE 8 // music included, the caps add up to 9 effect voices
+#define SOUNDBANK_MAX_DISTANCE 40.0f
+
+enum SOUND_ID {
+	SOUND_JUMP,
+	SOUND_DEATH,
+	SOUND_COIN,
+	SOUND_COUNT
+};
+
+// What decides whether a voice may replace another one
+struct VOICEINFO {
+	int priority;   // higher wins
+	float distance; // from the listener, 0 for 2D voices
+};
+
+//! Index of the voice a new one replaces once the budget is full: the lowest
+//! priority, most distant of the playing voices, if the new one outranks it.
+//! -1 if it doesn't.
+int pickVoiceToReplace(const VOICEINFO* playing, int count, const VOICEINFO& voice);
+
+class SoundBank
+{
+public:
+
+	SoundBank();
+	~SoundBank();
+
+	//! Decodes all effects into memory. Effects which fail to load stay silent.
+	void load(irrklang::ISoundEngine* engine);
+	void release();
+
+	void play(SOUND_ID id);
+	void play3D(SOUND_ID id, const irrklang::vec3df& pos);
+
+	//! Streams a file in 2D, replacing the music played before
+	void playMusic(const char* filename, bool looped);
+
+	//! Moves the listener, positions are in OpenGL world coordinates
+	void setListener(const irrklang::vec3df& eye, const irrklang::vec3df& target);
+
+	//! Culls 3D voices which are now out of range. Call once per frame.
+	void update();
+
+	//! Number of effect voices still playing
+	int getVoiceCount() const;
+
+	//! Voice cap and priority of an effect
+	static int getMaxVoices(SOUND_ID id);
+	static int getPriority(SOUND_ID id);
+
+private:
+
+	struct VOICES {
+		irrklang::ISound* sounds[SOUNDBANK_MAX_VOICES];
+		bool is3D[SOUNDBANK_MAX_VOICES];
+		int maxvoices;
+		int next; // slot of the oldest voice
+	};
+
+	void start(SOUND_ID id, bool is3D, const irrklang::vec3df& pos);
+	float getDistance(SOUND_ID id, int slot) const;
+	void stopVoice(SOUND_ID id, int slot);
+
+	irrklang::ISoundEngine* Engine;
+	irrklang::ISoundSource* Sources[SOUND_COUNT];
+	VOICES Voices[SOUND_COUNT];
+	irrklang::ISound* Music;
+	irrklang::vec3df Listener;
+};
+
+#endif
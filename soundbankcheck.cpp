@@ -0,0 +1,74 @@
+// Sound bank voice budget check
+//
+// Fills the voice budget the way the game does, with music and effect voices
+// at different distances, and checks which voice a new one replaces. Runs
+// without a sound device, only the replacement rule of SoundBank is used.
+//
+// Usage: ./soundbankcheck
+#include <iostream>
+#include "soundbank.h"
+
+using namespace std;
+
+static int failures = 0;
+
+static void expect(const char* what, int got, int expected)
+{
+	if (got != expected)
+	{
+		cout << "FAILED: " << what << ": replaced voice " << got << ", expected " << expected << endl;
+		failures++;
+	}
+	else
+		cout << "ok: " << what << endl;
+}
+
+static VOICEINFO voice(SOUND_ID id, float distance)
+{
+	VOICEINFO info = { SoundBank::getPriority(id), distance };
+	return info;
+}
+
+int main()
+{
+	// music and every effect at its cap have to be able to exceed the budget
+	int voices = 1;
+	for (int i = 0; i < SOUND_COUNT; i++)
+		voices += SoundBank::getMaxVoices((SOUND_ID)i);
+	if (voices <= SOUNDBANK_MAX_ACTIVE)
+	{
+		cout << "FAILED: the caps add up to " << voices << " voices with music, the budget of "
+			<< SOUNDBANK_MAX_ACTIVE << " is never reached" << endl;
+		failures++;
+	}
+
+	// music takes one voice of the budget, the effects fill the rest
+	VOICEINFO playing[SOUNDBANK_MAX_ACTIVE - 1] = {
+		voice(SOUND_JUMP, 1), voice(SOUND_JUMP, 2), voice(SOUND_JUMP, 3), voice(SOUND_JUMP, 4),
+		voice(SOUND_COIN, 5), voice(SOUND_COIN, 10), voice(SOUND_COIN, 2),
+	};
+	int count = SOUNDBANK_MAX_ACTIVE - 1;
+
+	expect("a coin further away than every coin is dropped", pickVoiceToReplace(playing, count, voice(SOUND_COIN, 20)), -1);
+	expect("a coin as far as the furthest coin is dropped", pickVoiceToReplace(playing, count, voice(SOUND_COIN, 10)), -1);
+	expect("a nearer coin replaces the furthest coin", pickVoiceToReplace(playing, count, voice(SOUND_COIN, 1)), 5);
+	expect("a 2D jump replaces the furthest coin", pickVoiceToReplace(playing, count, voice(SOUND_JUMP, 0)), 5);
+	expect("death replaces the furthest coin", pickVoiceToReplace(playing, count, voice(SOUND_DEATH, 30)), 5);
+
+	// no coins left, jumps are the lowest priority
+	playing[4] = voice(SOUND_JUMP, 6);
+	playing[5] = voice(SOUND_DEATH, 10);
+	playing[6] = voice(SOUND_JUMP, 5);
+	expect("a coin never replaces a jump", pickVoiceToReplace(playing, count, voice(SOUND_COIN, 0)), -1);
+	expect("a nearer jump replaces the furthest jump", pickVoiceToReplace(playing, count, voice(SOUND_JUMP, 3)), 4);
+	expect("a further jump is dropped", pickVoiceToReplace(playing, count, voice(SOUND_JUMP, 7)), -1);
+	expect("death replaces the furthest jump", pickVoiceToReplace(playing, count, voice(SOUND_DEATH, 0)), 4);
+
+	if (failures)
+	{
+		cout << failures << " checks failed" << endl;
+		return 1;
+	}
+	cout << "all checks passed" << endl;
+	return 0;
+}